@@ -97,15 +97,14 @@ int main(int argc, char *argv[])
     SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
     SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
 
-    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 8);
-
     SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
     SDL_Window *window = SDL_CreateWindow("Software Rendering", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720, window_flags);
     SDL_GLContext gl_context = SDL_GL_CreateContext(window);
     SDL_GL_MakeCurrent(window, gl_context);
     SDL_GL_SetSwapInterval(1);
     sr::srLoad((sr::SRLoadProc)SDL_GL_GetProcAddress);
+    // Paths fade out their edges, so no multisampled framebuffer is needed
+    sr::srSetAntiAliasing(true);
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -155,6 +154,7 @@ int main(int argc, char *argv[])
     bool drawGrid = false;
 
     bool drawLines = false;
+    bool antiAliasing = true;
 
     bool drawRect = false;
     bool drawRectLine = false;
@@ -216,6 +216,10 @@ int main(int argc, char *argv[])
         {
             sr::srSetPolygonFillMode(drawLines ? sr::PolygonFillMode_Line : sr::PolygonFillMode_Fill);
         }
+        if (ImGui::Checkbox("Anti Aliasing", &antiAliasing))
+        {
+            sr::srSetAntiAliasing(antiAliasing);
+        }
 
         ImGui::Separator();
 
@@ -275,7 +279,11 @@ int main(int argc, char *argv[])
             ImGui::DragFloat("Smoothing", &smoothing, 0.001f, 0.0f, 1.0f);
 
             ImGui::DragFloat("Outline Width", &glyph_outline_width, 0.001f, 0.0f, 0.5f);
-            ImGui::Image((ImTextureID)(unsigned long long)sr::srFontGetTextureId(font), ImGui::GetContentRegionAvail());
+            for (unsigned int page = 0; page < sr::srFontGetAtlasPageCount(font); page++)
+            {
+                const float width = ImGui::GetContentRegionAvail().x;
+                ImGui::Image((ImTextureID)(unsigned long long)sr::srFontGetTextureId(font, page), ImVec2(width, width));
+            }
         }
         ImGui::End();
 
@@ -16,4 +16,5 @@
 
 #include <freetype/freetype.h>
 
-#include "rendering_interface.h"
\ No newline at end of file
+#include "rendering_interface.h"
+#include "svg_importer.h"
@@ -3,6 +3,32 @@
 #include "glad/glad.h"
 #include "shelf_pack.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_set>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SR_USE_SSE2
+#endif
+
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image/stb_image.h"
@@ -13,10 +39,27 @@ extern "C"
 #include FT_FREETYPE_H
 }
 
+// Texture the glyphs of every face are packed into
+struct FontAtlasPage
+{
+  sr::Texture Image;
+  uint8_t *ImageData;
+  mapbox::ShelfPack *Packer;
+  unsigned int GlyphCount; // In the packer. A page without glyphs is packed from scratch again
+  glm::ivec2 DirtyMin;     // Texels written since the last upload
+  glm::ivec2 DirtyMax;
+};
+
 struct FontManager
 {
   std::unordered_map<sr::FontHandle, sr::Font> LoadedFonts;
+  std::unordered_map<std::string, sr::FontFace *> Faces; // By file path, or by address and size of the data
+  std::vector<FontAtlasPage> AtlasPages;
+  size_t AtlasBudget = SR_FONT_ATLAS_BUDGET;
+  uint32_t AtlasGeneration = 0; // Changes whenever glyphs are evicted, so text layouts know their quads are stale
+  uint32_t Frame = 0;           // Counted by srEndFrame, for the last use of the glyphs
   FT_Library Libary;
+  std::string CacheDirectory; // Empty when the atlas files are off
 };
 
 FontManager *sFontManager = nullptr;
@@ -36,6 +79,16 @@ void CleanUpFontManager()
 {
   if (sFontManager)
   {
+    for (auto &face : sFontManager->Faces)
+    {
+      delete face.second;
+    }
+    for (FontAtlasPage &page : sFontManager->AtlasPages)
+    {
+      sr::srUnloadTexture(&page.Image);
+      delete[] page.ImageData;
+      delete page.Packer;
+    }
     delete sFontManager;
     sFontManager = nullptr;
   }
@@ -50,6 +103,494 @@ FontManager *GetFontManager()
   return sFontManager;
 }
 
+// Read only view of a whole file
+struct FileMapping
+{
+  const uint8_t *Data = nullptr;
+  size_t Size = 0;
+#ifdef _WIN32
+  HANDLE File = INVALID_HANDLE_VALUE;
+  HANDLE Mapping = NULL;
+#endif
+};
+
+void FileMappingClose(FileMapping &mapping)
+{
+#ifdef _WIN32
+  if (mapping.Data)
+  {
+    UnmapViewOfFile(mapping.Data);
+  }
+  if (mapping.Mapping)
+  {
+    CloseHandle(mapping.Mapping);
+  }
+  if (mapping.File != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(mapping.File);
+  }
+#else
+  if (mapping.Data)
+  {
+    munmap((void *)mapping.Data, mapping.Size);
+  }
+#endif
+  mapping = FileMapping{};
+}
+
+bool FileMappingOpen(FileMapping &mapping, const char *path)
+{
+  mapping = FileMapping{};
+#ifdef _WIN32
+  mapping.File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  LARGE_INTEGER size{};
+  if (mapping.File == INVALID_HANDLE_VALUE || !GetFileSizeEx(mapping.File, &size) || size.QuadPart == 0)
+  {
+    FileMappingClose(mapping);
+    return false;
+  }
+  mapping.Mapping = CreateFileMappingA(mapping.File, NULL, PAGE_READONLY, 0, 0, NULL);
+  mapping.Data = mapping.Mapping ? (const uint8_t *)MapViewOfFile(mapping.Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+  mapping.Size = (size_t)size.QuadPart;
+#else
+  const int file = open(path, O_RDONLY);
+  struct stat info{};
+  if (file < 0 || fstat(file, &info) != 0 || info.st_size == 0)
+  {
+    if (file >= 0)
+    {
+      close(file);
+    }
+    return false;
+  }
+  void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file); // The mapping stays valid
+  mapping.Data = data != MAP_FAILED ? (const uint8_t *)data : nullptr;
+  mapping.Size = (size_t)info.st_size;
+#endif
+  if (!mapping.Data)
+  {
+    FileMappingClose(mapping);
+    return false;
+  }
+  return true;
+}
+
+// Glyph quads of a string, relative to the position it is drawn at
+struct TextLayout
+{
+  struct Quad
+  {
+    glm::vec4 Rect; // x0, y0, x1, y1
+    glm::vec4 UV;   // u0, v0, u1, v1
+    float Depth;    // Relative to the depth at the start of the string
+    unsigned int Page;
+    unsigned int Glyph; // In the glyphs of the face, to mark it as used when the text is drawn
+  };
+
+  sr::FontHandle Font;
+  uint64_t Key;
+  uint32_t Generation; // Of the atlas the quads were laid out in
+  bool Complete;       // Every glyph found room in the atlas
+  std::string Text;
+  std::vector<Quad> Quads;
+  float DepthAdvance;
+  int Width; // Of the widest line
+  int LineCount;
+  size_t Bytes;
+};
+
+struct TextLayoutCache
+{
+  std::list<TextLayout> Entries; // Most recently used first
+  std::unordered_map<uint64_t, std::list<TextLayout>::iterator> Lookup;
+  size_t Budget = SR_TEXT_CACHE_BUDGET;
+  size_t Bytes = 0;
+  TextLayout Scratch; // For strings that are not cached
+};
+
+TextLayoutCache *sTextLayoutCache = nullptr;
+
+void CleanUpTextLayoutCache()
+{
+  if (sTextLayoutCache)
+  {
+    delete sTextLayoutCache;
+    sTextLayoutCache = nullptr;
+  }
+}
+
+TextLayoutCache *GetTextLayoutCache()
+{
+  if (!sTextLayoutCache)
+  {
+    sTextLayoutCache = new TextLayoutCache();
+  }
+  return sTextLayoutCache;
+}
+
+// Layouts refer to the glyphs of their font, so they go with it
+void TextLayoutCacheRemoveFont(sr::FontHandle handle)
+{
+  if (!sTextLayoutCache)
+  {
+    return;
+  }
+  TextLayoutCache *cache = sTextLayoutCache;
+  for (auto entry = cache->Entries.begin(); entry != cache->Entries.end();)
+  {
+    if (entry->Font == handle)
+    {
+      cache->Bytes -= entry->Bytes;
+      cache->Lookup.erase(entry->Key);
+      entry = cache->Entries.erase(entry);
+    }
+    else
+    {
+      entry++;
+    }
+  }
+}
+
+// Tessellated paths, kept across frames
+struct PathCacheEntry
+{
+  struct Draw
+  {
+    sr::EBatchDrawMode Mode;
+    sr::Material Mat;
+    sr::StencilMode_ Stencil;
+    unsigned int VertexCount;
+    unsigned int IndexCount;
+  };
+
+  uint64_t Key;
+  std::vector<uint32_t> KeyData; // Everything the key was hashed from. Compared on a hit, so a hash collision is a miss
+  std::vector<Draw> Draws;
+  std::vector<sr::RenderBatch::Vertex> Vertices; // Relative to the first path point and the depth at srEndPath
+  std::vector<unsigned int> Indices;             // Relative to the first vertex of their draw
+  float DepthAdvance;
+  size_t Bytes;
+};
+
+struct PathCache
+{
+  std::list<PathCacheEntry> Entries; // Most recently used first
+  std::unordered_map<uint64_t, std::list<PathCacheEntry>::iterator> Lookup;
+  size_t Budget = SR_PATH_CACHE_BUDGET;
+  size_t Bytes = 0;
+  uint64_t Hits = 0;
+  uint64_t Misses = 0;
+};
+
+PathCache *sPathCache = nullptr;
+
+void CleanUpPathCache()
+{
+  if (sPathCache)
+  {
+    delete sPathCache;
+    sPathCache = nullptr;
+  }
+}
+
+PathCache *GetPathCache()
+{
+  if (!sPathCache)
+  {
+    sPathCache = new PathCache();
+  }
+  return sPathCache;
+}
+
+// Points on the unit circle for each segment count, shared by all circles and arcs
+struct UnitCircleTables
+{
+  std::vector<glm::vec2> Tables[SR_ARC_MAX_SEGMENTS + 1]; // (sin, cos) of the segment angles. Filled on first use
+};
+
+UnitCircleTables *sUnitCircleTables = nullptr;
+
+void CleanUpUnitCircleTables()
+{
+  if (sUnitCircleTables)
+  {
+    delete sUnitCircleTables;
+    sUnitCircleTables = nullptr;
+  }
+}
+
+const glm::vec2 *GetUnitCircleTable(unsigned int segmentCount)
+{
+  // Deferred paths get flattened on the path workers
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!sUnitCircleTables)
+  {
+    sUnitCircleTables = new UnitCircleTables();
+  }
+
+  std::vector<glm::vec2> &table = sUnitCircleTables->Tables[segmentCount];
+  if (table.empty())
+  {
+    table.resize(segmentCount);
+    for (unsigned int i = 0; i < segmentCount; i++)
+    {
+      const double angle = 2.0 * sr::PI * i / segmentCount;
+      table[i] = glm::vec2((float)sin(angle), (float)cos(angle));
+    }
+  }
+  return table.data();
+}
+
+// Color ramps and geometry of all gradients. Rows are uploaded to the texture before the next batch is drawn
+struct GradientAtlas
+{
+  static const unsigned int Width = SR_GRADIENT_RAMP_SIZE + 2;
+
+  std::vector<float> Texels = std::vector<float>(Width * SR_GRADIENT_MAX_COUNT * 4); // RGBA, one row per gradient
+  std::vector<bool> Used = std::vector<bool>(SR_GRADIENT_MAX_COUNT);
+  unsigned int DirtyBegin = 0; // Rows that changed since the last upload
+  unsigned int DirtyEnd = 0;
+  unsigned int TextureID = 0;
+};
+
+GradientAtlas *sGradientAtlas = nullptr;
+
+void CleanUpGradientAtlas()
+{
+  if (sGradientAtlas)
+  {
+    if (sGradientAtlas->TextureID != 0)
+    {
+      glDeleteTextures(1, &sGradientAtlas->TextureID);
+    }
+    delete sGradientAtlas;
+    sGradientAtlas = nullptr;
+  }
+}
+
+GradientAtlas *GetGradientAtlas()
+{
+  if (!sGradientAtlas)
+  {
+    sGradientAtlas = new GradientAtlas();
+  }
+  return sGradientAtlas;
+}
+
+// Simplified points of large paths, kept across frames
+struct PathSimplifyEntry
+{
+  uint64_t Key;
+  int Level;
+  float Tolerance;
+  std::vector<glm::vec2> SourcePoints; // Compared on a hit, so paths with the same hash do not share an entry
+  std::vector<unsigned int> SourceSubpathStarts;
+  std::vector<unsigned int> SourceStyleStarts;
+  std::vector<glm::vec2> Points;
+  std::vector<unsigned int> SubpathStarts;
+  std::vector<unsigned int> StyleStarts; // Point index where every style after the first begins
+  size_t Bytes;
+};
+
+struct PathSimplifyCache
+{
+  std::list<PathSimplifyEntry> Entries; // Most recently used first
+  std::unordered_map<uint64_t, std::list<PathSimplifyEntry>::iterator> Lookup;
+  size_t Budget = SR_PATH_SIMPLIFY_CACHE_BUDGET;
+  size_t Bytes = 0;
+  std::mutex Mutex; // Of the entries, which the path workers share
+};
+
+PathSimplifyCache *sPathSimplifyCache = nullptr;
+
+void CleanUpPathSimplifyCache()
+{
+  if (sPathSimplifyCache)
+  {
+    delete sPathSimplifyCache;
+    sPathSimplifyCache = nullptr;
+  }
+}
+
+PathSimplifyCache *GetPathSimplifyCache()
+{
+  // Deferred paths get simplified on the path workers
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!sPathSimplifyCache)
+  {
+    sPathSimplifyCache = new PathSimplifyCache();
+  }
+  return sPathSimplifyCache;
+}
+
+// Samples of all time series. Every series is a ring buffer in gpu memory, read by the vertex shader as a buffer texture
+struct TimeSeries
+{
+  unsigned int BufferID = 0;  // Capacity RG32F samples
+  unsigned int TextureID = 0; // Buffer texture over BufferID
+  unsigned int Capacity = 0;  // 0 for unloaded slots
+  unsigned int Count = 0;
+  unsigned int Head = 0; // Slot the next sample gets written to
+};
+
+struct TimeSeriesStore
+{
+  std::vector<TimeSeries> Series; // Index is the handle - 1
+  unsigned int VertexArrayID = 0; // Without attributes. Core profiles need a bound vertex array to draw
+};
+
+TimeSeriesStore *sTimeSeriesStore = nullptr;
+
+void CleanUpTimeSeriesStore()
+{
+  if (sTimeSeriesStore)
+  {
+    for (TimeSeries &series : sTimeSeriesStore->Series)
+    {
+      if (series.Capacity > 0)
+      {
+        glDeleteTextures(1, &series.TextureID);
+        glDeleteBuffers(1, &series.BufferID);
+      }
+    }
+    if (sTimeSeriesStore->VertexArrayID != 0)
+    {
+      glDeleteVertexArrays(1, &sTimeSeriesStore->VertexArrayID);
+    }
+    delete sTimeSeriesStore;
+    sTimeSeriesStore = nullptr;
+  }
+}
+
+TimeSeriesStore *GetTimeSeriesStore()
+{
+  if (!sTimeSeriesStore)
+  {
+    sTimeSeriesStore = new TimeSeriesStore();
+  }
+  return sTimeSeriesStore;
+}
+
+// Paths ended while deferred paths are enabled. They get tessellated in parallel before the next draw
+struct PathJob
+{
+  sr::PathBuilder Path;
+  bool Closed;
+  bool Cacheable;
+  uint64_t Key;
+  std::vector<uint32_t> KeyData;
+  glm::vec2 Anchor;
+
+  // State the tessellation depends on, from the time the path was ended
+  sr::ScissorTest Scissor;
+  glm::mat4 Projection;
+  float Tolerance;
+  bool AntiAliasing;
+
+  bool Parallel;         // Tessellated by the workers into Result. Otherwise drawn by the flushing thread
+  PathCacheEntry Result; // Relative to Anchor and the depth at the start of the path
+};
+
+struct PathQueue
+{
+  std::vector<PathJob> Jobs; // Kept across frames, so the vectors of every job keep their capacity
+  size_t JobCount = 0;
+  bool Flushing = false;
+
+  // The flushing thread works on the jobs as well, with its own batch
+  std::vector<std::thread> Threads;
+  sr::RenderBatch Batch{};
+  std::mutex Mutex;
+  std::condition_variable WorkReady;
+  std::condition_variable WorkDone;
+  std::vector<PathJob *> Work;
+  std::unordered_set<uint64_t> WorkKeys; // Repeats of a shape are replayed from the cache after the first one is stored
+  std::atomic<size_t> NextWork{0};
+  unsigned int Busy = 0;
+  uint64_t Generation = 0;
+  bool Quit = false;
+};
+
+PathQueue *sPathQueue = nullptr;
+
+// Batches of the path workers only live on the cpu and grow instead of being flushed
+void PathWorkerBatchInit(sr::RenderBatch &batch)
+{
+  batch.DrawCalls = new sr::RenderBatch::DrawCall[SR_BATCH_DRAW_CALLS];
+  batch.DrawBuffer.ElementCount = 4096;
+  batch.DrawBuffer.Vertices = new sr::RenderBatch::Vertex[batch.DrawBuffer.ElementCount];
+  batch.DrawBuffer.IndexCapacity = 8192;
+  batch.DrawBuffer.DynamicIndices = new unsigned int[batch.DrawBuffer.IndexCapacity];
+}
+
+void PathWorkerBatchFree(sr::RenderBatch &batch)
+{
+  delete[] batch.DrawCalls;
+  delete[] batch.DrawBuffer.Vertices;
+  delete[] batch.DrawBuffer.DynamicIndices;
+  batch = sr::RenderBatch{};
+}
+
+void PathWorkerBatchReserve(sr::RenderBatch &batch, unsigned int numVerts, unsigned int numIndices)
+{
+  // Room for the vertex alignment of the next draw call as well
+  const unsigned int vertexCount = batch.VertexCounter + numVerts + 8;
+  if (vertexCount >= batch.DrawBuffer.ElementCount)
+  {
+    const unsigned int capacity = std::max(vertexCount, batch.DrawBuffer.ElementCount * 2);
+    sr::RenderBatch::Vertex *vertices = new sr::RenderBatch::Vertex[capacity];
+    memcpy(vertices, batch.DrawBuffer.Vertices, batch.VertexCounter * sizeof(sr::RenderBatch::Vertex));
+    delete[] batch.DrawBuffer.Vertices;
+    batch.DrawBuffer.Vertices = vertices;
+    batch.DrawBuffer.ElementCount = capacity;
+  }
+
+  const unsigned int indexCount = batch.IndexCounter + numIndices;
+  if (indexCount > batch.DrawBuffer.IndexCapacity)
+  {
+    const unsigned int capacity = std::max(indexCount, batch.DrawBuffer.IndexCapacity * 2);
+    unsigned int *indices = new unsigned int[capacity];
+    memcpy(indices, batch.DrawBuffer.DynamicIndices, batch.IndexCounter * sizeof(unsigned int));
+    delete[] batch.DrawBuffer.DynamicIndices;
+    batch.DrawBuffer.DynamicIndices = indices;
+    batch.DrawBuffer.IndexCapacity = capacity;
+  }
+}
+
+void CleanUpPathQueue()
+{
+  if (sPathQueue)
+  {
+    {
+      std::lock_guard<std::mutex> lock(sPathQueue->Mutex);
+      sPathQueue->Quit = true;
+    }
+    sPathQueue->WorkReady.notify_all();
+    for (std::thread &thread : sPathQueue->Threads)
+    {
+      thread.join();
+    }
+    if (sPathQueue->Batch.DrawCalls)
+    {
+      PathWorkerBatchFree(sPathQueue->Batch);
+    }
+    delete sPathQueue;
+    sPathQueue = nullptr;
+  }
+}
+
+PathQueue *GetPathQueue()
+{
+  if (!sPathQueue)
+  {
+    sPathQueue = new PathQueue();
+  }
+  return sPathQueue;
+}
+
 sr::SRContext *sr::SRC = nullptr;
 
 const char *basicMeshVertexShader = R"(
@@ -67,6 +608,7 @@ const char *basicMeshVertexShader = R"(
   out vec4 Color2;
   out vec2 TexCoord;
   out vec3 Normal;
+  out vec2 Position; // Before the projection, for gradients
 
 
   void main()
@@ -75,6 +617,7 @@ const char *basicMeshVertexShader = R"(
     Color2 = vColor2;
     TexCoord = vTexCoord;
     Normal = vNormal;
+    Position = vPosition.xy;
     gl_Position = ProjectionMatrix * vec4(vPosition, 1.0);
   }
 )";
@@ -112,7 +655,7 @@ const char *distanceFieldFragmentShader = R"(
   in vec4 Color;
   in vec4 Color2;
   in vec2 TexCoord;
-  in vec3 Normal; // use x for border width
+  in vec3 Normal; // use x for border width, y for the scale of the glyphs
 
   uniform sampler2D Texture;
 
@@ -125,22 +668,25 @@ const char *distanceFieldFragmentShader = R"(
 
   void main() {
     float outlineWidth = 0.5 - clamp(Normal.x, 0.0, 0.5);
+    float edge = smoothing / max(Normal.y, 0.25); // The edge stays as wide on screen when the glyphs are scaled
 
     vec4 sdf = texture(Texture, TexCoord.st);
     float d  = sdf.r;
 
 
+    vec4 fill = GradientColor(Normal.z, vec4(Color.xyz, 1.0));
+
     vec4 result = vec4(0.0);
     if (Normal.x < 0.01) {
-      float alpha = smoothstep(glyph_center - smoothing, glyph_center + smoothing, d);
+      float alpha = smoothstep(glyph_center - edge, glyph_center + edge, d);
 
-      result = vec4(Color.xyz, alpha);
+      result = vec4(fill.xyz, alpha * fill.a);
     }
     else {
-      float alpha = smoothstep(outlineWidth - smoothing, outlineWidth + smoothing, d);
-      float outline_factor = smoothstep(glyph_center, glyph_center + smoothing, d);
+      float alpha = smoothstep(outlineWidth - edge, outlineWidth + edge, d);
+      float outline_factor = smoothstep(glyph_center, glyph_center + edge, d);
 
-      result = vec4(mix(Color2.xyz, Color.xyz, outline_factor), alpha);
+      result = vec4(mix(Color2.xyz, fill.xyz, outline_factor), alpha * mix(1.0, fill.a, outline_factor));
     }
 
     // Drop Shadow
@@ -155,51 +701,335 @@ const char *distanceFieldFragmentShader = R"(
 
 )";
 
-static const unsigned int FONT_TEXTURE_SIZE = 2048;
-static const unsigned int FONT_TEXTURE_DEPTH = 1;
+const char *dashFragmentShader = R"(
+  #version 330 core
 
-char const *gl_error_string(GLenum const err)
-{
-  switch (err)
+  layout(location = 0) out vec4 fragColor;
+
+  in vec4 Color;
+  in vec2 TexCoord; // x is the distance along the stroke
+  in vec3 Normal;   // x dash length, y gap length. Solid without a gap
+
+  void main()
   {
-  // opengl 2 errors (8)
-  case GL_NO_ERROR:
-    return "GL_NO_ERROR";
+    float alpha = 1.0;
+    if (Normal.x > 0.0 && Normal.y > 0.0)
+    {
+      float period = Normal.x + Normal.y;
+      float d = mod(TexCoord.x, period);
+
+      // Distance to the border of the dash, negative inside. Smoothed over one pixel along the stroke
+      float outside = d < Normal.x ? -min(d, Normal.x - d) : min(d - Normal.x, period - d);
+      float pixel = max(fwidth(TexCoord.x), 1e-5);
+      alpha = clamp(0.5 - outside / pixel, 0.0, 1.0);
+      if (alpha <= 0.0)
+      {
+        discard;
+      }
+    }
+    fragColor = vec4(Color.rgb, Color.a * alpha);
+  }
+)";
 
-  case GL_INVALID_ENUM:
-    return "GL_INVALID_ENUM";
+// Inserted after the #version line of the shaders that can draw gradients
+const char *gradientShaderFunctions = R"(
+  in vec2 Position;
 
-  case GL_INVALID_VALUE:
-    return "GL_INVALID_VALUE";
+  uniform sampler2D GradientAtlas; // Texel 0 geometry, texel 1 type and spread, then the premultiplied color ramp
 
-  case GL_INVALID_OPERATION:
-    return "GL_INVALID_OPERATION";
+  // Color of the gradient with the handle at the fragment, times color. Handles below 1 return the color
+  vec4 GradientColor(float handle, vec4 color)
+  {
+    int row = int(handle + 0.5) - 1;
+    if (row < 0)
+    {
+      return color;
+    }
 
-  case GL_STACK_OVERFLOW:
-    return "GL_STACK_OVERFLOW";
+    vec4 geometry = texelFetch(GradientAtlas, ivec2(0, row), 0);
+    vec4 kind = texelFetch(GradientAtlas, ivec2(1, row), 0);
+    vec2 d = Position - geometry.xy;
 
-  case GL_STACK_UNDERFLOW:
-    return "GL_STACK_UNDERFLOW";
+    float t;
+    if (kind.x < 0.5)
+    {
+      t = dot(d, geometry.zw); // Linear. zw is the direction over the length squared
+    }
+    else if (kind.x < 1.5)
+    {
+      t = length(d) * geometry.z; // Radial. z is one over the radius
+    }
+    else
+    {
+      t = fract((atan(d.x, d.y) - geometry.z) / 6.28318530718); // Conic. z is the start angle
+    }
 
-  case GL_OUT_OF_MEMORY:
-    return "GL_OUT_OF_MEMORY";
+    if (kind.y < 0.5)
+    {
+      t = clamp(t, 0.0, 1.0);
+    }
+    else if (kind.y < 1.5)
+    {
+      t = fract(t);
+    }
+    else
+    {
+      t = 1.0 - abs(mod(t, 2.0) - 1.0);
+    }
 
-  // opengl 3 errors (1)
-  case GL_INVALID_FRAMEBUFFER_OPERATION:
-    return "GL_INVALID_FRAMEBUFFER_OPERATION";
-  default:
-    return nullptr;
+    int rampSize = textureSize(GradientAtlas, 0).x - 2;
+    float x = t * float(rampSize - 1);
+    int i = min(int(x), rampSize - 2);
+    vec4 ramp = mix(texelFetch(GradientAtlas, ivec2(2 + i, row), 0), texelFetch(GradientAtlas, ivec2(3 + i, row), 0), x - float(i));
+    return vec4(ramp.rgb / max(ramp.a, 1e-5), ramp.a) * color;
   }
-}
+)";
 
-#define glCall(x)                                                                          \
-  x;                                                                                       \
-  {                                                                                        \
-    GLenum glob_err = 0;                                                                   \
-    while ((glob_err = glGetError()) != GL_NO_ERROR)                                       \
-    {                                                                                      \
-      printf("GL_ERROR calling \"%s\": %s %s\n", #x, gl_error_string(glob_err), __FILE__); \
-    }                                                                                      \
+const char *gradientFragmentShader = R"(
+  #version 330 core
+
+  layout(location = 0) out vec4 fragColor;
+
+  in vec4 Color;
+  in vec2 TexCoord; // x is the distance along the stroke
+  in vec3 Normal;   // x dash length, y gap length, z gradient handle
+
+  void main()
+  {
+    vec4 color = GradientColor(Normal.z, Color);
+    if (Normal.x > 0.0 && Normal.y > 0.0)
+    {
+      float period = Normal.x + Normal.y;
+      float d = mod(TexCoord.x, period);
+
+      float outside = d < Normal.x ? -min(d, Normal.x - d) : min(d - Normal.x, period - d);
+      float pixel = max(fwidth(TexCoord.x), 1e-5);
+      float alpha = clamp(0.5 - outside / pixel, 0.0, 1.0);
+      if (alpha <= 0.0)
+      {
+        discard;
+      }
+      color.a *= alpha;
+    }
+    fragColor = color;
+  }
+)";
+
+// Draws one instance per segment of a time series as a quad around the capsule of the segment
+const char *timeSeriesVertexShader = R"(
+  #version 330 core
+
+  uniform samplerBuffer Samples;
+  uniform int First;         // Slot of the oldest sample in the ring
+  uniform int Capacity;
+  uniform vec2 Offset;       // Position of the sample (0, 0)
+  uniform vec2 Scale;        // Units per sample unit
+  uniform float Extent;      // Half the thickness plus one pixel, in units
+  uniform float Depth;
+  uniform mat4 ProjectionMatrix = mat4(1.0);
+
+  out vec2 Local; // x along the segment from its first sample, y across it
+  out float SegmentLength;
+
+  void main()
+  {
+    int i = (First + gl_InstanceID) % Capacity;
+    vec2 a = Offset + texelFetch(Samples, i).xy * Scale;
+    vec2 b = Offset + texelFetch(Samples, (i + 1) % Capacity).xy * Scale;
+
+    vec2 d = b - a;
+    float len = length(d);
+    vec2 dir = len > 1e-6 ? d / len : vec2(1.0, 0.0);
+
+    // Corners of a triangle strip
+    Local.x = (gl_VertexID & 1) == 0 ? -Extent : len + Extent;
+    Local.y = (gl_VertexID & 2) == 0 ? -Extent : Extent;
+    SegmentLength = len;
+
+    vec2 position = a + dir * Local.x + vec2(-dir.y, dir.x) * Local.y;
+    gl_Position = ProjectionMatrix * vec4(position, Depth, 1.0);
+  }
+)";
+
+const char *timeSeriesFragmentShader = R"(
+  #version 330 core
+
+  layout(location = 0) out vec4 fragColor;
+
+  in vec2 Local;
+  in float SegmentLength;
+
+  uniform vec4 Color;
+  uniform float HalfThickness; // In units
+  uniform float PixelScale;    // Pixels per unit
+
+  void main()
+  {
+    // Distance to the segment, so neighbouring segments meet in round joins
+    float dist = length(vec2(Local.x - clamp(Local.x, 0.0, SegmentLength), Local.y));
+
+    // Lines thinner than a pixel are drawn a pixel wide and fade out instead
+    float halfWidth = max(HalfThickness, 0.5 / PixelScale);
+    float alpha = clamp((halfWidth - dist) * PixelScale + 0.5, 0.0, 1.0) * (HalfThickness / halfWidth);
+    if (alpha <= 0.0)
+    {
+      discard;
+    }
+    fragColor = vec4(Color.rgb, Color.a * alpha);
+  }
+)";
+
+// One instance per vertex of a SEGMENTS draw call, expanded into a quad around the line
+const char *segmentVertexShader = R"(
+  #version 330 core
+
+  layout(location = 0) in vec3 vPosition; // First point
+  layout(location = 1) in vec3 vNormal;   // xy second point minus the first, z width
+  layout(location = 2) in vec2 vTexCoord; // LineCap_ at the first and the second point
+  layout(location = 3) in vec4 vColor;
+
+  uniform mat4 ProjectionMatrix = mat4(1.0);
+  uniform float PixelScale; // Pixels per unit
+
+  out vec4 Color;
+  out vec2 Local; // x along the segment from the first point, y across it
+  flat out float SegmentLength;
+  flat out float HalfWidth;
+  flat out vec2 Caps;
+
+  void main()
+  {
+    float len = length(vNormal.xy);
+    vec2 dir = len > 1e-6 ? vNormal.xy / len : vec2(1.0, 0.0);
+
+    // Lines thinner than a pixel are drawn a pixel wide and fade out instead
+    float halfWidth = max(vNormal.z * 0.5, 0.5 / PixelScale);
+    float extent = halfWidth + 1.0 / PixelScale;
+
+    // Corners of a triangle strip
+    Local.x = (gl_VertexID & 1) == 0 ? -extent : len + extent;
+    Local.y = (gl_VertexID & 2) == 0 ? -extent : extent;
+    SegmentLength = len;
+    HalfWidth = halfWidth;
+    Caps = vTexCoord;
+    Color = vec4(vColor.rgb, vColor.a * vNormal.z * 0.5 / halfWidth);
+
+    vec2 position = vPosition.xy + dir * Local.x + vec2(-dir.y, dir.x) * Local.y;
+    gl_Position = ProjectionMatrix * vec4(position, vPosition.z, 1.0);
+  }
+)";
+
+const char *segmentFragmentShader = R"(
+  #version 330 core
+
+  layout(location = 0) out vec4 fragColor;
+
+  in vec4 Color;
+  in vec2 Local;
+  flat in float SegmentLength;
+  flat in float HalfWidth;
+  flat in vec2 Caps;
+
+  uniform float PixelScale;
+  uniform bool AntiAliasing;
+
+  void main()
+  {
+    // Distance to the outline, negative inside. Butt ends stop at the points, square ends half the width behind them
+    float dist;
+    if ((Local.x < 0.0 && Caps.x > 1.5) || (Local.x > SegmentLength && Caps.y > 1.5))
+    {
+      dist = length(vec2(Local.x - clamp(Local.x, 0.0, SegmentLength), Local.y)) - HalfWidth;
+    }
+    else
+    {
+      float startExtent = Caps.x > 0.5 ? HalfWidth : 0.0;
+      float endExtent = Caps.y > 0.5 ? HalfWidth : 0.0;
+      dist = max(abs(Local.y) - HalfWidth, max(-startExtent - Local.x, Local.x - SegmentLength - endExtent));
+    }
+
+    float alpha = AntiAliasing ? clamp(0.5 - dist * PixelScale, 0.0, 1.0) : (dist <= 0.0 ? 1.0 : 0.0);
+    if (alpha <= 0.0)
+    {
+      discard;
+    }
+    fragColor = vec4(Color.rgb, Color.a * alpha);
+
+    // Partly covered fragments lie a bit behind the shape, so the core of an overlapping segment of the same shape still
+    // covers them, while cores of the same depth do not get blended twice
+    gl_FragDepth = gl_FragCoord.z + (1.0 - alpha) * 0.00002;
+  }
+)";
+
+static const unsigned int FONT_TEXTURE_SIZE = 2048;
+static const unsigned int FONT_TEXTURE_DEPTH = 1;
+static const uint32_t FONT_ATLAS_FILE_VERSION = 3; // Bump when the file layout or the rendering of glyphs changes
+static const size_t FONT_ATLAS_EVICT_COUNT = 64;   // Least glyphs evicted at once when the atlas is full
+
+// Start of an atlas cache file. Followed by the glyphs, the Latin-1 table, the kerning slots and the pixels of the glyphs
+struct FontAtlasFileHeader
+{
+  char Magic[4];
+  uint32_t Version;
+  uint64_t FontHash; // Of the font data
+  uint32_t Size;
+  uint32_t GlyphCount;
+  uint32_t KerningSlots;
+  uint32_t KerningCount;
+  uint64_t PixelBytes;
+};
+
+// Glyphs are stored without their place in the atlas, which is shared with the faces loaded before
+struct FontAtlasFileGlyph
+{
+  uint32_t GlyphIndex;
+  int32_t Advance;
+  glm::ivec2 Size;
+  glm::ivec2 Offset;
+};
+
+char const *gl_error_string(GLenum const err)
+{
+  switch (err)
+  {
+  // opengl 2 errors (8)
+  case GL_NO_ERROR:
+    return "GL_NO_ERROR";
+
+  case GL_INVALID_ENUM:
+    return "GL_INVALID_ENUM";
+
+  case GL_INVALID_VALUE:
+    return "GL_INVALID_VALUE";
+
+  case GL_INVALID_OPERATION:
+    return "GL_INVALID_OPERATION";
+
+  case GL_STACK_OVERFLOW:
+    return "GL_STACK_OVERFLOW";
+
+  case GL_STACK_UNDERFLOW:
+    return "GL_STACK_UNDERFLOW";
+
+  case GL_OUT_OF_MEMORY:
+    return "GL_OUT_OF_MEMORY";
+
+  // opengl 3 errors (1)
+  case GL_INVALID_FRAMEBUFFER_OPERATION:
+    return "GL_INVALID_FRAMEBUFFER_OPERATION";
+  default:
+    return nullptr;
+  }
+}
+
+#define glCall(x)                                                                          \
+  x;                                                                                       \
+  {                                                                                        \
+    GLenum glob_err = 0;                                                                   \
+    while ((glob_err = glGetError()) != GL_NO_ERROR)                                       \
+    {                                                                                      \
+      printf("GL_ERROR calling \"%s\": %s %s\n", #x, gl_error_string(glob_err), __FILE__); \
+    }                                                                                      \
   }
 
 namespace sr
@@ -246,6 +1076,11 @@ namespace sr
     return !(sc1 == sc2);
   }
 
+  static bool operator!=(const Material &mat1, const Material &mat2)
+  {
+    return mat1.Texture0.ID != mat2.Texture0.ID || mat1.ShaderProgram.ID != mat2.ShaderProgram.ID;
+  }
+
   R_API void srLoad(SRLoadProc loadAddress)
   {
     gladLoadGLLoader(loadAddress);
@@ -261,6 +1096,19 @@ namespace sr
   {
     if (SRC)
     {
+      // Release pending frame fences and the chunk hashes of every slice
+      for (RenderBatch::FrameResources &frame : SRC->MainRenderBatch.Frames)
+      {
+        if (frame.Fence)
+        {
+          glCall(glDeleteSync((GLsync)frame.Fence));
+          frame.Fence = NULL;
+        }
+        delete[] frame.ChunkHashes;
+        frame.ChunkHashes = NULL;
+        frame.ChunkCount = 0;
+      }
+
       // Unload loaded meshes
       for (Mesh &mesh : SRC->AutoReleaseMeshes)
       {
@@ -272,6 +1120,13 @@ namespace sr
     }
 
     CleanUpFontManager();
+    CleanUpPathCache();
+    CleanUpUnitCircleTables();
+    CleanUpGradientAtlas();
+    CleanUpPathSimplifyCache();
+    CleanUpTimeSeriesStore();
+    CleanUpPathQueue();
+    CleanUpTextLayoutCache();
   }
 
   R_API void srInitGL()
@@ -283,6 +1138,14 @@ namespace sr
     glCall(glEnable(GL_MULTISAMPLE));
   }
 
+  static Shader LoadShaderWithGradients(const char *vertexSource, const char *fragmentSource)
+  {
+    std::string source = fragmentSource;
+    const size_t version = source.find("#version");
+    source.insert(source.find('\n', version) + 1, gradientShaderFunctions);
+    return srLoadShader(vertexSource, source.c_str());
+  }
+
   R_API void srInitContext(SRContext *context)
   {
     if (context->DefaultShader.ID == 0)
@@ -291,9 +1154,26 @@ namespace sr
     }
     if (context->DistanceFieldShader.ID == 0)
     {
-      context->DistanceFieldShader = srLoadShader(basicMeshVertexShader, distanceFieldFragmentShader);
+      context->DistanceFieldShader = LoadShaderWithGradients(basicMeshVertexShader, distanceFieldFragmentShader);
+    }
+    if (context->DashShader.ID == 0)
+    {
+      context->DashShader = srLoadShader(basicMeshVertexShader, dashFragmentShader);
+    }
+    if (context->GradientShader.ID == 0)
+    {
+      context->GradientShader = LoadShaderWithGradients(basicMeshVertexShader, gradientFragmentShader);
+    }
+    if (context->TimeSeriesShader.ID == 0)
+    {
+      context->TimeSeriesShader = srLoadShader(timeSeriesVertexShader, timeSeriesFragmentShader);
+    }
+    if (context->SegmentShader.ID == 0)
+    {
+      context->SegmentShader = srLoadShader(segmentVertexShader, segmentFragmentShader);
     }
     context->Scissor.Enabled = false;
+    context->Stencil = StencilMode_None;
     context->MainRenderBatch = srLoadRenderBatch(5000);
   }
 
@@ -308,7 +1188,7 @@ namespace sr
     srDisableScissor();
     srViewport(0, 0, (float)frameWidth, (float)frameHeight);
     srClearColor(0.8f, 0.8f, 0.8f, 1.0f);
-    srClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    srClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
     SRC->CurrentProjection = glm::orthoLH(0.0f, (float)windowWidth, (float)windowHeight, 0.0f, -1.0f, 1.0f);
     SRC->MainRenderBatch.CurrentDepth = 0.0f;
@@ -316,11 +1196,22 @@ namespace sr
     assert((frameWidth / windowWidth) == (frameHeight / windowHeight) && "Frame and window scale should be the same on both axis!");
     SRC->ScissorScale = frameWidth / windowWidth;
     SRC->WindowHeight = windowHeight;
+    SRC->FrameWidth = frameWidth;
+    SRC->FrameHeight = frameHeight;
   }
 
   R_API void srEndFrame()
   {
-    srDrawRenderBatch(&SRC->MainRenderBatch);
+    RenderBatch &rb = SRC->MainRenderBatch;
+    srDrawRenderBatch(&rb); // Also moves on to the next slice
+
+    rb.LastFenceWaitTime = rb.FenceWaitTime;
+    rb.FenceWaitTime = 0.0;
+
+    if (sFontManager)
+    {
+      sFontManager->Frame++; // Glyphs drawn so far may be evicted from now on
+    }
   }
 
   R_API void srClear(int mask)
@@ -369,14 +1260,69 @@ namespace sr
 
   R_API glm::vec4 srGetFloatFromColor(Color c)
   {
-    float r = (c & 0x000000ff) >> 0;
-    float g = (c & 0x0000ff) >> 8;
-    float b = (c & 0x00ff) >> 16;
-    float a = (c & 0xff) >> 24;
+    float r = ((c >> 0) & 0xff) / 255.0f;
+    float g = ((c >> 8) & 0xff) / 255.0f;
+    float b = ((c >> 16) & 0xff) / 255.0f;
+    float a = ((c >> 24) & 0xff) / 255.0f;
     return {r, g, b, a};
   }
 
   // MATH
+  R_API uint64_t srHashMemory(const void *data, size_t size, uint64_t seed)
+  {
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = seed ^ (size * 0x9e3779b97f4a7c15ull);
+
+    auto mix = [](uint64_t value) -> uint64_t
+    {
+      value *= 0xbf58476d1ce4e5b9ull;
+      value ^= value >> 31;
+      return value;
+    };
+
+    // Four independent lanes of eight bytes, so large buffers are not limited by the latency of the multiplies
+    if (size >= 64)
+    {
+      uint64_t lanes[4] = {hash, hash ^ 0x9e3779b97f4a7c15ull, hash ^ 0xbf58476d1ce4e5b9ull, hash ^ 0x94d049bb133111ebull};
+      while (size >= 32)
+      {
+        uint64_t values[4];
+        memcpy(values, bytes, 32);
+        for (int lane = 0; lane < 4; lane++)
+        {
+          lanes[lane] = (lanes[lane] ^ mix(values[lane])) * 0x94d049bb133111ebull;
+        }
+        bytes += 32;
+        size -= 32;
+      }
+      for (int lane = 0; lane < 4; lane++)
+      {
+        hash = (hash ^ mix(lanes[lane])) * 0x94d049bb133111ebull;
+      }
+    }
+
+    // Eight bytes at a time
+    while (size >= 8)
+    {
+      uint64_t value;
+      memcpy(&value, bytes, 8);
+      hash = (hash ^ mix(value)) * 0x94d049bb133111ebull;
+      bytes += 8;
+      size -= 8;
+    }
+
+    // Remaining bytes
+    uint64_t tail = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+      tail |= ((uint64_t)bytes[i]) << (i * 8);
+    }
+    hash = (hash ^ mix(tail)) * 0x94d049bb133111ebull;
+
+    hash ^= hash >> 32;
+    return hash;
+  }
+
   R_API RectangleCorners srGetRotatedRectangle(const Rectangle &rect, float rotation)
   {
     RectangleCorners result;
@@ -601,6 +1547,15 @@ namespace sr
     }
   }
 
+  R_API void srShaderSetUniform4f(Shader shader, const char *name, const glm::vec4 &value)
+  {
+    unsigned int location = srShaderGetUniformLocation(name, shader);
+    if (location != -1)
+    {
+      glCall(glUniform4f(location, value.x, value.y, value.z, value.w));
+    }
+  }
+
   R_API void srShaderSetUniformMat4(Shader shader, const char *name, const glm::mat4 &value)
   {
     unsigned int location = srShaderGetUniformLocation(name, shader);
@@ -616,6 +1571,7 @@ namespace sr
 
     srShaderSetUniformMat4(shader, "ProjectionMatrix", SRC->CurrentProjection);
     srShaderSetUniform1i(shader, "Texture", 0);
+    srShaderSetUniform1i(shader, "GradientAtlas", 1);
   }
 
   R_API unsigned int srTextureFormatToGL(TextureFormat_ format)
@@ -755,74 +1711,373 @@ namespace sr
     SRC->MainRenderBatch.DrawCalls[SRC->MainRenderBatch.CurrentDraw].Mat = mat;
   }
 
-  // Vertex Arrays
+  // Gradients
 
-  R_API unsigned int srGetVertexAttributeComponentCount(EVertexAttributeType type)
+  enum GradientType_
   {
-    switch (type)
+    GradientType_Linear,
+    GradientType_Radial,
+    GradientType_Conic
+  };
+
+  static GradientHandle LoadGradient(GradientType_ type, const glm::vec4 &geometry, const GradientStop *stops, unsigned int stopCount, GradientSpread_ spread)
+  {
+    GradientAtlas *atlas = GetGradientAtlas();
+    unsigned int row = 0;
+    while (row < SR_GRADIENT_MAX_COUNT && atlas->Used[row])
     {
-    case EVertexAttributeType::INT:
-    case EVertexAttributeType::UINT:
-    case EVertexAttributeType::BOOL:
-    case EVertexAttributeType::FLOAT:
-      return 1;
-    case EVertexAttributeType::FLOAT2:
-    case EVertexAttributeType::INT2:
-      return 2;
-    case EVertexAttributeType::FLOAT3:
-    case EVertexAttributeType::INT3:
-      return 3;
-    case EVertexAttributeType::FLOAT4:
-    case EVertexAttributeType::INT4:
-    case EVertexAttributeType::BYTE4:
-      return 4;
+      row++;
     }
-    SR_TRACE("ERROR: Could not get vertex attrib type component count");
+    if (row == SR_GRADIENT_MAX_COUNT)
+    {
+      SR_TRACE("ERROR: Could not load gradient. All %d gradients are in use", SR_GRADIENT_MAX_COUNT);
+      return 0;
+    }
+    atlas->Used[row] = true;
 
-    return 0;
-  }
+    glm::vec4 *texels = (glm::vec4 *)atlas->Texels.data() + row * GradientAtlas::Width;
+    texels[0] = geometry;
+    texels[1] = glm::vec4((float)type, (float)spread, 0.0f, 0.0f);
 
-  R_API unsigned int srGetVertexAttributeTypeSize(EVertexAttributeType type)
-  {
-    switch (type)
+    // Interpolated premultiplied, so fading to a transparent stop does not pass through its rgb
+    glm::vec4 *ramp = texels + 2;
+    unsigned int stop = 0;
+    for (unsigned int i = 0; i < SR_GRADIENT_RAMP_SIZE; i++)
     {
-    case EVertexAttributeType::INT:
-      return sizeof(int);
-    case EVertexAttributeType::UINT:
-      return sizeof(unsigned int);
-    case EVertexAttributeType::BOOL:
-      return sizeof(bool);
-    case EVertexAttributeType::FLOAT:
-      return sizeof(float);
-    case EVertexAttributeType::FLOAT2:
-      return sizeof(float) * 2;
-    case EVertexAttributeType::INT2:
-      return sizeof(int) * 2;
-    case EVertexAttributeType::FLOAT3:
-      return sizeof(float) * 3;
-    case EVertexAttributeType::INT3:
-      return sizeof(int) * 3;
-    case EVertexAttributeType::FLOAT4:
-      return sizeof(float) * 4;
-    case EVertexAttributeType::INT4:
-      return sizeof(int) * 4;
-    case EVertexAttributeType::BYTE4:
-      return sizeof(unsigned char) * 4;
+      const float t = i / (float)(SR_GRADIENT_RAMP_SIZE - 1);
+      while (stop < stopCount && stops[stop].Offset <= t)
+      {
+        stop++;
+      }
+
+      glm::vec4 color(0.0f);
+      if (stopCount > 0)
+      {
+        const GradientStop &before = stops[stop > 0 ? stop - 1 : 0];
+        const GradientStop &after = stops[stop < stopCount ? stop : stopCount - 1];
+        const float range = after.Offset - before.Offset;
+        const float f = range > 0.0f ? srClamp((t - before.Offset) / range, 0.0f, 1.0f) : 0.0f;
+
+        glm::vec4 a = srGetFloatFromColor(before.StopColor);
+        glm::vec4 b = srGetFloatFromColor(after.StopColor);
+        a = glm::vec4(a.x * a.w, a.y * a.w, a.z * a.w, a.w);
+        b = glm::vec4(b.x * b.w, b.y * b.w, b.z * b.w, b.w);
+        color = a + (b - a) * f;
+      }
+      ramp[i] = color;
     }
-    SR_TRACE("ERROR: Could not get vertex attrib type component count");
 
-    return 0;
+    if (atlas->DirtyBegin == atlas->DirtyEnd)
+    {
+      atlas->DirtyBegin = row;
+      atlas->DirtyEnd = row + 1;
+    }
+    else
+    {
+      atlas->DirtyBegin = srMin(atlas->DirtyBegin, row);
+      atlas->DirtyEnd = srMax(atlas->DirtyEnd, row + 1);
+    }
+    return row + 1;
   }
 
-  R_API unsigned int srGetGLVertexAttribType(EVertexAttributeType type)
+  R_API GradientHandle srLoadLinearGradient(const glm::vec2 &start, const glm::vec2 &end, const GradientStop *stops, unsigned int stopCount, GradientSpread_ spread)
   {
-    switch (type)
-    {
+    const glm::vec2 direction = end - start;
+    const float lengthSqr = glm::dot(direction, direction);
+    const glm::vec2 scaled = lengthSqr > 0.0f ? direction / lengthSqr : glm::vec2(0.0f);
+    return LoadGradient(GradientType_Linear, glm::vec4(start.x, start.y, scaled.x, scaled.y), stops, stopCount, spread);
+  }
 
-    case EVertexAttributeType::FLOAT:
-    case EVertexAttributeType::FLOAT2:
-    case EVertexAttributeType::FLOAT3:
-    case EVertexAttributeType::FLOAT4:
+  R_API GradientHandle srLoadRadialGradient(const glm::vec2 &center, float radius, const GradientStop *stops, unsigned int stopCount, GradientSpread_ spread)
+  {
+    return LoadGradient(GradientType_Radial, glm::vec4(center, radius > 0.0f ? 1.0f / radius : 0.0f, 0.0f), stops, stopCount, spread);
+  }
+
+  R_API GradientHandle srLoadConicGradient(const glm::vec2 &center, float startAngle, const GradientStop *stops, unsigned int stopCount, GradientSpread_ spread)
+  {
+    return LoadGradient(GradientType_Conic, glm::vec4(center, startAngle * DEG2RAD, 0.0f), stops, stopCount, spread);
+  }
+
+  R_API void srUnloadGradient(GradientHandle gradient)
+  {
+    if (gradient == 0 || gradient > SR_GRADIENT_MAX_COUNT || !sGradientAtlas)
+    {
+      return;
+    }
+    sGradientAtlas->Used[gradient - 1] = false;
+  }
+
+  // Uploads the changed rows and binds the atlas to texture unit 1
+  static void GradientAtlasBind()
+  {
+    GradientAtlas *atlas = sGradientAtlas;
+    if (!atlas)
+    {
+      return;
+    }
+
+    glCall(glActiveTexture(GL_TEXTURE1));
+    if (atlas->TextureID == 0)
+    {
+      glCall(glGenTextures(1, &atlas->TextureID));
+      glCall(glBindTexture(GL_TEXTURE_2D, atlas->TextureID));
+      glCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+      glCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+      glCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+      glCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+      glCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, GradientAtlas::Width, SR_GRADIENT_MAX_COUNT, 0, GL_RGBA, GL_FLOAT, atlas->Texels.data()));
+      atlas->DirtyBegin = atlas->DirtyEnd = 0;
+    }
+    else
+    {
+      glCall(glBindTexture(GL_TEXTURE_2D, atlas->TextureID));
+    }
+
+    if (atlas->DirtyEnd > atlas->DirtyBegin)
+    {
+      const float *rows = atlas->Texels.data() + atlas->DirtyBegin * GradientAtlas::Width * 4;
+      glCall(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, atlas->DirtyBegin, GradientAtlas::Width, atlas->DirtyEnd - atlas->DirtyBegin, GL_RGBA, GL_FLOAT, rows));
+      atlas->DirtyBegin = atlas->DirtyEnd = 0;
+    }
+    glCall(glActiveTexture(GL_TEXTURE0));
+  }
+
+  // Vertex color and Normal.z of a paint. A gradient replaces the rgb of the color
+  static void PaintApply(Color color, GradientHandle gradient)
+  {
+    srColor11c(gradient != 0 ? (color | 0x00ffffff) : color);
+    srNormal3f(0.0f, 0.0f, (float)gradient);
+  }
+
+  // Time series
+
+  static TimeSeries *TimeSeriesGet(TimeSeriesHandle handle)
+  {
+    if (handle == 0 || !sTimeSeriesStore || handle > sTimeSeriesStore->Series.size())
+    {
+      return nullptr;
+    }
+    TimeSeries *series = &sTimeSeriesStore->Series[handle - 1];
+    return series->Capacity > 0 ? series : nullptr;
+  }
+
+  R_API TimeSeriesHandle srLoadTimeSeries(unsigned int capacity)
+  {
+    int maxTexels = 0;
+    glCall(glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels));
+    if (maxTexels > 0 && capacity > (unsigned int)maxTexels)
+    {
+      SR_TRACE("ERROR: Time series capacity %u is over the buffer texture limit of %d samples", capacity, maxTexels);
+      capacity = (unsigned int)maxTexels;
+    }
+    capacity = srMax(capacity, 2u);
+
+    TimeSeriesStore *store = GetTimeSeriesStore();
+    if (store->VertexArrayID == 0)
+    {
+      store->VertexArrayID = srLoadVertexArray();
+    }
+
+    unsigned int slot = 0;
+    while (slot < store->Series.size() && store->Series[slot].Capacity > 0)
+    {
+      slot++;
+    }
+    if (slot == store->Series.size())
+    {
+      store->Series.emplace_back();
+    }
+
+    TimeSeries &series = store->Series[slot];
+    series = TimeSeries();
+    series.Capacity = capacity;
+
+    glCall(glGenBuffers(1, &series.BufferID));
+    glCall(glBindBuffer(GL_TEXTURE_BUFFER, series.BufferID));
+    glCall(glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::vec2), NULL, GL_DYNAMIC_DRAW));
+    glCall(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+
+    glCall(glGenTextures(1, &series.TextureID));
+    glCall(glBindTexture(GL_TEXTURE_BUFFER, series.TextureID));
+    glCall(glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, series.BufferID));
+    glCall(glBindTexture(GL_TEXTURE_BUFFER, 0));
+    return slot + 1;
+  }
+
+  R_API void srUnloadTimeSeries(TimeSeriesHandle handle)
+  {
+    TimeSeries *series = TimeSeriesGet(handle);
+    if (!series)
+    {
+      return;
+    }
+    glCall(glDeleteTextures(1, &series->TextureID));
+    glCall(glDeleteBuffers(1, &series->BufferID));
+    *series = TimeSeries();
+  }
+
+  R_API void srTimeSeriesAppend(TimeSeriesHandle handle, const glm::vec2 *samples, size_t count)
+  {
+    TimeSeries *series = TimeSeriesGet(handle);
+    if (!series || count == 0)
+    {
+      return;
+    }
+
+    // Only the newest Capacity samples would survive anyway
+    if (count > series->Capacity)
+    {
+      samples += count - series->Capacity;
+      count = series->Capacity;
+    }
+
+    // At most two uploads, one up to the end of the ring and one from its start
+    const unsigned int tailCount = srMin((unsigned int)count, series->Capacity - series->Head);
+    glCall(glBindBuffer(GL_TEXTURE_BUFFER, series->BufferID));
+    glCall(glBufferSubData(GL_TEXTURE_BUFFER, series->Head * sizeof(glm::vec2), tailCount * sizeof(glm::vec2), samples));
+    if (tailCount < count)
+    {
+      glCall(glBufferSubData(GL_TEXTURE_BUFFER, 0, (count - tailCount) * sizeof(glm::vec2), samples + tailCount));
+    }
+    glCall(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+
+    series->Head = (unsigned int)((series->Head + count) % series->Capacity);
+    series->Count = (unsigned int)srMin((size_t)series->Capacity, series->Count + count);
+  }
+
+  R_API void srTimeSeriesClear(TimeSeriesHandle handle)
+  {
+    TimeSeries *series = TimeSeriesGet(handle);
+    if (series)
+    {
+      series->Count = 0;
+      series->Head = 0;
+    }
+  }
+
+  R_API unsigned int srTimeSeriesGetCount(TimeSeriesHandle handle)
+  {
+    TimeSeries *series = TimeSeriesGet(handle);
+    return series ? series->Count : 0;
+  }
+
+  R_API void srDrawTimeSeries(TimeSeriesHandle handle, const glm::vec2 &offset, const glm::vec2 &scale, float thickness, Color color)
+  {
+    TimeSeries *series = TimeSeriesGet(handle);
+    if (!series || series->Count < 2 || thickness <= 0.0f)
+    {
+      return;
+    }
+
+    // Draws directly, so everything recorded before has to be drawn first
+    srDrawRenderBatch(&SRC->MainRenderBatch);
+
+    const float pixelScale = srGetPixelScale();
+    const float halfThickness = thickness * 0.5f;
+    const float extent = srMax(halfThickness, 0.5f / pixelScale) + 1.0f / pixelScale;
+
+    Shader shader = SRC->TimeSeriesShader;
+    srSetDefaultShaderUniforms(shader);
+    srShaderSetUniform1i(shader, "Samples", 0);
+    srShaderSetUniform1i(shader, "First", (int)((series->Head + series->Capacity - series->Count) % series->Capacity));
+    srShaderSetUniform1i(shader, "Capacity", (int)series->Capacity);
+    srShaderSetUniform2f(shader, "Offset", offset);
+    srShaderSetUniform2f(shader, "Scale", scale);
+    srShaderSetUniform1f(shader, "Extent", extent);
+    srShaderSetUniform1f(shader, "Depth", (float)SRC->MainRenderBatch.CurrentDepth);
+    srShaderSetUniform4f(shader, "Color", srGetFloatFromColor(color));
+    srShaderSetUniform1f(shader, "HalfThickness", halfThickness);
+    srShaderSetUniform1f(shader, "PixelScale", pixelScale);
+
+    if (SRC->Scissor.Enabled)
+    {
+      glEnable(GL_SCISSOR_TEST);
+      glScissor(SRC->Scissor.X, SRC->Scissor.Y, SRC->Scissor.Width, SRC->Scissor.Height);
+    }
+
+    glCall(glActiveTexture(GL_TEXTURE0));
+    glCall(glBindTexture(GL_TEXTURE_BUFFER, series->TextureID));
+    srBindVertexArray(sTimeSeriesStore->VertexArrayID);
+
+    // Segments overlap at their joins. Written depth would cut the fringe of one segment out of the next one
+    glDepthMask(GL_FALSE);
+    glCall(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, series->Count - 1));
+    glDepthMask(GL_TRUE);
+
+    srBindVertexArray(0);
+    glCall(glBindTexture(GL_TEXTURE_BUFFER, 0));
+    glDisable(GL_SCISSOR_TEST);
+    srEnd();
+  }
+
+  // Vertex Arrays
+
+  R_API unsigned int srGetVertexAttributeComponentCount(EVertexAttributeType type)
+  {
+    switch (type)
+    {
+    case EVertexAttributeType::INT:
+    case EVertexAttributeType::UINT:
+    case EVertexAttributeType::BOOL:
+    case EVertexAttributeType::FLOAT:
+      return 1;
+    case EVertexAttributeType::FLOAT2:
+    case EVertexAttributeType::INT2:
+      return 2;
+    case EVertexAttributeType::FLOAT3:
+    case EVertexAttributeType::INT3:
+      return 3;
+    case EVertexAttributeType::FLOAT4:
+    case EVertexAttributeType::INT4:
+    case EVertexAttributeType::BYTE4:
+      return 4;
+    }
+    SR_TRACE("ERROR: Could not get vertex attrib type component count");
+
+    return 0;
+  }
+
+  R_API unsigned int srGetVertexAttributeTypeSize(EVertexAttributeType type)
+  {
+    switch (type)
+    {
+    case EVertexAttributeType::INT:
+      return sizeof(int);
+    case EVertexAttributeType::UINT:
+      return sizeof(unsigned int);
+    case EVertexAttributeType::BOOL:
+      return sizeof(bool);
+    case EVertexAttributeType::FLOAT:
+      return sizeof(float);
+    case EVertexAttributeType::FLOAT2:
+      return sizeof(float) * 2;
+    case EVertexAttributeType::INT2:
+      return sizeof(int) * 2;
+    case EVertexAttributeType::FLOAT3:
+      return sizeof(float) * 3;
+    case EVertexAttributeType::INT3:
+      return sizeof(int) * 3;
+    case EVertexAttributeType::FLOAT4:
+      return sizeof(float) * 4;
+    case EVertexAttributeType::INT4:
+      return sizeof(int) * 4;
+    case EVertexAttributeType::BYTE4:
+      return sizeof(unsigned char) * 4;
+    }
+    SR_TRACE("ERROR: Could not get vertex attrib type component count");
+
+    return 0;
+  }
+
+  R_API unsigned int srGetGLVertexAttribType(EVertexAttributeType type)
+  {
+    switch (type)
+    {
+
+    case EVertexAttributeType::FLOAT:
+    case EVertexAttributeType::FLOAT2:
+    case EVertexAttributeType::FLOAT3:
+    case EVertexAttributeType::FLOAT4:
       return GL_FLOAT;
     case EVertexAttributeType::INT:
     case EVertexAttributeType::INT2:
@@ -1119,6 +2374,8 @@ namespace sr
     result.DrawBuffer.Indices = new unsigned int[bufferSize * 6];
     memset(result.DrawBuffer.Indices, 0, bufferSize * 4 * sizeof(unsigned int));
     result.DrawBuffer.ElementCount = bufferSize * 4;
+    result.DrawBuffer.IndexCapacity = bufferSize * 6;
+    result.DrawBuffer.DynamicIndices = new unsigned int[result.DrawBuffer.IndexCapacity];
 
     int k = 0;
 
@@ -1139,7 +2396,8 @@ namespace sr
     glBinding.VAO = srLoadVertexArray();
     srBindVertexArray(glBinding.VAO);
 
-    unsigned int vbo = srLoadVertexBuffer(result.DrawBuffer.Vertices, bufferSize * 4 * sizeof(RenderBatch::Vertex));
+    // One slice per possible frame in flight. Slices get filled with glBufferSubData
+    unsigned int vbo = srLoadVertexBuffer(NULL, SR_MAX_FRAMES_IN_FLIGHT * bufferSize * 4 * sizeof(RenderBatch::Vertex));
     srEnableVertexAttribute(0);
     srSetVertexAttribute(0, 3, GL_FLOAT, GL_FALSE, sizeof(RenderBatch::Vertex), 0);
     srEnableVertexAttribute(1);
@@ -1157,118 +2415,371 @@ namespace sr
                                VertexArrayLayoutElement(EVertexAttributeType::BYTE4, 4)},
                               vbo});
 
-    unsigned int ibo = srLoadElementBuffer(result.DrawBuffer.Indices, bufferSize * 6 * sizeof(unsigned int));
+    // Quad pattern first, dynamic index slices behind it
+    unsigned int ibo = srLoadElementBuffer(NULL, (1 + SR_MAX_FRAMES_IN_FLIGHT) * bufferSize * 6 * sizeof(unsigned int));
+    glCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, bufferSize * 6 * sizeof(unsigned int), result.DrawBuffer.Indices));
     glBinding.IBO = ibo;
 
+    // Same vbo, one vertex per instance. The attribute offsets are set for every SEGMENTS draw call
+    result.DrawBuffer.SegmentVAO = srLoadVertexArray();
+    srBindVertexArray(result.DrawBuffer.SegmentVAO);
+    srBindVertexBuffer(vbo);
+    for (unsigned int location = 0; location < 4; location++)
+    {
+      srEnableVertexAttribute(location);
+      glCall(glVertexAttribDivisor(location, 1));
+    }
+
     srBindVertexArray(0);
 
     result.DrawBuffer.GlBinding = glBinding;
-    return result;
-  }
 
-  R_API void srIncreaseRenderBatchCurrentDraw(RenderBatch *batch)
-  {
-    if (batch->CurrentDraw++ >= SR_BATCH_DRAW_CALLS)
+    for (unsigned int i = 0; i < SR_MAX_FRAMES_IN_FLIGHT; i++)
     {
-      srDrawRenderBatch(batch);
+      RenderBatch::FrameResources &frame = result.Frames[i];
+      frame.VertexOffset = i * bufferSize * 4;
+
+      // Hashes of 0 will not match any chunk, so the first draw into a slice uploads everything
+      frame.ChunkCount = (bufferSize * 4 + SR_BATCH_UPLOAD_CHUNK_SIZE - 1) / SR_BATCH_UPLOAD_CHUNK_SIZE;
+      frame.ChunkHashes = new uint64_t[frame.ChunkCount];
+      memset(frame.ChunkHashes, 0, frame.ChunkCount * sizeof(uint64_t));
     }
+    return result;
   }
 
-  R_API bool srCheckRenderBatchLimit(unsigned int numVerts)
+  // Uploads only the vertex chunks that differ from what is already in the gpu buffer.
+  // Contiguous changed chunks are sent with a single glBufferSubData call.
+  static void RenderBatchUploadVertices(RenderBatch *batch)
   {
-    bool overflow = false;
-    RenderBatch &rb = SRC->MainRenderBatch;
+    RenderBatch::Buffer &buffer = batch->DrawBuffer;
+    RenderBatch::FrameResources &frame = batch->Frames[batch->CurrentFrame];
+    const unsigned int vertexCount = batch->VertexCounter;
+    const unsigned int chunkCount = srMin((vertexCount + SR_BATCH_UPLOAD_CHUNK_SIZE - 1) / SR_BATCH_UPLOAD_CHUNK_SIZE, frame.ChunkCount);
+
+    batch->UploadedVertexCount = 0;
 
-    if (rb.VertexCounter + numVerts >= rb.DrawBuffer.ElementCount)
+    bool inDirtyRange = false;
+    unsigned int dirtyBegin = 0;
+    for (unsigned int chunk = 0; chunk <= chunkCount; chunk++)
     {
-      EBatchDrawMode currentMode = rb.DrawCalls[rb.CurrentDraw].Mode;
+      bool changed = false;
+      if (chunk < chunkCount)
+      {
+        const unsigned int first = chunk * SR_BATCH_UPLOAD_CHUNK_SIZE;
+        const unsigned int count = srMin((unsigned int)SR_BATCH_UPLOAD_CHUNK_SIZE, vertexCount - first);
 
-      srDrawRenderBatch(&rb);
+        // Seed with the count, so a partially filled chunk never matches a longer one
+        const uint64_t hash = srHashMemory(buffer.Vertices + first, count * sizeof(RenderBatch::Vertex), count);
+        changed = hash != frame.ChunkHashes[chunk];
+        frame.ChunkHashes[chunk] = hash;
+      }
 
-      rb.DrawCalls[rb.CurrentDraw].Mode = currentMode;
-      overflow = true;
+      if (changed && !inDirtyRange)
+      {
+        dirtyBegin = chunk;
+        inDirtyRange = true;
+      }
+      else if (!changed && inDirtyRange)
+      {
+        const unsigned int first = dirtyBegin * SR_BATCH_UPLOAD_CHUNK_SIZE;
+        const unsigned int count = srMin(chunk * SR_BATCH_UPLOAD_CHUNK_SIZE, vertexCount) - first;
+        glCall(glBufferSubData(GL_ARRAY_BUFFER, (frame.VertexOffset + first) * sizeof(RenderBatch::Vertex), count * sizeof(RenderBatch::Vertex), buffer.Vertices + first));
+        batch->UploadedVertexCount += count;
+        inDirtyRange = false;
+      }
     }
-    return overflow;
   }
 
-  R_API void srDrawRenderBatch(RenderBatch *batch)
+  // Blocks until the gpu released the given frame slot. Returns the seconds spent waiting
+  static double RenderBatchWaitForFrame(RenderBatch::FrameResources &frame)
   {
-    if (!srBindVertexArray(batch->DrawBuffer.GlBinding.VAO))
+    if (!frame.Fence)
     {
-      for (const auto &buffer : batch->DrawBuffer.GlBinding.VBOs)
-      {
-        srBindVertexBuffer(buffer.ID);
-        unsigned int vertexSize = srGetVertexLayoutSize(buffer.Layout);
-        unsigned int currentOffset = 0;
-        for (const VertexArrayLayoutElement &elem : buffer.Layout)
-        {
-          srSetVertexAttribute(elem.Location, srGetVertexAttributeComponentCount(elem.ElementType), srGetGLVertexAttribType(elem.ElementType), elem.Normalized, vertexSize, (const void *)(unsigned long long)currentOffset);
-          srEnableVertexAttribute(elem.Location);
-          currentOffset += srGetVertexAttributeTypeSize(elem.ElementType);
-        }
-      }
+      return 0.0;
     }
 
-    srBindVertexBuffer(batch->DrawBuffer.GlBinding.VBOs[0].ID);
-    glCall(glBufferSubData(GL_ARRAY_BUFFER, 0, batch->VertexCounter * sizeof(RenderBatch::Vertex), batch->DrawBuffer.Vertices));
+    auto start = std::chrono::high_resolution_clock::now();
 
-    // Draw everything to current draw
-    for (unsigned int i = 0, vertexOffset = 0; i <= batch->CurrentDraw; i++)
+    GLsync fence = (GLsync)frame.Fence;
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (result == GL_TIMEOUT_EXPIRED)
     {
-      RenderBatch::DrawCall &drawCall = batch->DrawCalls[i];
-      Shader shader = SRC->DefaultShader;
-      if (drawCall.Mat.ShaderProgram.ID != 0)
-      {
-        shader = drawCall.Mat.ShaderProgram;
-      }
-
-      if (!drawCall.Scissor.Enabled)
-      {
-        glDisable(GL_SCISSOR_TEST);
-      }
-      else
-      {
-        glEnable(GL_SCISSOR_TEST);
-        glScissor(drawCall.Scissor.X, drawCall.Scissor.Y, drawCall.Scissor.Width, drawCall.Scissor.Height);
-      }
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+    }
+    if (result == GL_WAIT_FAILED)
+    {
+      SR_TRACE("ERROR: Waiting for frame fence failed");
+    }
+    glCall(glDeleteSync(fence));
+    frame.Fence = NULL;
 
-      srSetDefaultShaderUniforms(shader);
-      if (srShaderGetUniformLocation("UseTexture", shader, false) != -1)
-      {
-        srShaderSetUniform1b(shader, "UseTexture", drawCall.Mat.Texture0.ID > 0);
-      }
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+  }
 
-      glCall(glActiveTexture(GL_TEXTURE0));
-      srBindTexture(drawCall.Mat.Texture0);
+  // The current slice may only be written, after the gpu finished the frame that used it last
+  static void RenderBatchSyncFrame(RenderBatch *batch)
+  {
+    if (batch->FrameSynced)
+    {
+      return;
+    }
+    batch->FenceWaitTime += RenderBatchWaitForFrame(batch->Frames[batch->CurrentFrame]);
+    batch->FrameSynced = true;
+  }
 
-      EBatchDrawMode mode = drawCall.Mode;
-      switch (mode)
-      {
-      case EBatchDrawMode::POINTS:
-        glCall(glDrawArrays(GL_POINTS, vertexOffset, drawCall.VertexCount));
-        break;
-      case EBatchDrawMode::LINES:
-        glCall(glDrawArrays(GL_LINES, vertexOffset, drawCall.VertexCount));
-        break;
-      case EBatchDrawMode::TRIANGLES:
-        glCall(glDrawArrays(GL_TRIANGLES, vertexOffset, drawCall.VertexCount));
-        break;
-      case EBatchDrawMode::QUADS:
-        glCall(glDrawElements(GL_TRIANGLES, drawCall.VertexCount / 4 * 6, GL_UNSIGNED_INT, (GLvoid *)(vertexOffset / 4 * 6 * sizeof(unsigned int))));
-        break;
-      case EBatchDrawMode::UNKNOWN:
-        break;
-      }
-      srBindTexture({});
-      vertexOffset += drawCall.VertexCount + drawCall.VertexAlignment;
+  // Guards the slice that was just drawn and moves on to the next one. Every flush gets its own slice, so a flush in the
+  // middle of a frame never overwrites vertices the gpu may still be reading. A slice gets reused after FramesInFlight flushes
+  static void RenderBatchAdvanceFrame(RenderBatch *batch)
+  {
+    RenderBatch::FrameResources &frame = batch->Frames[batch->CurrentFrame];
+    if (batch->FrameSynced)
+    {
+      frame.Fence = glCall(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
     }
 
-    batch->CurrentDraw = 0;
-    batch->DrawCalls[0] = RenderBatch::DrawCall{};
-    batch->VertexCounter = 0;
+    batch->CurrentFrame = (batch->CurrentFrame + 1) % batch->FramesInFlight;
+    batch->FrameSynced = false;
   }
 
-  R_API void srEnableScissor(float x, float y, float width, float height)
+  R_API void srSetFramesInFlight(unsigned int count)
+  {
+    RenderBatch &rb = SRC->MainRenderBatch;
+    count = srClamp(count, 1u, (unsigned int)SR_MAX_FRAMES_IN_FLIGHT);
+    if (count == rb.FramesInFlight)
+    {
+      return;
+    }
+
+    // Drain every pending frame, so no slot gets lost when the ring size changes
+    for (unsigned int i = 0; i < SR_MAX_FRAMES_IN_FLIGHT; i++)
+    {
+      RenderBatchWaitForFrame(rb.Frames[i]);
+    }
+    rb.FramesInFlight = count;
+    rb.CurrentFrame = rb.CurrentFrame % count;
+  }
+
+  R_API unsigned int srGetFramesInFlight()
+  {
+    return SRC->MainRenderBatch.FramesInFlight;
+  }
+
+  R_API double srGetFenceWaitTime()
+  {
+    return SRC->MainRenderBatch.LastFenceWaitTime;
+  }
+
+  // Set on the threads that tessellate deferred paths. The batch functions record into it instead of the main batch
+  static thread_local RenderBatch *tPathWorkerBatch = nullptr;
+  static thread_local bool tPathWorkerOverflow = false;
+
+  static RenderBatch &RecordingBatch()
+  {
+    return tPathWorkerBatch ? *tPathWorkerBatch : SRC->MainRenderBatch;
+  }
+
+  static void PathQueueFlush();
+
+  R_API void srIncreaseRenderBatchCurrentDraw(RenderBatch *batch)
+  {
+    if (batch->CurrentDraw + 1 < SR_BATCH_DRAW_CALLS)
+    {
+      batch->CurrentDraw++;
+    }
+    else if (batch == tPathWorkerBatch)
+    {
+      tPathWorkerOverflow = true; // Keeps adding to the last draw call. The path gets drawn again by the flushing thread
+    }
+    else
+    {
+      srDrawRenderBatch(batch);
+    }
+  }
+
+  R_API bool srCheckRenderBatchLimit(unsigned int numVerts, unsigned int numIndices)
+  {
+    bool overflow = false;
+    RenderBatch &rb = RecordingBatch();
+    if (&rb == tPathWorkerBatch)
+    {
+      PathWorkerBatchReserve(rb, numVerts, numIndices);
+      return false;
+    }
+
+    if (rb.VertexCounter + numVerts >= rb.DrawBuffer.ElementCount || rb.IndexCounter + numIndices > rb.DrawBuffer.IndexCapacity)
+    {
+      // Continue with the same state in the new batch
+      RenderBatch::DrawCall currentDraw = rb.DrawCalls[rb.CurrentDraw];
+
+      srDrawRenderBatch(&rb);
+
+      currentDraw.VertexCount = 0;
+      currentDraw.VertexAlignment = 0;
+      currentDraw.IndexCount = 0;
+      rb.DrawCalls[rb.CurrentDraw] = currentDraw;
+      overflow = true;
+    }
+    return overflow;
+  }
+
+  static void RenderBatchApplyStencil(StencilMode_ mode)
+  {
+    switch (mode)
+    {
+    case StencilMode_None:
+      glDisable(GL_STENCIL_TEST);
+      glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+      glDepthMask(GL_TRUE);
+      break;
+    case StencilMode_WriteNonZero:
+      glEnable(GL_STENCIL_TEST);
+      glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+      glDepthMask(GL_FALSE);
+      glStencilFunc(GL_ALWAYS, 0, 0xff);
+      glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+      glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+      break;
+    case StencilMode_WriteEvenOdd:
+      glEnable(GL_STENCIL_TEST);
+      glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+      glDepthMask(GL_FALSE);
+      glStencilFunc(GL_ALWAYS, 0, 0xff);
+      glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+      break;
+    case StencilMode_Cover:
+      glEnable(GL_STENCIL_TEST);
+      glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+      glDepthMask(GL_TRUE);
+      glStencilFunc(GL_NOTEQUAL, 0, 0xff);
+      glStencilOp(GL_KEEP, GL_ZERO, GL_ZERO); // Leave the stencil cleared for the next path
+      break;
+    }
+  }
+
+  // Draws count vertices starting at first as instanced quads. There is no base instance before GL 4.2, so the
+  // attributes of the segment vertex array get pointed at the first vertex instead
+  static void RenderBatchDrawSegments(RenderBatch *batch, Shader shader, unsigned int first, unsigned int count)
+  {
+    srShaderSetUniform1f(shader, "PixelScale", srGetPixelScale());
+    srShaderSetUniform1b(shader, "AntiAliasing", SRC->AntiAliasing);
+
+    const size_t base = first * sizeof(RenderBatch::Vertex);
+    srBindVertexArray(batch->DrawBuffer.SegmentVAO);
+    srSetVertexAttribute(0, 3, GL_FLOAT, GL_FALSE, sizeof(RenderBatch::Vertex), (const void *)(base + offsetof(RenderBatch::Vertex, Pos)));
+    srSetVertexAttribute(1, 3, GL_FLOAT, GL_FALSE, sizeof(RenderBatch::Vertex), (const void *)(base + offsetof(RenderBatch::Vertex, Normal)));
+    srSetVertexAttribute(2, 2, GL_FLOAT, GL_FALSE, sizeof(RenderBatch::Vertex), (const void *)(base + offsetof(RenderBatch::Vertex, UV)));
+    srSetVertexAttribute(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(RenderBatch::Vertex), (const void *)(base + offsetof(RenderBatch::Vertex, Color1)));
+    glCall(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count));
+    srBindVertexArray(batch->DrawBuffer.GlBinding.VAO);
+  }
+
+  R_API void srDrawRenderBatch(RenderBatch *batch)
+  {
+    if (batch == &SRC->MainRenderBatch)
+    {
+      PathQueueFlush();
+    }
+    if (!srBindVertexArray(batch->DrawBuffer.GlBinding.VAO))
+    {
+      for (const auto &buffer : batch->DrawBuffer.GlBinding.VBOs)
+      {
+        srBindVertexBuffer(buffer.ID);
+        unsigned int vertexSize = srGetVertexLayoutSize(buffer.Layout);
+        unsigned int currentOffset = 0;
+        for (const VertexArrayLayoutElement &elem : buffer.Layout)
+        {
+          srSetVertexAttribute(elem.Location, srGetVertexAttributeComponentCount(elem.ElementType), srGetGLVertexAttribType(elem.ElementType), elem.Normalized, vertexSize, (const void *)(unsigned long long)currentOffset);
+          srEnableVertexAttribute(elem.Location);
+          currentOffset += srGetVertexAttributeTypeSize(elem.ElementType);
+        }
+      }
+    }
+
+    RenderBatchSyncFrame(batch);
+    GradientAtlasBind();
+
+    srBindVertexBuffer(batch->DrawBuffer.GlBinding.VBOs[0].ID);
+    RenderBatchUploadVertices(batch);
+
+    const unsigned int sliceOffset = batch->Frames[batch->CurrentFrame].VertexOffset;
+    const unsigned int indexSliceOffset = batch->DrawBuffer.IndexCapacity * (1 + batch->CurrentFrame);
+    if (batch->IndexCounter > 0)
+    {
+      glCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexSliceOffset * sizeof(unsigned int), batch->IndexCounter * sizeof(unsigned int), batch->DrawBuffer.DynamicIndices));
+    }
+
+    // Draw everything to current draw
+    for (unsigned int i = 0, vertexOffset = 0, indexOffset = indexSliceOffset; i <= batch->CurrentDraw; i++)
+    {
+      RenderBatch::DrawCall &drawCall = batch->DrawCalls[i];
+      Shader shader = drawCall.Mode == EBatchDrawMode::SEGMENTS ? SRC->SegmentShader : SRC->DefaultShader;
+      if (drawCall.Mat.ShaderProgram.ID != 0)
+      {
+        shader = drawCall.Mat.ShaderProgram;
+      }
+
+      if (!drawCall.Scissor.Enabled)
+      {
+        glDisable(GL_SCISSOR_TEST);
+      }
+      else
+      {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(drawCall.Scissor.X, drawCall.Scissor.Y, drawCall.Scissor.Width, drawCall.Scissor.Height);
+      }
+
+      RenderBatchApplyStencil(drawCall.Stencil);
+
+      srSetDefaultShaderUniforms(shader);
+      if (srShaderGetUniformLocation("UseTexture", shader, false) != -1)
+      {
+        srShaderSetUniform1b(shader, "UseTexture", drawCall.Mat.Texture0.ID > 0);
+      }
+
+      glCall(glActiveTexture(GL_TEXTURE0));
+      srBindTexture(drawCall.Mat.Texture0);
+
+      EBatchDrawMode mode = drawCall.Mode;
+      switch (mode)
+      {
+      case EBatchDrawMode::POINTS:
+        glCall(glDrawArrays(GL_POINTS, sliceOffset + vertexOffset, drawCall.VertexCount));
+        break;
+      case EBatchDrawMode::LINES:
+        glCall(glDrawArrays(GL_LINES, sliceOffset + vertexOffset, drawCall.VertexCount));
+        break;
+      case EBatchDrawMode::TRIANGLES:
+        glCall(glDrawArrays(GL_TRIANGLES, sliceOffset + vertexOffset, drawCall.VertexCount));
+        break;
+      case EBatchDrawMode::QUADS:
+        glCall(glDrawElementsBaseVertex(GL_TRIANGLES, drawCall.VertexCount / 4 * 6, GL_UNSIGNED_INT, (GLvoid *)(vertexOffset / 4 * 6 * sizeof(unsigned int)), sliceOffset));
+        break;
+      case EBatchDrawMode::TRIANGLES_INDEXED:
+        // Indices are relative to the start of the batch
+        glCall(glDrawElementsBaseVertex(GL_TRIANGLES, drawCall.IndexCount, GL_UNSIGNED_INT, (GLvoid *)(indexOffset * sizeof(unsigned int)), sliceOffset));
+        break;
+      case EBatchDrawMode::SEGMENTS:
+        RenderBatchDrawSegments(batch, shader, sliceOffset + vertexOffset, drawCall.VertexCount);
+        break;
+      case EBatchDrawMode::UNKNOWN:
+        break;
+      }
+      srBindTexture({});
+      vertexOffset += drawCall.VertexCount + drawCall.VertexAlignment;
+      indexOffset += drawCall.IndexCount;
+    }
+    RenderBatchApplyStencil(StencilMode_None);
+
+    batch->CurrentDraw = 0;
+    batch->DrawCalls[0] = RenderBatch::DrawCall{};
+    batch->VertexCounter = 0;
+    batch->IndexCounter = 0;
+    batch->FlushCounter++;
+
+    RenderBatchAdvanceFrame(batch);
+  }
+
+  R_API void srEnableScissor(float x, float y, float width, float height)
   {
     SRC->Scissor.Enabled = true;
 
@@ -1287,14 +2798,18 @@ namespace sr
     SRC->Scissor.Enabled = false;
   }
 
-  R_API void srBegin(EBatchDrawMode mode)
+  R_API void srBegin(EBatchDrawMode mode, const Material &material)
   {
-    RenderBatch &rb = SRC->MainRenderBatch;
-    if (rb.DrawCalls[rb.CurrentDraw].Mode != mode || rb.DrawCalls[rb.CurrentDraw].Scissor != SRC->Scissor)
+    if (!tPathWorkerBatch)
+    {
+      PathQueueFlush(); // Queued paths come first
+    }
+    RenderBatch &rb = RecordingBatch();
+    if (rb.DrawCalls[rb.CurrentDraw].Mode != mode || rb.DrawCalls[rb.CurrentDraw].Mat != material || rb.DrawCalls[rb.CurrentDraw].Scissor != SRC->Scissor || rb.DrawCalls[rb.CurrentDraw].Stencil != SRC->Stencil)
     {
       if (rb.DrawCalls[rb.CurrentDraw].Mode == EBatchDrawMode::LINES || rb.DrawCalls[rb.CurrentDraw].Mode == EBatchDrawMode::POINTS)
         rb.DrawCalls[rb.CurrentDraw].VertexAlignment = rb.DrawCalls[rb.CurrentDraw].VertexCount % 4;
-      else if (rb.DrawCalls[rb.CurrentDraw].Mode == EBatchDrawMode::TRIANGLES)
+      else if (rb.DrawCalls[rb.CurrentDraw].Mode == EBatchDrawMode::TRIANGLES || rb.DrawCalls[rb.CurrentDraw].Mode == EBatchDrawMode::TRIANGLES_INDEXED || rb.DrawCalls[rb.CurrentDraw].Mode == EBatchDrawMode::SEGMENTS)
         rb.DrawCalls[rb.CurrentDraw].VertexAlignment = 4 - (rb.DrawCalls[rb.CurrentDraw].VertexCount % 4);
       else
         rb.DrawCalls[rb.CurrentDraw].VertexAlignment = 0;
@@ -1305,8 +2820,10 @@ namespace sr
       rb.DrawCalls[rb.CurrentDraw].Mode = mode;
       rb.DrawCalls[rb.CurrentDraw].VertexCount = 0;
       rb.DrawCalls[rb.CurrentDraw].VertexAlignment = 0;
-      rb.DrawCalls[rb.CurrentDraw].Mat = {0};
+      rb.DrawCalls[rb.CurrentDraw].IndexCount = 0;
+      rb.DrawCalls[rb.CurrentDraw].Mat = material;
       rb.DrawCalls[rb.CurrentDraw].Scissor = SRC->Scissor;
+      rb.DrawCalls[rb.CurrentDraw].Stencil = SRC->Stencil;
 
       rb.CurrentColor1 = 0xffffffff;
       rb.CurrentColor2 = 0x00000000;
@@ -1324,24 +2841,42 @@ namespace sr
   {
     srCheckRenderBatchLimit(1);
 
-    SRC->MainRenderBatch.DrawBuffer.Vertices[SRC->MainRenderBatch.VertexCounter].Pos = vertex;
-    SRC->MainRenderBatch.DrawBuffer.Vertices[SRC->MainRenderBatch.VertexCounter].UV = SRC->MainRenderBatch.CurrentTexCoord;
-    SRC->MainRenderBatch.DrawBuffer.Vertices[SRC->MainRenderBatch.VertexCounter].Normal = SRC->MainRenderBatch.CurrentNormal;
-    SRC->MainRenderBatch.DrawBuffer.Vertices[SRC->MainRenderBatch.VertexCounter].Color1 = SRC->MainRenderBatch.CurrentColor1;
-    SRC->MainRenderBatch.DrawBuffer.Vertices[SRC->MainRenderBatch.VertexCounter].Color2 = SRC->MainRenderBatch.CurrentColor2;
+    RenderBatch &rb = RecordingBatch();
+    rb.DrawBuffer.Vertices[rb.VertexCounter].Pos = vertex;
+    rb.DrawBuffer.Vertices[rb.VertexCounter].UV = rb.CurrentTexCoord;
+    rb.DrawBuffer.Vertices[rb.VertexCounter].Normal = rb.CurrentNormal;
+    rb.DrawBuffer.Vertices[rb.VertexCounter].Color1 = rb.CurrentColor1;
+    rb.DrawBuffer.Vertices[rb.VertexCounter].Color2 = rb.CurrentColor2;
 
-    SRC->MainRenderBatch.VertexCounter++;
-    SRC->MainRenderBatch.DrawCalls[SRC->MainRenderBatch.CurrentDraw].VertexCount++;
+    rb.VertexCounter++;
+    rb.DrawCalls[rb.CurrentDraw].VertexCount++;
   }
 
   R_API void srVertex2f(float x, float y)
   {
-    srVertex3f(glm::vec3(x, y, SRC->MainRenderBatch.CurrentDepth));
+    srVertex3f(glm::vec3(x, y, RecordingBatch().CurrentDepth));
   }
 
   R_API void srVertex2f(const glm::vec2 &vertex)
   {
-    srVertex3f(glm::vec3(vertex.x, vertex.y, SRC->MainRenderBatch.CurrentDepth));
+    srVertex3f(glm::vec3(vertex.x, vertex.y, RecordingBatch().CurrentDepth));
+  }
+
+  R_API unsigned int srGetCurrentVertexIndex()
+  {
+    return RecordingBatch().VertexCounter;
+  }
+
+  R_API void srIndex1ui(unsigned int index)
+  {
+    RenderBatch &rb = RecordingBatch();
+    if (rb.IndexCounter >= rb.DrawBuffer.IndexCapacity)
+    {
+      SR_TRACE("ERROR: Index buffer of the batch is full. Call srCheckRenderBatchLimit before adding indices");
+      return;
+    }
+    rb.DrawBuffer.DynamicIndices[rb.IndexCounter++] = index;
+    rb.DrawCalls[rb.CurrentDraw].IndexCount++;
   }
 
   R_API void srNormal3f(float x, float y, float z)
@@ -1351,7 +2886,7 @@ namespace sr
 
   R_API void srNormal3f(const glm::vec3 &normal)
   {
-    SRC->MainRenderBatch.CurrentNormal = normal;
+    RecordingBatch().CurrentNormal = normal;
   }
 
   R_API void srColor13f(float r, float g, float b)
@@ -1366,17 +2901,17 @@ namespace sr
 
   R_API void srColor14f(float r, float g, float b, float a)
   {
-    SRC->MainRenderBatch.CurrentColor1 = srGetColorFromFloat(r, g, b, a);
+    RecordingBatch().CurrentColor1 = srGetColorFromFloat(r, g, b, a);
   }
 
   R_API void srColor14f(const glm::vec4 &color)
   {
-    SRC->MainRenderBatch.CurrentColor1 = srGetColorFromFloat(color);
+    RecordingBatch().CurrentColor1 = srGetColorFromFloat(color);
   }
 
   R_API void srColor11c(Color color)
   {
-    SRC->MainRenderBatch.CurrentColor1 = color;
+    RecordingBatch().CurrentColor1 = color;
   }
 
   R_API void srColor23f(float r, float g, float b)
@@ -1391,32 +2926,32 @@ namespace sr
 
   R_API void srColor24f(float r, float g, float b, float a)
   {
-    SRC->MainRenderBatch.CurrentColor2 = srGetColorFromFloat(r, g, b, a);
+    RecordingBatch().CurrentColor2 = srGetColorFromFloat(r, g, b, a);
   }
 
   R_API void srColor24f(const glm::vec4 &color)
   {
-    SRC->MainRenderBatch.CurrentColor2 = srGetColorFromFloat(color);
+    RecordingBatch().CurrentColor2 = srGetColorFromFloat(color);
   }
 
   R_API void srColor21c(Color color)
   {
-    SRC->MainRenderBatch.CurrentColor2 = color;
+    RecordingBatch().CurrentColor2 = color;
   }
 
   R_API void srTextureCoord2f(float u, float v)
   {
-    SRC->MainRenderBatch.CurrentTexCoord = {u, v};
+    RecordingBatch().CurrentTexCoord = {u, v};
   }
 
   R_API void srTextureCoord2f(const glm::vec2 &uv)
   {
-    SRC->MainRenderBatch.CurrentTexCoord = uv;
+    RecordingBatch().CurrentTexCoord = uv;
   }
 
   R_API void srEnd()
   {
-    SRC->MainRenderBatch.CurrentDepth -= 0.0001f;
+    RecordingBatch().CurrentDepth -= 0.0001f;
   }
 
   R_API void srDrawRectanglePro(const glm::vec2 &position, const Rectangle &rect, float rotation, float cornerRadius, PathType pathType, PathStyle style)
@@ -1471,8 +3006,7 @@ namespace sr
   {
     RectangleCorners corners = srGetRotatedRectangle(rect, rotation) + position;
 
-    sr::srBegin(EBatchDrawMode::QUADS);
-    srPushMaterial({texture, SRC->DefaultShader});
+    sr::srBegin(EBatchDrawMode::QUADS, {texture, SRC->DefaultShader});
 
     srTextureCoord2f(0.0f, 0.0f);
     srVertex2f(corners.TopLeft);
@@ -1488,538 +3022,1692 @@ namespace sr
     sr::srEnd();
   }
 
-  R_API void srDrawGrid(const glm::vec2 &position, unsigned int columns, unsigned int rows, float cellSizeX, float cellSizeY)
+  // A SEGMENTS vertex. The second point is stored relative to the first, so cached paths can be moved by their Pos
+  static void SegmentEmit(const glm::vec2 &p0, const glm::vec2 &p1, float width, Color color, LineCap_ startCap, LineCap_ endCap)
+  {
+    srNormal3f(p1.x - p0.x, p1.y - p0.y, width);
+    srTextureCoord2f((float)startCap, (float)endCap);
+    srColor11c(color);
+    srVertex2f(p0);
+  }
+
+  R_API void srDrawLineSegment(const glm::vec2 &p0, const glm::vec2 &p1, float width, Color color, LineCap_ cap)
+  {
+    srBegin(EBatchDrawMode::SEGMENTS);
+    SegmentEmit(p0, p1, width, color, cap, cap);
+    srEnd();
+  }
+
+  R_API void srDrawGrid(const glm::vec2 &position, unsigned int columns, unsigned int rows, float cellSizeX, float cellSizeY, float thickness, Color color)
   {
-    srBegin(EBatchDrawMode::LINES);
+    srBegin(EBatchDrawMode::SEGMENTS);
     for (unsigned int y = 0; y < rows; y++)
     {
-      srVertex2f(position + glm::vec2{0.0f, y * cellSizeY});
-      srVertex2f(position + glm::vec2{columns * cellSizeX, y * cellSizeY});
+      SegmentEmit(position + glm::vec2{0.0f, y * cellSizeY}, position + glm::vec2{columns * cellSizeX, y * cellSizeY}, thickness, color, LineCap_Butt, LineCap_Butt);
     }
     for (unsigned int x = 0; x < columns; x++)
     {
-      srVertex2f(position + glm::vec2{x * cellSizeX, 0.0f});
-      srVertex2f(position + glm::vec2{x * cellSizeX, rows * cellSizeY});
+      SegmentEmit(position + glm::vec2{x * cellSizeX, 0.0f}, position + glm::vec2{x * cellSizeX, rows * cellSizeY}, thickness, color, LineCap_Butt, LineCap_Butt);
     }
     srEnd();
   }
 
   void FontTextureInit(FontTexture *result)
   {
-    result->Image = srLoadTexture(FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE, FONT_TEXTURE_DEPTH == 1 ? TextureFormat_R8 : TextureFormat_RGB8);
-    // srTextureSetData(result->Texture, FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE, FONT_TEXTURE_DEPTH == 1 ? TextureFormat_R8 : TextureFormat_RGB8, (unsigned char *)0);
-    result->Size = glm::ivec2(FONT_TEXTURE_SIZE);
-    result->ImageData = new uint8_t[FONT_TEXTURE_SIZE * FONT_TEXTURE_SIZE * FONT_TEXTURE_DEPTH];
-    result->ShelfPack = new mapbox::ShelfPack(FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE);
-    memset(result->ImageData, 0, FONT_TEXTURE_SIZE * FONT_TEXTURE_SIZE * FONT_TEXTURE_DEPTH);
+    memset(result->Latin1, 0, sizeof(result->Latin1));
+    result->Codepoints.assign(64, FontCodepoint{});
+    result->CodepointCount = 0;
+    result->Kerning.assign(64, FontKerning{});
+    result->KerningCount = 0;
   }
 
-  void FontTextureUnload(FontTexture *font_texture)
+  static FontAtlasPage &FontAtlasAddPage()
   {
-    srUnloadTexture(&font_texture->Image);
-    delete[] font_texture->ImageData;
-    delete ((mapbox::ShelfPack *)font_texture->ShelfPack);
+    FontAtlasPage page;
+    page.Image = srLoadTexture(FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE, FONT_TEXTURE_DEPTH == 1 ? TextureFormat_R8 : TextureFormat_RGB8);
+    // Glyphs are uploaded one region at a time, which would leave the mipmaps behind
+    srBindTexture(page.Image);
+    glCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    srBindTexture({0});
+    page.ImageData = new uint8_t[FONT_TEXTURE_SIZE * FONT_TEXTURE_SIZE * FONT_TEXTURE_DEPTH];
+    memset(page.ImageData, 0, FONT_TEXTURE_SIZE * FONT_TEXTURE_SIZE * FONT_TEXTURE_DEPTH);
+    page.Packer = new mapbox::ShelfPack(FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE);
+    page.GlyphCount = 0;
+    page.DirtyMin = glm::ivec2(FONT_TEXTURE_SIZE);
+    page.DirtyMax = glm::ivec2(0);
+
+    std::vector<FontAtlasPage> &pages = GetFontManager()->AtlasPages;
+    pages.push_back(page);
+    return pages.back();
   }
 
-  void FontTexturePushGlyph(FT_GlyphSlot glyph, FontTexture *result)
+  static void FontAtlasWrite(FontAtlasPage &page, const glm::ivec2 &position, const glm::ivec2 &size, const uint8_t *pixels)
   {
-    mapbox::ShelfPack &packer = *(mapbox::ShelfPack *)result->ShelfPack;
-    mapbox::Bin *bin = packer.packOne(-1, glyph->bitmap.width, glyph->bitmap.rows);
-    if (!bin)
+    for (int y = 0; y < size.y; y++)
     {
-      SR_TRACE("FontTexturePushGlyph: Could not pack glyph into texture");
-      return;
-    }
-
-    // Write bitmap data to buffer
-    for (int y = 0; y < glyph->bitmap.rows; y++)
-    {
-      memcpy(result->ImageData + (bin->y + y) * result->Size.x + bin->x, glyph->bitmap.buffer + y * glyph->bitmap.width, glyph->bitmap.width);
+      uint8_t *row = page.ImageData + (position.y + y) * FONT_TEXTURE_SIZE + position.x;
+      if (pixels)
+      {
+        memcpy(row, pixels + y * size.x, size.x);
+      }
+      else
+      {
+        memset(row, 0, size.x);
+      }
     }
-
-    float kerningx = 0.0f;
-    float kerningy = 0.0f;
-
-    FontGlyph res = {
-        glm::ivec2(glyph->bitmap.width, glyph->bitmap.rows),             // size
-        glm::ivec2(glyph->bitmap_left, glyph->bitmap_top),               // offset
-        (int)(((float)glyph->advance.x) / 64.0f),                        // advance
-        ((float)bin->x) / ((float)result->Size.x),                       // u0;
-        ((float)bin->y) / ((float)result->Size.x),                       // v0;
-        ((float)bin->x + glyph->bitmap.width) / ((float)result->Size.x), // u1;
-        ((float)bin->y + glyph->bitmap.rows) / ((float)result->Size.x),  // v1;
-        glyph->glyph_index                                               // Char code
-    };
-
-    result->CharMap[glyph->glyph_index] = res;
+    page.DirtyMin = glm::min(page.DirtyMin, position);
+    page.DirtyMax = glm::max(page.DirtyMax, position + size);
   }
 
-  const FontGlyph *FontTextureGetGlyph(const Font *font, char c)
+  // Gives the space of the glyph back to the atlas. Cleared, so glyphs packed there later do not pick up old texels at their edges.
+  // Returns whether the freed space fits the size
+  static bool FontAtlasRemoveGlyph(FontGlyph &glyph, const glm::ivec2 &size = glm::ivec2(0))
   {
-    unsigned int char_code = FT_Get_Char_Index(font->Face, c);
-
-    if (font->Texture.CharMap.find(char_code) != font->Texture.CharMap.end())
+    if (glyph.Bin < 0)
+    {
+      return false;
+    }
+    FontAtlasPage &page = GetFontManager()->AtlasPages[glyph.Page];
+    mapbox::Bin *bin = page.Packer->getBin(glyph.Bin);
+    glyph.Bin = -1;
+    if (!bin || page.Packer->unref(*bin) != 0)
     {
-      return &font->Texture.CharMap.at(char_code);
+      return false;
     }
-    return nullptr;
-  }
 
-  void LoadGlyph(char c, Font *font)
-  {
-    unsigned int char_code = FT_Get_Char_Index(font->Face, c);
-    FT_Load_Glyph(font->Face, char_code, FT_LOAD_DEFAULT);
-    FT_Render_Glyph(font->Face->glyph, FT_RENDER_MODE_SDF);
-    FontTexturePushGlyph(font->Face->glyph, &font->Texture);
+    FontAtlasWrite(page, glm::ivec2(bin->x, bin->y), glm::ivec2(bin->maxw, bin->maxh), nullptr);
+    if (--page.GlyphCount == 0)
+    {
+      page.Packer->clear(); // Freed bins are never merged, an empty page takes any size again
+      return true;
+    }
+    return bin->maxw >= size.x && bin->maxh >= size.y;
   }
 
-  void FontGetKerning(Font *font, unsigned int c1, unsigned int c2, int *x, int *y)
+  void FontTextureUnload(FontTexture *font_texture)
   {
-    FT_Vector kerning{};
-    FT_Get_Kerning(font->Face, c1, c2, FT_KERNING_DEFAULT, &kerning);
-    *x = kerning.x >> 6;
-    *y = kerning.y >> 6;
+    for (FontGlyph &glyph : font_texture->Glyphs)
+    {
+      FontAtlasRemoveGlyph(glyph);
+    }
+    font_texture->Glyphs.clear();
   }
 
-  bool FontManagerHasFontLoaded(FontHandle handle)
+  // Evicts the glyphs that were not used for the longest time to make room for the size. Glyphs of the current frame stay,
+  // their quads may still wait in the batch. Evicts a few at once, so a full atlas is not searched for every new glyph
+  static bool FontAtlasEvict(const glm::ivec2 &size)
   {
-    return GetFontManager()->LoadedFonts.find(handle) != GetFontManager()->LoadedFonts.end();
-  }
+    FontManager *manager = GetFontManager();
+    std::vector<FontGlyph *> cold;
+    std::vector<uint32_t> newest(manager->AtlasPages.size(), 0); // Last use of any glyph on the page
+    for (auto &face : manager->Faces)
+    {
+      for (FontGlyph &glyph : face.second->Texture.Glyphs)
+      {
+        if (glyph.Bin >= 0)
+        {
+          newest[glyph.Page] = srMax(newest[glyph.Page], glyph.LastUsed);
+          if (glyph.LastUsed < manager->Frame)
+          {
+            cold.push_back(&glyph);
+          }
+        }
+      }
+    }
+    std::sort(cold.begin(), cold.end(), [](const FontGlyph *a, const FontGlyph *b)
+              { return a->LastUsed < b->LastUsed; });
 
-  const Font *FontManagerGetFont(FontHandle handle)
-  {
-    if (!FontManagerHasFontLoaded(handle))
+    bool fits = false;
+    size_t evicted = 0;
+    for (; evicted < cold.size() && evicted < FONT_ATLAS_EVICT_COUNT; evicted++)
     {
-      return nullptr;
+      fits = FontAtlasRemoveGlyph(*cold[evicted], size) || fits;
     }
-    return &GetFontManager()->LoadedFonts.at(handle);
-  }
 
-  FontHandle FontManagerLoadFont(Font font)
-  {
-    FontHandle new_handle = GetFontManager()->LoadedFonts.size();
-    while (FontManagerHasFontLoaded(new_handle))
+    // Freed bins are never merged, so none of them may be large enough. The page used longest ago is emptied then
+    if (!fits)
     {
-      new_handle++;
+      size_t page = std::min_element(newest.begin(), newest.end()) - newest.begin();
+      if (page < newest.size() && newest[page] < manager->Frame)
+      {
+        for (FontGlyph *glyph : cold)
+        {
+          if (glyph->Page == page && glyph->Bin >= 0)
+          {
+            fits = FontAtlasRemoveGlyph(*glyph, size) || fits;
+            evicted++;
+          }
+        }
+      }
     }
-    GetFontManager()->LoadedFonts[new_handle] = font;
-    return new_handle;
+    if (evicted > 0)
+    {
+      manager->AtlasGeneration++;
+    }
+    return fits;
   }
 
-  void FontManagerUnloadFont(FontHandle handle)
+  // Uploads the rectangle around the glyphs added to each page since the last upload
+  void FontAtlasUpload()
   {
-    if (!FontManagerHasFontLoaded(handle))
+    const unsigned int format = srTextureFormatToGL(FONT_TEXTURE_DEPTH == 1 ? TextureFormat_R8 : TextureFormat_RGB8);
+    for (FontAtlasPage &page : GetFontManager()->AtlasPages)
     {
-      SR_TRACE("ERROR: Cant unload font with handle (%d). Font does not exist!", handle);
-      return;
+      if (page.DirtyMax.x <= page.DirtyMin.x || page.DirtyMax.y <= page.DirtyMin.y)
+      {
+        continue;
+      }
+
+      const glm::ivec2 offset = page.DirtyMin;
+      const glm::ivec2 size = page.DirtyMax - page.DirtyMin;
+      srBindTexture(page.Image);
+      glCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+      glCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, FONT_TEXTURE_SIZE));
+      glCall(glTexSubImage2D(GL_TEXTURE_2D, 0, offset.x, offset.y, size.x, size.y, format, GL_UNSIGNED_BYTE, page.ImageData + (offset.y * FONT_TEXTURE_SIZE + offset.x) * FONT_TEXTURE_DEPTH));
+      glCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+      srBindTexture({0});
+
+      page.DirtyMin = glm::ivec2(FONT_TEXTURE_SIZE);
+      page.DirtyMax = glm::ivec2(0);
     }
-    Font &font = GetFontManager()->LoadedFonts.at(handle);
-    delete font.Face;
-    FontTextureUnload(&font.Texture);
-    GetFontManager()->LoadedFonts.erase(handle);
   }
 
-  FontHandle srInitializeFont(Font font, unsigned int size)
+  // Finds space for a glyph in the atlas. Adds a page while the budget allows, evicts cold glyphs after that.
+  // nullptr when every glyph is in use
+  static mapbox::Bin *FontAtlasPack(const glm::ivec2 &size, unsigned int *page)
   {
-    FontTextureInit(&font.Texture);
-    FT_Set_Char_Size(
-        font.Face, // handle to face object
-        0,         // char_width in 1/64 of points
-        size * 64, // char_height in 1/64 of points
-        96,        // horizontal device resolution
-        96);
-    font.Size = size;
-    font.LineHeight = font.Face->size->metrics.height / 64;
-    font.LineTop = font.Face->size->metrics.ascender / 64;
-    font.LineBottom = font.Face->size->metrics.descender / 64;
-    SR_TRACE("Loaded font. Line height = %d", font.LineHeight);
-    // Load first 128 chars
-    static const char *text = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ -_.:,;#'+*1234567890!\"§$%&/\\[{()}]@€";
-    for (char c = 0; c < strlen(text); c++)
+    FontManager *manager = GetFontManager();
+    std::vector<FontAtlasPage> &pages = manager->AtlasPages;
+    if (size.x > (int)FONT_TEXTURE_SIZE || size.y > (int)FONT_TEXTURE_SIZE)
     {
-      LoadGlyph(text[c], &font);
+      return nullptr;
     }
 
-    srTextureSetData(font.Texture.Image, FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE, FONT_TEXTURE_DEPTH == 1 ? TextureFormat_R8 : TextureFormat_RGB8, (unsigned char *)font.Texture.ImageData);
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+      for (size_t i = 0; i < pages.size(); i++)
+      {
+        mapbox::Bin *bin = pages[i].Packer->packOne(-1, size.x, size.y);
+        if (bin)
+        {
+          pages[i].GlyphCount++;
+          *page = i;
+          return bin;
+        }
+      }
 
-    return FontManagerLoadFont(font);
+      const size_t pageBytes = FONT_TEXTURE_SIZE * FONT_TEXTURE_SIZE * FONT_TEXTURE_DEPTH;
+      if (pages.empty() || (pages.size() + 1) * pageBytes <= manager->AtlasBudget)
+      {
+        FontAtlasPage &added = FontAtlasAddPage();
+        added.GlyphCount++;
+        *page = pages.size() - 1;
+        return added.Packer->packOne(-1, size.x, size.y);
+      }
+      if (!FontAtlasEvict(size))
+      {
+        break;
+      }
+    }
+    return nullptr;
   }
 
-  R_API FontHandle srLoadFont(const char *filePath, unsigned int size)
+  // A glyph rendered by FreeType, before it is packed into the atlas
+  struct FontGlyphBitmap
   {
-    Font result{};
+    unsigned int GlyphIndex;
+    glm::ivec2 Size;
+    glm::ivec2 Offset;
+    int Advance;
+    std::vector<uint8_t> Pixels; // Rows of Size.x bytes
+    bool Rendered;
+  };
 
-    if (FT_New_Face(GetFontManager()->Libary, filePath, 0, &result.Face) != 0)
+  static bool FontRenderGlyph(FT_Face face, unsigned int glyph_index, FontGlyphBitmap &bitmap)
+  {
+    bitmap.GlyphIndex = glyph_index;
+    bitmap.Rendered = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT) == 0 && FT_Render_Glyph(face->glyph, FT_RENDER_MODE_SDF) == 0;
+    if (!bitmap.Rendered)
     {
-      SR_TRACE("ERROR: Could not load font from file %s", filePath);
-      return -1;
+      return false;
     }
-    return srInitializeFont(result, size);
-  }
-
-  R_API FontHandle srLoadFontFromMemory(const unsigned char *data, unsigned int data_size, unsigned int font_size)
-  {
-    Font result{};
 
-    if (FT_New_Memory_Face(GetFontManager()->Libary, data, data_size, 0, &result.Face) != 0)
+    const FT_GlyphSlot glyph = face->glyph;
+    bitmap.Size = glm::ivec2(glyph->bitmap.width, glyph->bitmap.rows);
+    bitmap.Offset = glm::ivec2(glyph->bitmap_left, glyph->bitmap_top);
+    bitmap.Advance = (int)(((float)glyph->advance.x) / 64.0f);
+    bitmap.Pixels.resize(bitmap.Size.x * bitmap.Size.y);
+    for (int y = 0; y < bitmap.Size.y; y++)
     {
-      SR_TRACE("ERROR: Could not load font from memory");
-      return -1;
+      memcpy(bitmap.Pixels.data() + y * bitmap.Size.x, glyph->bitmap.buffer + y * glyph->bitmap.pitch, bitmap.Size.x);
     }
-    return srInitializeFont(result, font_size);
+    return true;
   }
 
-  R_API void srUnloadFont(FontHandle handle)
+  // Packs the rendered glyph into the atlas. false when there is no room, the glyph then keeps no quad
+  static bool FontAtlasPlaceGlyph(FontGlyph &glyph, const FontGlyphBitmap &bitmap)
   {
-    FontManagerUnloadFont(handle);
+    mapbox::Bin *bin = FontAtlasPack(bitmap.Size, &glyph.Page);
+    if (!bin)
+    {
+      SR_TRACE("FontAtlasPlaceGlyph: Could not pack glyph into texture");
+      glyph.Bin = -1;
+      return false;
+    }
+
+    FontAtlasWrite(GetFontManager()->AtlasPages[glyph.Page], glm::ivec2(bin->x, bin->y), bitmap.Size, bitmap.Pixels.data());
+    glyph.Bin = bin->id;
+    glyph.u0 = ((float)bin->x) / ((float)FONT_TEXTURE_SIZE);
+    glyph.v0 = ((float)bin->y) / ((float)FONT_TEXTURE_SIZE);
+    glyph.u1 = ((float)bin->x + bitmap.Size.x) / ((float)FONT_TEXTURE_SIZE);
+    glyph.v1 = ((float)bin->y + bitmap.Size.y) / ((float)FONT_TEXTURE_SIZE);
+    return true;
   }
 
-  R_API int srFontGetTextWidth(FontHandle handle, const char *text)
+  // Adds the glyph to the face and packs it into the atlas. Returns its index in Glyphs
+  unsigned int FontTexturePushGlyph(const FontGlyphBitmap &bitmap, FontTexture *result)
   {
-    if (!FontManagerHasFontLoaded(handle))
+    FontGlyph res = {
+        bitmap.Size,              // size
+        bitmap.Offset,            // offset
+        bitmap.Advance,           // advance
+        0.0f,                     // u0;
+        0.0f,                     // v0;
+        0.0f,                     // u1;
+        0.0f,                     // v1;
+        bitmap.GlyphIndex,        // Char code
+        0,                        // Page
+        -1,                       // Bin
+        GetFontManager()->Frame   // Last used
+    };
+
+    // Empty glyphs like the space only need their advance. Glyphs that do not fit keep their metrics, so the text keeps
+    // its width, and get another try when they are laid out again
+    if (bitmap.Size.x > 0 && bitmap.Size.y > 0)
     {
-      SR_TRACE("ERROR: Could not get line height. Font not found with handle %d!", handle);
-      return 0;
+      FontAtlasPlaceGlyph(res, bitmap);
     }
-    const Font &font = *FontManagerGetFont(handle);
-    int max_line_width = 0;
-    int current_line_width = 0;
 
-    unsigned int prev = 0;
+    result->Glyphs.push_back(res);
+    result->GlyphIndices[bitmap.GlyphIndex] = result->Glyphs.size() - 1;
+    return result->Glyphs.size() - 1;
+  }
+
+  static uint32_t FontKerningPair(unsigned int first, unsigned int second)
+  {
+    return ((first + 1) << 16) | second;
+  }
 
-    for (size_t i = 0; i < strlen(text); i++)
+  // Slot of the pair, or the empty slot it would go into
+  static uint32_t FontTextureFindKerning(const FontTexture *font_texture, uint32_t pair)
+  {
+    const uint32_t mask = font_texture->Kerning.size() - 1;
+    uint32_t hash = pair * 2654435761u;
+    hash ^= hash >> 16; // The low bits of the product only depend on the second glyph
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
     {
-      char c = text[i];
-      if (c == '\n')
+      const FontKerning &slot = font_texture->Kerning[i];
+      if (slot.Pair == pair || slot.Pair == 0)
       {
-        max_line_width = srMax(max_line_width, current_line_width);
-        current_line_width = 0;
-        continue;
+        return i;
       }
-      const FontGlyph *glyph = FontTextureGetGlyph(&font, c);
-      if (glyph)
+    }
+  }
+
+  static void FontTextureInsertKerning(FontTexture *font_texture, unsigned int first, unsigned int second, int x)
+  {
+    // At most a quarter full, so most lookups end on the first slot
+    if ((font_texture->KerningCount + 1) * 4 > font_texture->Kerning.size())
+    {
+      std::vector<FontKerning> old(font_texture->Kerning.size() * 2);
+      old.swap(font_texture->Kerning);
+      for (const FontKerning &slot : old)
       {
-        unsigned int char_index = glyph->CharCode;
-        if (prev)
+        if (slot.Pair != 0)
         {
-          FT_Vector kerning{};
-          FT_Get_Kerning(font.Face, prev, char_index, FT_KERNING_DEFAULT, &kerning);
-          current_line_width += (kerning.x >> 6);
+          font_texture->Kerning[FontTextureFindKerning(font_texture, slot.Pair)] = slot;
         }
-        current_line_width += glyph->advance;
       }
     }
 
-    max_line_width = srMax(max_line_width, current_line_width);
-
-    return max_line_width;
+    FontKerning &slot = font_texture->Kerning[FontTextureFindKerning(font_texture, FontKerningPair(first, second))];
+    if (slot.Pair == 0)
+    {
+      font_texture->KerningCount++;
+    }
+    slot = {FontKerningPair(first, second), x};
   }
 
-  R_API int srFontGetTextHeight(FontHandle font, const char *text)
+  // Asks FreeType for the kerning between a new glyph and every glyph loaded before, in both orders. Kept unrounded,
+  // since it is scaled to the size of each font
+  static void FontAddKerning(FontFace *face, unsigned int glyph)
   {
-    size_t str_len = strlen(text);
-    if (str_len == 0)
+    FontTexture &font_texture = face->Texture;
+    if (!FT_HAS_KERNING(face->Handle) || glyph >= 0xFFFF)
     {
-      return 0;
+      return;
     }
-    int line_count = 1;
-    for (size_t i = 0; i < str_len; i++)
+
+    const unsigned int glyph_index = font_texture.Glyphs[glyph].CharCode;
+    for (unsigned int other = 0; other <= glyph; other++)
     {
-      if (text[i] == '\n')
+      const unsigned int other_index = font_texture.Glyphs[other].CharCode;
+      FT_Vector kerning{};
+      FT_Get_Kerning(face->Handle, other_index, glyph_index, FT_KERNING_UNFITTED, &kerning);
+      if (kerning.x != 0)
       {
-        line_count++;
+        FontTextureInsertKerning(&font_texture, other, glyph, kerning.x);
+      }
+      if (other != glyph)
+      {
+        kerning = FT_Vector{};
+        FT_Get_Kerning(face->Handle, glyph_index, other_index, FT_KERNING_UNFITTED, &kerning);
+        if (kerning.x != 0)
+        {
+          FontTextureInsertKerning(&font_texture, glyph, other, kerning.x);
+        }
       }
     }
-
-    return sr::srFontGetLineHeight(font) * line_count;
   }
 
-  R_API glm::ivec2 srFontGetTextSize(FontHandle handle, const char *text)
+  // Returns the index of the glyph in Glyphs, or -1 when FreeType can not render it
+  int LoadGlyph(unsigned int glyph_index, FontFace *face)
   {
-    return {
-        srFontGetTextWidth(handle, text),
-        srFontGetTextHeight(handle, text)};
+    auto found = face->Texture.GlyphIndices.find(glyph_index);
+    if (found != face->Texture.GlyphIndices.end())
+    {
+      return found->second; // Another codepoint with the same glyph
+    }
+    static FontGlyphBitmap bitmap;
+    if (!FontRenderGlyph(face->Handle, glyph_index, bitmap))
+    {
+      SR_TRACE("ERROR: Could not render glyph %u", glyph_index);
+      return -1;
+    }
+    const unsigned int glyph = FontTexturePushGlyph(bitmap, &face->Texture);
+    FontAddKerning(face, glyph);
+    return glyph;
   }
 
-  R_API int srFontGetLineTop(FontHandle handle)
+  // Renders an evicted glyph into the atlas again
+  static bool FontGlyphMakeResident(FontFace *face, FontGlyph &glyph)
   {
-    if (!FontManagerHasFontLoaded(handle))
+    static FontGlyphBitmap bitmap;
+    if (!FontRenderGlyph(face->Handle, glyph.CharCode, bitmap))
     {
-      SR_TRACE("ERROR: Could not get line top. Font not found with handle %d!", handle);
-      return 0;
+      return false;
     }
-    return FontManagerGetFont(handle)->LineTop;
+    return FontAtlasPlaceGlyph(glyph, bitmap);
   }
 
-  R_API int srFontGetLineBottom(FontHandle handle)
+  // Slot of the codepoint, or the empty slot it would go into
+  static FontCodepoint &FontTextureFindCodepoint(FontTexture *font_texture, uint32_t codepoint)
   {
-    if (!FontManagerHasFontLoaded(handle))
+    const uint32_t mask = font_texture->Codepoints.size() - 1;
+    for (uint32_t i = (codepoint * 2654435761u) & mask;; i = (i + 1) & mask)
     {
-      SR_TRACE("ERROR: Could not get line bottom. Font not found with handle %d!", handle);
-      return 0;
+      FontCodepoint &slot = font_texture->Codepoints[i];
+      if (slot.Codepoint == codepoint || slot.Codepoint == 0)
+      {
+        return slot;
+      }
     }
-    return FontManagerGetFont(handle)->LineBottom;
   }
 
-  R_API int srFontGetLineHeight(FontHandle handle)
+  static void FontTextureInsertCodepoint(FontTexture *font_texture, uint32_t codepoint, unsigned int glyph)
   {
-    if (!FontManagerHasFontLoaded(handle))
+    if (codepoint < 256)
     {
-      SR_TRACE("ERROR: Could not get line height. Font not found with handle %d!", handle);
-      return 0;
+      font_texture->Latin1[codepoint] = glyph + 1;
+      return;
     }
-    return FontManagerGetFont(handle)->LineHeight;
-  }
 
-  R_API int srFontGetSize(FontHandle handle)
-  {
-    if (!FontManagerHasFontLoaded(handle))
+    // At most half full, so probes stay short
+    if ((font_texture->CodepointCount + 1) * 2 > font_texture->Codepoints.size())
     {
-      SR_TRACE("ERROR: Could not get font size. Font not found with handle %d!", handle);
-      return 0;
+      std::vector<FontCodepoint> old(font_texture->Codepoints.size() * 2);
+      old.swap(font_texture->Codepoints);
+      for (const FontCodepoint &slot : old)
+      {
+        if (slot.Codepoint != 0)
+        {
+          FontTextureFindCodepoint(font_texture, slot.Codepoint) = slot;
+        }
+      }
     }
-    return FontManagerGetFont(handle)->Size;
+
+    FontCodepoint &slot = FontTextureFindCodepoint(font_texture, codepoint);
+    if (slot.Codepoint == 0)
+    {
+      font_texture->CodepointCount++;
+    }
+    slot = {codepoint, glyph};
   }
 
-  R_API const char *srFontGetName(FontHandle handle)
+  // Looks the codepoint up in FreeType and renders its glyph. Only happens the first time a codepoint is used
+  static FontGlyph *FontLoadCodepoint(FontFace *face, uint32_t codepoint)
   {
-    if (!FontManagerHasFontLoaded(handle))
+    const int glyph = LoadGlyph(FT_Get_Char_Index(face->Handle, codepoint), face);
+    if (glyph < 0)
     {
-      SR_TRACE("ERROR: Could not get font size. Font not found with handle %d!", handle);
-      return 0;
+      return nullptr;
     }
-    return FontManagerGetFont(handle)->Face->family_name;
+    FontTextureInsertCodepoint(&face->Texture, codepoint, glyph);
+    return &face->Texture.Glyphs[glyph];
   }
 
-  R_API unsigned int srFontGetTextureId(FontHandle handle)
+  // Drawing and measuring text only goes through these tables. Latin-1 is loaded with the font
+  FontGlyph *FontTextureGetGlyph(FontFace *face, uint32_t codepoint)
   {
-    const Font *font_ptr = FontManagerGetFont(handle);
-    if (!font_ptr)
+    FontTexture &font_texture = face->Texture;
+    if (codepoint < 256)
     {
-      SR_TRACE("ERROR: Could not get line height. Font not found with handle %d!", handle);
-      return 0;
+      const uint32_t glyph = font_texture.Latin1[codepoint];
+      return glyph != 0 ? &font_texture.Glyphs[glyph - 1] : nullptr;
     }
-    const Font &font = *font_ptr;
 
-    return font.Texture.Image.ID;
+    const FontCodepoint &slot = FontTextureFindCodepoint(&font_texture, codepoint);
+    if (slot.Codepoint == codepoint)
+    {
+      return &font_texture.Glyphs[slot.Glyph];
+    }
+    return FontLoadCodepoint(face, codepoint);
   }
 
-  R_API void srDrawText(FontHandle handle, const char *text, const glm::vec2 &position, Color color, float outline_thickness, Color outline_color)
+  // Decodes the codepoint at text and moves text past it. Malformed sequences give U+FFFD and skip one byte
+  static uint32_t Utf8Next(const char **text)
   {
-    const Font *font_ptr = FontManagerGetFont(handle);
-    if (!font_ptr)
+    const unsigned char *s = (const unsigned char *)*text;
+    uint32_t codepoint = 0xFFFD;
+    unsigned int length = 1;
+    if (s[0] < 0x80)
     {
-      SR_TRACE("ERROR: Could not draw text. Font not found with handle %d!", handle);
-      return;
+      codepoint = s[0];
     }
-    const Font &font = *font_ptr;
-
-    const size_t textLen = strlen(text);
-
-    srBegin(EBatchDrawMode::QUADS);
-    srColor11c(color);
-    srColor21c(outline_color);
-    srPushMaterial({font.Texture.Image, SRC->DistanceFieldShader});
-
-    float currentDepth = SRC->MainRenderBatch.CurrentDepth;
-
-    unsigned int prev = 0;
-
-    bool has_kerning = FT_HAS_KERNING(font.Face);
-
-    glm::ivec2 pos = position;
-    for (size_t i = 0; i < textLen; i++)
+    else if ((s[0] & 0xE0) == 0xC0 && (s[1] & 0xC0) == 0x80)
     {
-      char c = text[i];
-      if (c == '\n')
-      {
-        pos.x = position.x;
-        pos.y = pos.y + font.LineHeight;
-        continue;
-      }
-      const FontGlyph *glyph = FontTextureGetGlyph(font_ptr, c);
-      if (glyph)
-      {
-        unsigned int char_index = glyph->CharCode;
-        if (prev && has_kerning)
-        {
-          FT_Vector kerning{};
-          FT_Get_Kerning(font.Face, prev, char_index, FT_KERNING_DEFAULT, &kerning);
-          pos.x += (kerning.x >> 6);
-        }
-        FT_Load_Glyph(font.Face, char_index, FT_LOAD_RENDER);
-
-        float x0 = pos.x + (glyph->Offset.x);
-        float y0 = pos.y - (glyph->Offset.y);
-        float x1 = x0 + (glyph->Size.x);
-        float y1 = y0 + (glyph->Size.y);
-
-        float u0 = glyph->u0;
-        float v0 = glyph->v0;
-        float u1 = glyph->u1;
-        float v1 = glyph->v1;
-
-        srTextureCoord2f(u0, v1);
-        srNormal3f(outline_thickness, 0.0f, 0.0f);
-        srVertex3f(x0, y1, currentDepth);
-
-        srTextureCoord2f(u0, v0);
-        srNormal3f(outline_thickness, 0.0f, 0.0f);
-        srVertex3f(x0, y0, currentDepth);
-
-        srTextureCoord2f(u1, v0);
-        srNormal3f(outline_thickness, 0.0f, 0.0f);
-        srVertex3f(x1, y0, currentDepth);
-
-        srTextureCoord2f(u1, v1);
-        srNormal3f(outline_thickness, 0.0f, 0.0f);
-        srVertex3f(x1, y1, currentDepth);
+      codepoint = ((s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+      length = codepoint >= 0x80 ? 2 : 1;
+    }
+    else if ((s[0] & 0xF0) == 0xE0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80)
+    {
+      codepoint = ((s[0] & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+      length = codepoint >= 0x800 && (codepoint < 0xD800 || codepoint > 0xDFFF) ? 3 : 1;
+    }
+    else if ((s[0] & 0xF8) == 0xF0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80)
+    {
+      codepoint = ((s[0] & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+      length = codepoint >= 0x10000 && codepoint <= 0x10FFFF ? 4 : 1;
+    }
 
-        pos.x += glyph->advance;
-        prev = char_index;
-        currentDepth -= 0.0001f;
-      }
+    if (length == 1 && s[0] >= 0x80)
+    {
+      codepoint = 0xFFFD; // Overlong, surrogate or out of range
     }
-    SRC->MainRenderBatch.CurrentDepth = currentDepth;
-    srEnd();
+    *text += length;
+    return codepoint;
   }
 
-  R_API void srDrawCircle(const glm::vec2 &center, float radius, Color color, unsigned int segmentCount)
+  // Horizontal kerning in pixels of the face size between two glyphs, by their index in Glyphs. first is -1 at the
+  // start of a line
+  float FontGetKerning(const FontFace *face, int first, unsigned int second)
   {
-    srDrawArc(center, 0.0f, 360.0f, radius, color, segmentCount);
+    if (first < 0 || face->Texture.KerningCount == 0)
+    {
+      return 0.0f;
+    }
+    const FontTexture &font_texture = face->Texture;
+    return font_texture.Kerning[FontTextureFindKerning(&font_texture, FontKerningPair(first, second))].X / 64.0f;
   }
 
-  R_API void srDrawCircleOutline(const glm::vec2 &center, float radius, float thickness, Color color, unsigned int segmentCount)
+  bool FontManagerHasFontLoaded(FontHandle handle)
   {
-    srBeginPath(PathType_Stroke);
-    srPathSetStrokeColor(color);
-    srPathSetStrokeWidth(thickness);
-    srPathArc(center, 0.0f, 360.0f, radius, segmentCount);
-    srEndPath(true);
+    return GetFontManager()->LoadedFonts.find(handle) != GetFontManager()->LoadedFonts.end();
   }
 
-  R_API void srDrawArc(const glm::vec2 &center, float startAngle, float endAngle, float radius, Color color, unsigned int segmentCount)
+  Font *FontManagerGetFont(FontHandle handle)
   {
-    srCheckRenderBatchLimit((segmentCount + 1) * 3);
-
-    // Use angle in radiens. Comes in as deg
-    startAngle = startAngle * DEG2RAD;
-    endAngle = endAngle * DEG2RAD;
-
-    const float angle = endAngle - startAngle;
-    const float degIncrease = angle / segmentCount;
-    glm::vec2 lastPosition = glm::vec2(radius * sinf(startAngle), radius * sinf(startAngle));
-
-    srBegin(TRIANGLES);
-    srColor11c(color);
-
-    float currentAngle = startAngle + degIncrease;
-    for (unsigned int i = 0; i <= segmentCount; i++)
+    if (!FontManagerHasFontLoaded(handle))
     {
-      glm::vec2 currentPosition(radius * sinf(currentAngle), radius * cosf(currentAngle));
-
-      srVertex2f(center);
-      srVertex2f(center + lastPosition);
-      srVertex2f(center + currentPosition);
-
-      currentAngle += degIncrease;
-      lastPosition = currentPosition;
+      return nullptr;
     }
-
-    srEnd();
+    return &GetFontManager()->LoadedFonts.at(handle);
   }
 
-  // Path builder
-
-  R_API void srBeginPath(PathType type)
+  FontHandle FontManagerLoadFont(Font font)
   {
-    SRC->MainRenderBatch.Path.Styles.clear();
-    SRC->MainRenderBatch.Path.Points.clear();
-    SRC->MainRenderBatch.Path.RenderType = type;
+    FontHandle new_handle = GetFontManager()->LoadedFonts.size();
+    while (FontManagerHasFontLoaded(new_handle))
+    {
+      new_handle++;
+    }
+    GetFontManager()->LoadedFonts[new_handle] = font;
+    return new_handle;
   }
 
-  R_API void srEndPath(bool closedPath)
+  static void FontManagerReleaseFace(FontFace *face)
   {
-    if (SRC->MainRenderBatch.Path.Points.size() == 0)
-      return;
-
-    /*if (closedPath && glm::length(SRC->RenderBatch.Path.Points.back() - SRC->RenderBatch.Path.Points[0]) < 0.1f)
-    {
-      SRC->RenderBatch.Path.Points.pop_back();
-    }*/
-
-    if (SRC->MainRenderBatch.Path.RenderType & PathType_Fill)
+    if (--face->References > 0)
     {
-      srAddPolyFilled(SRC->MainRenderBatch.Path);
+      return;
     }
-    if (SRC->MainRenderBatch.Path.RenderType & PathType_Stroke)
+    FontManager *manager = GetFontManager();
+    for (auto it = manager->Faces.begin(); it != manager->Faces.end(); ++it)
     {
-      srAddPolyline(SRC->MainRenderBatch.Path, closedPath);
+      if (it->second == face)
+      {
+        manager->Faces.erase(it);
+        break;
+      }
     }
-
-    SRC->MainRenderBatch.Path.Styles.clear();
-    SRC->MainRenderBatch.Path.Points.clear();
+    FT_Done_Face(face->Handle);
+    FontTextureUnload(&face->Texture);
+    delete face;
   }
 
-  R_API void srPathClose()
+  void FontManagerUnloadFont(FontHandle handle)
   {
-    if (SRC->MainRenderBatch.Path.Points.size() > 1)
+    if (!FontManagerHasFontLoaded(handle))
     {
-      SRC->MainRenderBatch.Path.Points.push_back(SRC->MainRenderBatch.Path.Points[0]);
+      SR_TRACE("ERROR: Cant unload font with handle (%d). Font does not exist!", handle);
+      return;
     }
+    Font &font = GetFontManager()->LoadedFonts.at(handle);
+    TextLayoutCacheRemoveFont(handle);
+    FontManagerReleaseFace(font.Face);
+    GetFontManager()->LoadedFonts.erase(handle);
+  }
 
-    srEndPath(true);
+  static void FontSetSize(FT_Face face, unsigned int size)
+  {
+    FT_Set_Char_Size(
+        face,      // handle to face object
+        0,         // char_width in 1/64 of points
+        size * 64, // char_height in 1/64 of points
+        96,        // horizontal device resolution
+        96);
   }
 
-  R_API void srPathLineTo(const glm::vec2 &position)
+  // Another instance of the face, for a thread with its own library
+  static bool FontOpenFace(const FontFace &face, FT_Library library, FT_Face *handle)
   {
-    if (SRC->MainRenderBatch.Path.Points.size() == 0 || glm::length(SRC->MainRenderBatch.Path.Points.back() - position) > 0.1f)
+    const FT_Error error = face.FilePath.empty() ? FT_New_Memory_Face(library, face.Data, face.DataSize, 0, handle) : FT_New_Face(library, face.FilePath.c_str(), 0, handle);
+    if (error != 0)
     {
+      return false;
     }
-    SRC->MainRenderBatch.Path.Points.push_back(position);
+    FontSetSize(*handle, face.Size);
+    return true;
   }
 
-  R_API void srPathArc(const glm::vec2 &center, float startAngle, float endAngle, float radius, unsigned int segmentCount)
+  // Renders the glyphs on up to SR_FONT_LOAD_WORKERS threads. FreeType objects can not be shared between threads, so
+  // every worker opens the face in a library of its own. The calling thread works with the shared instance
+  static void FontRenderGlyphs(const FontFace &face, std::vector<FontGlyphBitmap> &bitmaps)
   {
-    // Use angle in radiens. Comes in as deg
-    startAngle = (startAngle * DEG2RAD);
-    endAngle = (endAngle * DEG2RAD);
+    std::atomic<size_t> next{0};
+    auto render = [&bitmaps, &next](FT_Face handle)
+    {
+      for (size_t i = next++; i < bitmaps.size(); i = next++)
+      {
+        FontRenderGlyph(handle, bitmaps[i].GlyphIndex, bitmaps[i]);
+      }
+    };
 
-    const float angle = endAngle - startAngle;
-    const float degIncrease = angle / segmentCount;
+    // Opening a face costs about as much as rendering a few glyphs
+    const unsigned int threadCount = srMin(srMin(std::thread::hardware_concurrency(), (unsigned int)SR_FONT_LOAD_WORKERS), (unsigned int)(bitmaps.size() / 16));
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < threadCount; i++)
+    {
+      threads.emplace_back([&face, &render]
+                           {
+                             FT_Library library;
+                             if (FT_Init_FreeType(&library) != 0)
+                             {
+                               return;
+                             }
+                             FT_Face handle;
+                             if (FontOpenFace(face, library, &handle))
+                             {
+                               render(handle);
+                               FT_Done_Face(handle);
+                             }
+                             FT_Done_FreeType(library); });
+    }
+    render(face.Handle);
+    for (std::thread &thread : threads)
+    {
+      thread.join();
+    }
+  }
 
-    float currentAngle = startAngle;
-    for (unsigned int i = 0; i <= segmentCount; i++)
+  // Renders printable Latin-1 into the atlas. The bitmaps are kept for the atlas cache file
+  static void FontPreloadGlyphs(FontFace &face, std::vector<FontGlyphBitmap> &bitmaps)
+  {
+    std::vector<uint32_t> codepoints;
+    std::unordered_map<unsigned int, size_t> bitmapIndices;
+    for (uint32_t codepoint = 0x20; codepoint < 0x100; codepoint++)
     {
-      glm::vec2 currentPosition(radius * sinf(currentAngle), radius * cosf(currentAngle));
+      if (codepoint < 0x7F || codepoint >= 0xA0)
+      {
+        const unsigned int glyph_index = FT_Get_Char_Index(face.Handle, codepoint);
+        if (bitmapIndices.emplace(glyph_index, bitmaps.size()).second)
+        {
+          bitmaps.emplace_back();
+          bitmaps.back().GlyphIndex = glyph_index;
+        }
+        codepoints.push_back(codepoint);
+      }
+    }
+    FontRenderGlyphs(face, bitmaps);
 
-      srPathLineTo(center + currentPosition);
-      currentAngle += degIncrease;
+    // Packed in codepoint order, so the atlas does not depend on which thread finished first
+    std::vector<int> glyphs(bitmaps.size(), -1);
+    for (size_t i = 0; i < bitmaps.size(); i++)
+    {
+      if (bitmaps[i].Rendered)
+      {
+        glyphs[i] = FontTexturePushGlyph(bitmaps[i], &face.Texture);
+        FontAddKerning(&face, glyphs[i]);
+      }
+    }
+    for (uint32_t codepoint : codepoints)
+    {
+      const int glyph = glyphs[bitmapIndices[FT_Get_Char_Index(face.Handle, codepoint)]];
+      if (glyph >= 0)
+      {
+        FontTextureInsertCodepoint(&face.Texture, codepoint, glyph);
+      }
     }
   }
 
-  // https://www.w3.org/TR/SVG/implnote.html#ArcImplementationNotes
-  R_API void srPathEllipticalArc(const glm::vec2 &end_point, float angle, float radius_x, float radius_y, bool large_arc_flag, bool sweep_flag, unsigned int segmentCount)
+  // Path of the atlas cache file of the font. Empty when the cache is off or the font data can not be read
+  static std::string FontAtlasFilePath(const FontFace &face, uint64_t *hash)
   {
-    assert(SRC->MainRenderBatch.Path.Points.size() > 0);
-    glm::vec2 start_point = SRC->MainRenderBatch.Path.Points.back();
-    // Use angle in radiens. Comes in as deg
-    angle = (angle * DEG2RAD);
+    const std::string &directory = GetFontManager()->CacheDirectory;
+    if (directory.empty())
+    {
+      return "";
+    }
 
-    glm::mat2 rotation_matrix = glm::mat2(glm::vec2(cosf(angle), sinf(angle)), glm::vec2(-sinf(angle), cosf(angle)));
-    glm::vec2 v = rotation_matrix * ((start_point - end_point) / 2.0f);
+    if (face.FilePath.empty())
+    {
+      *hash = srHashMemory(face.Data, face.DataSize);
+    }
+    else
+    {
+      FileMapping file;
+      if (!FileMappingOpen(file, face.FilePath.c_str()))
+      {
+        return "";
+      }
+      *hash = srHashMemory(file.Data, file.Size);
+      FileMappingClose(file);
+    }
 
-    float x1p = v.x;
-    float y1p = v.y;
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx-%u.sratlas", (unsigned long long)*hash, (unsigned int)face.Size);
+    return directory + name;
+  }
 
-    radius_x = srAbs(radius_x);
-    radius_y = srAbs(radius_y);
+  static bool FontAtlasFileRead(FontFace &face, uint64_t hash, const FileMapping &file)
+  {
+    FontAtlasFileHeader header;
+    if (file.Size < sizeof(header))
+    {
+      return false;
+    }
+    memcpy(&header, file.Data, sizeof(header));
+    if (memcmp(header.Magic, "SRFA", 4) != 0 || header.Version != FONT_ATLAS_FILE_VERSION || header.FontHash != hash || header.Size != (uint32_t)face.Size ||
+        header.KerningSlots == 0 || (header.KerningSlots & (header.KerningSlots - 1)) != 0)
+    {
+      return false;
+    }
 
-    float lamba = ((x1p * x1p) / (radius_x * radius_x)) + ((y1p * y1p) / (radius_y * radius_y));
-    if (lamba > 1.0f)
+    FontTexture &font_texture = face.Texture;
+    const size_t glyphBytes = header.GlyphCount * sizeof(FontAtlasFileGlyph);
+    const size_t kerningBytes = header.KerningSlots * sizeof(FontKerning);
+    if (file.Size != sizeof(header) + glyphBytes + sizeof(font_texture.Latin1) + kerningBytes + header.PixelBytes)
     {
-      radius_x *= sqrtf(lamba);
-      radius_y *= sqrtf(lamba);
+      return false;
+    }
+
+    // Checked before anything goes into the shared atlas
+    const uint8_t *records = file.Data + sizeof(header);
+    uint64_t pixelBytes = 0;
+    for (uint32_t i = 0; i < header.GlyphCount; i++)
+    {
+      FontAtlasFileGlyph record;
+      memcpy(&record, records + i * sizeof(record), sizeof(record));
+      if (record.Size.x < 0 || record.Size.y < 0 || record.Size.x > (int)FONT_TEXTURE_SIZE || record.Size.y > (int)FONT_TEXTURE_SIZE)
+      {
+        return false;
+      }
+      pixelBytes += (uint64_t)record.Size.x * record.Size.y;
+    }
+    uint32_t latin1[256];
+    memcpy(latin1, records + glyphBytes, sizeof(latin1));
+    for (uint32_t glyph : latin1)
+    {
+      if (glyph > header.GlyphCount)
+      {
+        return false;
+      }
+    }
+    if (pixelBytes != header.PixelBytes)
+    {
+      return false;
+    }
+
+    // Pushed in the order they were written, so they get the same indices and the kerning table still fits
+    const uint8_t *pixels = records + glyphBytes + sizeof(latin1) + kerningBytes;
+    static FontGlyphBitmap bitmap;
+    for (uint32_t i = 0; i < header.GlyphCount; i++)
+    {
+      FontAtlasFileGlyph record;
+      memcpy(&record, records + i * sizeof(record), sizeof(record));
+      bitmap.GlyphIndex = record.GlyphIndex;
+      bitmap.Size = record.Size;
+      bitmap.Offset = record.Offset;
+      bitmap.Advance = record.Advance;
+      bitmap.Pixels.assign(pixels, pixels + record.Size.x * record.Size.y);
+      bitmap.Rendered = true;
+      pixels += bitmap.Pixels.size();
+      FontTexturePushGlyph(bitmap, &font_texture);
+    }
+
+    memcpy(font_texture.Latin1, latin1, sizeof(latin1));
+    font_texture.Kerning.resize(header.KerningSlots);
+    memcpy(font_texture.Kerning.data(), records + glyphBytes + sizeof(latin1), kerningBytes);
+    font_texture.KerningCount = header.KerningCount;
+    return true;
+  }
+
+  static bool FontAtlasFileLoad(FontFace &face, uint64_t hash, const std::string &path)
+  {
+    FileMapping file;
+    if (!FileMappingOpen(file, path.c_str()))
+    {
+      return false;
+    }
+    const bool loaded = FontAtlasFileRead(face, hash, file);
+    FileMappingClose(file);
+    if (!loaded)
+    {
+      SR_TRACE("Ignoring outdated font atlas file %s", path.c_str());
+    }
+    return loaded;
+  }
+
+  static void FontAtlasFileSave(const FontFace &face, uint64_t hash, const std::string &path, const std::vector<FontGlyphBitmap> &bitmaps)
+  {
+    const FontTexture &font_texture = face.Texture;
+    FontAtlasFileHeader header{};
+    memcpy(header.Magic, "SRFA", 4);
+    header.Version = FONT_ATLAS_FILE_VERSION;
+    header.FontHash = hash;
+    header.Size = face.Size;
+    header.KerningSlots = font_texture.Kerning.size();
+    header.KerningCount = font_texture.KerningCount;
+
+    // Only the rendered bitmaps made it into Glyphs, in this order
+    std::vector<FontAtlasFileGlyph> records;
+    for (const FontGlyphBitmap &bitmap : bitmaps)
+    {
+      if (bitmap.Rendered)
+      {
+        records.push_back({bitmap.GlyphIndex, bitmap.Advance, bitmap.Size, bitmap.Offset});
+        header.PixelBytes += bitmap.Pixels.size();
+      }
+    }
+    header.GlyphCount = records.size();
+
+    // Written under another name first, so processes loading the same font at the same time never see half a file
+    const std::string temporary = path + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file)
+    {
+      SR_TRACE("ERROR: Could not write font atlas file %s", path.c_str());
+      return;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    written = written && fwrite(records.data(), sizeof(FontAtlasFileGlyph), records.size(), file) == records.size();
+    written = written && fwrite(font_texture.Latin1, sizeof(font_texture.Latin1), 1, file) == 1;
+    written = written && fwrite(font_texture.Kerning.data(), sizeof(FontKerning), font_texture.Kerning.size(), file) == font_texture.Kerning.size();
+    for (const FontGlyphBitmap &bitmap : bitmaps)
+    {
+      written = written && (!bitmap.Rendered || fwrite(bitmap.Pixels.data(), 1, bitmap.Pixels.size(), file) == bitmap.Pixels.size());
+    }
+    written = fclose(file) == 0 && written;
+#ifdef _WIN32
+    remove(path.c_str()); // rename does not replace files on Windows
+#endif
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0)
+    {
+      SR_TRACE("ERROR: Could not write font atlas file %s", path.c_str());
+      remove(temporary.c_str());
+    }
+  }
+
+  // Renders the glyphs of a new face, or reads them from the atlas cache file
+  static void FontFaceInitialize(FontFace &face)
+  {
+    FontTextureInit(&face.Texture);
+    face.Size = SR_FONT_SDF_SIZE;
+    FontSetSize(face.Handle, face.Size);
+
+    // Printable Latin-1 up front, everything else is loaded when it is first drawn
+    uint64_t hash = 0;
+    const std::string atlasPath = FontAtlasFilePath(face, &hash);
+    if (atlasPath.empty() || !FontAtlasFileLoad(face, hash, atlasPath))
+    {
+      std::vector<FontGlyphBitmap> bitmaps;
+      FontPreloadGlyphs(face, bitmaps);
+      if (!atlasPath.empty())
+      {
+        FontAtlasFileSave(face, hash, atlasPath, bitmaps);
+      }
+    }
+    FontAtlasUpload();
+  }
+
+  // The face loaded from the file or data, opened the first time a size of it is loaded. nullptr when FreeType can not read it
+  static FontFace *FontManagerAcquireFace(const char *filePath, const unsigned char *data, unsigned int data_size)
+  {
+    FontManager *manager = GetFontManager();
+    std::string key;
+    if (filePath)
+    {
+      key = filePath;
+    }
+    else
+    {
+      char name[64];
+      snprintf(name, sizeof(name), "memory:%p:%u", (const void *)data, data_size);
+      key = name;
+    }
+
+    auto found = manager->Faces.find(key);
+    if (found != manager->Faces.end())
+    {
+      found->second->References++;
+      return found->second;
+    }
+
+    FontFace *face = new FontFace{};
+    const FT_Error error = filePath ? FT_New_Face(manager->Libary, filePath, 0, &face->Handle) : FT_New_Memory_Face(manager->Libary, data, data_size, 0, &face->Handle);
+    if (error != 0)
+    {
+      delete face;
+      return nullptr;
+    }
+    face->FilePath = filePath ? filePath : "";
+    face->Data = data;
+    face->DataSize = data_size;
+    face->References = 1;
+    FontFaceInitialize(*face);
+    manager->Faces[key] = face;
+    return face;
+  }
+
+  FontHandle srInitializeFont(FontFace *face, unsigned int size)
+  {
+    Font font{};
+    font.Face = face;
+    font.Size = size;
+    font.Scale = (float)size / (float)face->Size;
+
+    // Line metrics come from FreeType at the actual size, they are hinted differently than scaled ones
+    FontSetSize(face->Handle, size);
+    font.LineHeight = face->Handle->size->metrics.height / 64;
+    font.LineTop = face->Handle->size->metrics.ascender / 64;
+    font.LineBottom = face->Handle->size->metrics.descender / 64;
+    FontSetSize(face->Handle, face->Size);
+    SR_TRACE("Loaded font. Line height = %d", font.LineHeight);
+
+    return FontManagerLoadFont(font);
+  }
+
+  R_API FontHandle srLoadFont(const char *filePath, unsigned int size)
+  {
+    FontFace *face = FontManagerAcquireFace(filePath, nullptr, 0);
+    if (!face)
+    {
+      SR_TRACE("ERROR: Could not load font from file %s", filePath);
+      return -1;
+    }
+    return srInitializeFont(face, size);
+  }
+
+  R_API FontHandle srLoadFontFromMemory(const unsigned char *data, unsigned int data_size, unsigned int font_size)
+  {
+    FontFace *face = FontManagerAcquireFace(nullptr, data, data_size);
+    if (!face)
+    {
+      SR_TRACE("ERROR: Could not load font from memory");
+      return -1;
+    }
+    return srInitializeFont(face, font_size);
+  }
+
+  R_API void srUnloadFont(FontHandle handle)
+  {
+    FontManagerUnloadFont(handle);
+  }
+
+  R_API void srFontSetCacheDirectory(const char *directory)
+  {
+    GetFontManager()->CacheDirectory = directory ? directory : "";
+  }
+
+  R_API void srFontSetAtlasBudget(size_t bytes)
+  {
+    GetFontManager()->AtlasBudget = bytes;
+  }
+
+  // Text layout cache
+  //
+  // Drawing and measuring a string both go through its layout. The quads refer to places in the atlas, so a layout is
+  // laid out again when glyphs were evicted since, and dropped when its font is unloaded.
+
+  static void TextLayoutBuild(Font *font, const char *text, TextLayout &layout)
+  {
+    layout.Quads.clear();
+    layout.Width = 0;
+    layout.LineCount = *text ? 1 : 0;
+
+    // Glyph metrics are in units of the face, scaled to the size of the font
+    FontFace *face = font->Face;
+    const float scale = font->Scale;
+    glm::vec2 pos(0.0f);
+    float width = 0.0f;
+    float depth = 0.0f;
+    int prev = -1;
+    bool complete = true;
+    const uint32_t frame = GetFontManager()->Frame;
+    while (*text)
+    {
+      const uint32_t c = Utf8Next(&text);
+      if (c == '\n')
+      {
+        width = srMax(width, pos.x);
+        pos.x = 0.0f;
+        pos.y += font->LineHeight;
+        layout.LineCount++;
+        prev = -1;
+        continue;
+      }
+      FontGlyph *glyph = FontTextureGetGlyph(face, c); // Loading a glyph can move the others, so they are kept by index
+      if (glyph)
+      {
+        const unsigned int index = glyph - face->Texture.Glyphs.data();
+        pos.x += FontGetKerning(face, prev, index) * scale;
+
+        // Empty glyphs like the space only move the pen. Evicted glyphs go back into the atlas, marked as used first, so
+        // they can not push out the glyphs laid out before them
+        glyph->LastUsed = frame;
+        if (glyph->Size.x > 0 && glyph->Size.y > 0 && glyph->Bin < 0 && !FontGlyphMakeResident(face, *glyph))
+        {
+          complete = false;
+        }
+        else if (glyph->Size.x > 0 && glyph->Size.y > 0)
+        {
+          const float x0 = pos.x + glyph->Offset.x * scale;
+          const float y0 = pos.y - glyph->Offset.y * scale;
+          layout.Quads.push_back({{x0, y0, x0 + glyph->Size.x * scale, y0 + glyph->Size.y * scale}, {glyph->u0, glyph->v0, glyph->u1, glyph->v1}, depth, glyph->Page, index});
+        }
+
+        pos.x += glyph->advance * scale;
+        prev = index;
+        depth -= 0.0001f;
+      }
+    }
+    layout.Width = (int)ceilf(srMax(width, pos.x));
+    layout.DepthAdvance = depth;
+    layout.Generation = GetFontManager()->AtlasGeneration;
+    layout.Complete = complete;
+  }
+
+  static size_t TextLayoutBytes(const TextLayout &layout)
+  {
+    return sizeof(TextLayout) + layout.Text.capacity() + layout.Quads.capacity() * sizeof(TextLayout::Quad);
+  }
+
+  static void TextLayoutCacheEvict(TextLayoutCache *cache)
+  {
+    while (cache->Bytes > cache->Budget && cache->Entries.size() > 0)
+    {
+      const TextLayout &last = cache->Entries.back();
+      cache->Bytes -= last.Bytes;
+      cache->Lookup.erase(last.Key);
+      cache->Entries.pop_back();
+    }
+  }
+
+  // Layout of the string, from the cache or laid out now. nullptr when the font does not exist
+  static const TextLayout *TextLayoutGet(FontHandle handle, const char *text)
+  {
+    Font *font = FontManagerGetFont(handle);
+    if (!font)
+    {
+      return nullptr;
+    }
+
+    TextLayoutCache *cache = GetTextLayoutCache();
+    const size_t length = strlen(text);
+    if (cache->Budget == 0 || length > SR_TEXT_CACHE_MAX_LENGTH)
+    {
+      TextLayoutBuild(font, text, cache->Scratch);
+      return &cache->Scratch;
+    }
+
+    const uint64_t key = srHashMemory(text, length, handle);
+    auto found = cache->Lookup.find(key);
+    if (found != cache->Lookup.end())
+    {
+      TextLayout &layout = *found->second;
+      if (layout.Font == handle && layout.Text.compare(0, std::string::npos, text, length) == 0)
+      {
+        // Glyphs were evicted since it was laid out, some of its quads may point at other glyphs now.
+        // Glyphs that found no room get another try
+        if (layout.Generation != GetFontManager()->AtlasGeneration || !layout.Complete)
+        {
+          cache->Bytes -= layout.Bytes;
+          TextLayoutBuild(font, text, layout);
+          layout.Bytes = TextLayoutBytes(layout);
+          cache->Bytes += layout.Bytes;
+        }
+        cache->Entries.splice(cache->Entries.begin(), cache->Entries, found->second);
+        return &layout;
+      }
+      TextLayoutBuild(font, text, cache->Scratch); // Another string with the same hash
+      return &cache->Scratch;
+    }
+
+    TextLayout layout;
+    layout.Font = handle;
+    layout.Key = key;
+    layout.Text.assign(text, length);
+    TextLayoutBuild(font, text, layout);
+    layout.Quads.shrink_to_fit();
+    layout.Bytes = TextLayoutBytes(layout);
+    if (layout.Bytes > cache->Budget)
+    {
+      cache->Scratch = std::move(layout);
+      return &cache->Scratch;
+    }
+
+    cache->Bytes += layout.Bytes;
+    cache->Entries.push_front(std::move(layout));
+    cache->Lookup[key] = cache->Entries.begin();
+    TextLayoutCacheEvict(cache);
+    return &cache->Entries.front();
+  }
+
+  R_API void srTextCacheSetBudget(size_t bytes)
+  {
+    TextLayoutCache *cache = GetTextLayoutCache();
+    cache->Budget = bytes;
+    TextLayoutCacheEvict(cache);
+  }
+
+  R_API void srTextCacheClear()
+  {
+    TextLayoutCache *cache = GetTextLayoutCache();
+    cache->Entries.clear();
+    cache->Lookup.clear();
+    cache->Bytes = 0;
+  }
+
+  R_API int srFontGetTextWidth(FontHandle handle, const char *text)
+  {
+    const TextLayout *layout = TextLayoutGet(handle, text);
+    if (!layout)
+    {
+      SR_TRACE("ERROR: Could not get text width. Font not found with handle %d!", handle);
+      return 0;
+    }
+    return layout->Width;
+  }
+
+  R_API int srFontGetTextHeight(FontHandle handle, const char *text)
+  {
+    const TextLayout *layout = TextLayoutGet(handle, text);
+    if (!layout)
+    {
+      SR_TRACE("ERROR: Could not get text height. Font not found with handle %d!", handle);
+      return 0;
+    }
+    return FontManagerGetFont(handle)->LineHeight * layout->LineCount;
+  }
+
+  R_API glm::ivec2 srFontGetTextSize(FontHandle handle, const char *text)
+  {
+    const TextLayout *layout = TextLayoutGet(handle, text);
+    if (!layout)
+    {
+      SR_TRACE("ERROR: Could not get text size. Font not found with handle %d!", handle);
+      return glm::ivec2(0);
+    }
+    return {layout->Width, FontManagerGetFont(handle)->LineHeight * layout->LineCount};
+  }
+
+  R_API int srFontGetLineTop(FontHandle handle)
+  {
+    if (!FontManagerHasFontLoaded(handle))
+    {
+      SR_TRACE("ERROR: Could not get line top. Font not found with handle %d!", handle);
+      return 0;
+    }
+    return FontManagerGetFont(handle)->LineTop;
+  }
+
+  R_API int srFontGetLineBottom(FontHandle handle)
+  {
+    if (!FontManagerHasFontLoaded(handle))
+    {
+      SR_TRACE("ERROR: Could not get line bottom. Font not found with handle %d!", handle);
+      return 0;
+    }
+    return FontManagerGetFont(handle)->LineBottom;
+  }
+
+  R_API int srFontGetLineHeight(FontHandle handle)
+  {
+    if (!FontManagerHasFontLoaded(handle))
+    {
+      SR_TRACE("ERROR: Could not get line height. Font not found with handle %d!", handle);
+      return 0;
+    }
+    return FontManagerGetFont(handle)->LineHeight;
+  }
+
+  R_API int srFontGetSize(FontHandle handle)
+  {
+    if (!FontManagerHasFontLoaded(handle))
+    {
+      SR_TRACE("ERROR: Could not get font size. Font not found with handle %d!", handle);
+      return 0;
+    }
+    return FontManagerGetFont(handle)->Size;
+  }
+
+  R_API const char *srFontGetName(FontHandle handle)
+  {
+    if (!FontManagerHasFontLoaded(handle))
+    {
+      SR_TRACE("ERROR: Could not get font size. Font not found with handle %d!", handle);
+      return 0;
+    }
+    return FontManagerGetFont(handle)->Face->Handle->family_name;
+  }
+
+  // The pages of the shared atlas that hold glyphs of the font, in page order
+  static void FontGetAtlasPages(const Font &font, std::vector<unsigned int> &pages)
+  {
+    std::vector<bool> used(GetFontManager()->AtlasPages.size(), false);
+    for (const FontGlyph &glyph : font.Face->Texture.Glyphs)
+    {
+      if (glyph.Bin >= 0)
+      {
+        used[glyph.Page] = true;
+      }
+    }
+
+    pages.clear();
+    for (unsigned int page = 0; page < used.size(); page++)
+    {
+      if (used[page])
+      {
+        pages.push_back(page);
+      }
+    }
+  }
+
+  R_API unsigned int srFontGetAtlasPageCount(FontHandle handle)
+  {
+    if (!FontManagerHasFontLoaded(handle))
+    {
+      SR_TRACE("ERROR: Could not get atlas page count. Font not found with handle %d!", handle);
+      return 0;
+    }
+
+    std::vector<unsigned int> pages;
+    FontGetAtlasPages(*FontManagerGetFont(handle), pages);
+    return pages.size();
+  }
+
+  R_API unsigned int srFontGetTextureId(FontHandle handle, unsigned int page)
+  {
+    if (!FontManagerHasFontLoaded(handle))
+    {
+      SR_TRACE("ERROR: Could not get texture id. Font not found with handle %d!", handle);
+      return 0;
+    }
+
+    std::vector<unsigned int> pages;
+    FontGetAtlasPages(*FontManagerGetFont(handle), pages);
+    return page < pages.size() ? GetFontManager()->AtlasPages[pages[page]].Image.ID : 0;
+  }
+
+  static void FontDrawText(FontHandle handle, const char *text, const glm::vec2 &position, Color color, GradientHandle gradient, float outline_thickness, Color outline_color)
+  {
+    const TextLayout *layout = TextLayoutGet(handle, text);
+    if (!layout)
+    {
+      SR_TRACE("ERROR: Could not draw text. Font not found with handle %d!", handle);
+      return;
+    }
+    // New glyphs reach the texture before srBegin or a full batch can draw them
+    FontAtlasUpload();
+
+    const Font &font = *FontManagerGetFont(handle);
+    const std::vector<FontAtlasPage> &pages = GetFontManager()->AtlasPages;
+    std::vector<FontGlyph> &glyphs = font.Face->Texture.Glyphs;
+    const uint32_t frame = GetFontManager()->Frame;
+
+    RenderBatch &rb = SRC->MainRenderBatch;
+    const glm::vec2 origin = glm::ivec2(position); // Glyphs are placed on whole units
+    const glm::vec3 normal(outline_thickness, font.Scale, (float)gradient);
+    const float depth = rb.CurrentDepth;
+    const TextLayout::Quad *quad = layout->Quads.data();
+    const TextLayout::Quad *end = quad + layout->Quads.size();
+    while (quad != end)
+    {
+      // All fonts and sizes share the atlas pages, so text only breaks the draw call where its glyphs change pages
+      const unsigned int page = quad->Page;
+      srBegin(EBatchDrawMode::QUADS, {pages[page].Image, SRC->DistanceFieldShader});
+      size_t run = 1;
+      while (quad + run != end && quad[run].Page == page)
+      {
+        run++;
+      }
+
+      // Long strings continue in the next batch
+      const size_t count = srMin(run, (size_t)(rb.DrawBuffer.ElementCount / 8));
+      srCheckRenderBatchLimit(count * 4);
+
+      RenderBatch::Vertex *vertex = rb.DrawBuffer.Vertices + rb.VertexCounter;
+      for (size_t i = 0; i < count; i++, quad++)
+      {
+        const float x0 = origin.x + quad->Rect.x;
+        const float y0 = origin.y + quad->Rect.y;
+        const float x1 = origin.x + quad->Rect.z;
+        const float y1 = origin.y + quad->Rect.w;
+        const float z = depth + quad->Depth;
+        glyphs[quad->Glyph].LastUsed = frame; // Keeps it in the atlas until the batch is drawn
+        *vertex++ = {{x0, y1, z}, normal, {quad->UV.x, quad->UV.w}, color, outline_color};
+        *vertex++ = {{x0, y0, z}, normal, {quad->UV.x, quad->UV.y}, color, outline_color};
+        *vertex++ = {{x1, y0, z}, normal, {quad->UV.z, quad->UV.y}, color, outline_color};
+        *vertex++ = {{x1, y1, z}, normal, {quad->UV.z, quad->UV.w}, color, outline_color};
+      }
+      rb.VertexCounter += count * 4;
+      rb.DrawCalls[rb.CurrentDraw].VertexCount += count * 4;
+      srEnd();
+    }
+    rb.CurrentDepth = depth + layout->DepthAdvance;
+  }
+
+  R_API void srDrawText(FontHandle handle, const char *text, const glm::vec2 &position, Color color, float outline_thickness, Color outline_color)
+  {
+    FontDrawText(handle, text, position, color, 0, outline_thickness, outline_color);
+  }
+
+  R_API void srDrawTextGradient(FontHandle handle, const char *text, const glm::vec2 &position, GradientHandle gradient, float outline_thickness, Color outline_color)
+  {
+    FontDrawText(handle, text, position, 0xffffffff, gradient, outline_thickness, outline_color);
+  }
+
+  // Segments needed so the chord error of an arc stays below the tolerance
+  static unsigned int PathArcSegmentCount(float radius, float angle)
+  {
+    angle = srAbs(angle);
+    const float radiusPixels = srAbs(radius) * srGetPixelScale();
+    const float minSegments = ceilf(angle / (float)(2.0 * PI) * 3.0f); // Keep at least a triangle for full circles
+
+    if (radiusPixels <= SRC->PathTolerance)
+    {
+      return (unsigned int)srMax(minSegments, 1.0f);
+    }
+
+    // Max angle per segment with a sagitta of tolerance: r * (1 - cos(a / 2)) = tol
+    const float step = 2.0f * acosf(1.0f - SRC->PathTolerance / radiusPixels);
+    const float segments = ceilf(angle / step);
+    return (unsigned int)srClamp(segments, srMax(minSegments, 1.0f), (float)SR_ARC_MAX_SEGMENTS);
+  }
+
+  // Segments of an arc with automatic level of detail. Full circles get a multiple of four segments, so circles and the
+  // quarter circles of rounded rectangles line up with the steps of the shared unit circle tables
+  static unsigned int PathArcAutoSegmentCount(float radius, float angle)
+  {
+    const unsigned int circleSegments = srMin((PathArcSegmentCount(radius, 2.0f * (float)PI) + 3) & ~3u, (unsigned int)SR_ARC_MAX_SEGMENTS);
+    const float segments = ceilf(srAbs(angle) / (2.0f * (float)PI) * circleSegments - 1e-3f);
+    return (unsigned int)srMax(segments, 1.0f);
+  }
+
+  // Calls emit with the segmentCount + 1 points of an arc. Angles are in degrees, measured like in srPathArc.
+  // Arcs whose start and step fit a whole number of segments into a circle read the shared table, other arcs
+  // rotate the previous point by the step
+  template <typename Emit>
+  static void ArcForEachPoint(const glm::vec2 &center, float startAngle, float endAngle, float radius, unsigned int segmentCount, Emit emit)
+  {
+    const float step = (endAngle - startAngle) / segmentCount;
+    if (step == 0.0f)
+    {
+      for (unsigned int i = 0; i <= segmentCount; i++)
+      {
+        emit(center + radius * glm::vec2(sinf(startAngle * DEG2RAD), cosf(startAngle * DEG2RAD)));
+      }
+      return;
+    }
+
+    const float circleSteps = 360.0f / srAbs(step);
+    const float startSteps = startAngle / srAbs(step);
+    const float tableSize = roundf(circleSteps);
+    if (tableSize >= 1.0f && tableSize <= SR_ARC_MAX_SEGMENTS && srAbs(circleSteps - tableSize) < 1e-2f && srAbs(startSteps - roundf(startSteps)) < 1e-2f)
+    {
+      const int size = (int)tableSize;
+      const int direction = step > 0.0f ? 1 : size - 1;
+      const glm::vec2 *table = GetUnitCircleTable(size);
+
+      int index = (int)fmodf(roundf(startSteps), tableSize);
+      index = index < 0 ? index + size : index;
+      for (unsigned int i = 0; i <= segmentCount; i++)
+      {
+        emit(center + radius * table[index]);
+        index = (index + direction) % size;
+      }
+      return;
+    }
+
+    const float sinStep = sinf(step * DEG2RAD);
+    const float cosStep = cosf(step * DEG2RAD);
+    glm::vec2 unit(sinf(startAngle * DEG2RAD), cosf(startAngle * DEG2RAD));
+    for (unsigned int i = 0; i < segmentCount; i++)
+    {
+      emit(center + radius * unit);
+      unit = glm::vec2(unit.x * cosStep + unit.y * sinStep, unit.y * cosStep - unit.x * sinStep);
+    }
+    // Exact end, so the arc meets the shapes that continue from it
+    emit(center + radius * glm::vec2(sinf(endAngle * DEG2RAD), cosf(endAngle * DEG2RAD)));
+  }
+
+  R_API void srDrawCircle(const glm::vec2 &center, float radius, Color color, unsigned int segmentCount)
+  {
+    srDrawArc(center, 0.0f, 360.0f, radius, color, segmentCount);
+  }
+
+  R_API void srDrawCircleOutline(const glm::vec2 &center, float radius, float thickness, Color color, unsigned int segmentCount)
+  {
+    srBeginPath(PathType_Stroke);
+    srPathSetStrokeColor(color);
+    srPathSetStrokeWidth(thickness);
+    srPathArc(center, 0.0f, 360.0f, radius, segmentCount);
+    srEndPath(true);
+  }
+
+  R_API void srDrawArc(const glm::vec2 &center, float startAngle, float endAngle, float radius, Color color, unsigned int segmentCount)
+  {
+    if (segmentCount == 0)
+    {
+      segmentCount = PathArcAutoSegmentCount(radius, (endAngle - startAngle) * DEG2RAD);
+    }
+
+    // Fan around the center
+    srBegin(TRIANGLES_INDEXED);
+    srCheckRenderBatchLimit(segmentCount + 2, segmentCount * 3);
+    srColor11c(color);
+
+    const unsigned int first = srGetCurrentVertexIndex();
+    srVertex2f(center);
+    ArcForEachPoint(center, startAngle, endAngle, radius, segmentCount, [](const glm::vec2 &point)
+                    { srVertex2f(point); });
+
+    for (unsigned int i = 1; i <= segmentCount; i++)
+    {
+      srIndex1ui(first);
+      srIndex1ui(first + i);
+      srIndex1ui(first + i + 1);
+    }
+
+    srEnd();
+  }
+
+  // Path builder
+
+  R_API void srBeginPath(PathType type)
+  {
+    SRC->MainRenderBatch.Path.Commands.clear();
+    SRC->MainRenderBatch.Path.CommandPoints.clear();
+    SRC->MainRenderBatch.Path.CommandStyles.clear();
+    SRC->MainRenderBatch.Path.Styles.clear();
+    SRC->MainRenderBatch.Path.Points.clear();
+    SRC->MainRenderBatch.Path.SubpathStarts.clear();
+    SRC->MainRenderBatch.Path.RenderType = type;
+    SRC->MainRenderBatch.Path.FillRule = FillRule_NonZero;
+    SRC->MainRenderBatch.Path.FillMode = PathFillMode_Tessellate;
+    SRC->MainRenderBatch.Path.StrokeMode = PathStrokeMode_Tessellate;
+    SRC->MainRenderBatch.Path.Simplify = false;
+  }
+
+  static PathCommand &PathRecordCommand(PathCommandType_ type, unsigned int segmentCount = 0)
+  {
+    PathBuilder &pb = SRC->MainRenderBatch.Path;
+    PathCommand command;
+    command.Type = type;
+    command.First = pb.CommandPoints.size();
+    command.SegmentCount = segmentCount;
+    pb.Commands.push_back(command);
+    return pb.Commands.back();
+  }
+
+  static void PathRecordPoint(PathCommand &command, const glm::vec2 &point)
+  {
+    SRC->MainRenderBatch.Path.CommandPoints.push_back(point);
+    command.Count++;
+  }
+
+  // Styles apply to the points after them. Without points in between the last style gets replaced
+  static void PathRecordStyle()
+  {
+    PathBuilder &pb = SRC->MainRenderBatch.Path;
+    if (pb.Commands.size() > 0 && pb.Commands.back().Type == PathCommandType_Style)
+    {
+      pb.CommandStyles[pb.Commands.back().First] = pb.CurrentPathStyle;
+      return;
+    }
+
+    PathCommand command;
+    command.Type = PathCommandType_Style;
+    command.First = pb.CommandStyles.size();
+    pb.CommandStyles.push_back(pb.CurrentPathStyle);
+    pb.Commands.push_back(command);
+  }
+
+  R_API void srPathLineTo(const glm::vec2 &position)
+  {
+    PathBuilder &pb = SRC->MainRenderBatch.Path;
+    if (pb.Commands.size() == 0 || pb.Commands.back().Type != PathCommandType_LineTo)
+    {
+      PathRecordCommand(PathCommandType_LineTo);
+    }
+    PathRecordPoint(pb.Commands.back(), position);
+  }
+
+  R_API void srPathLinesTo(const glm::vec2 *positions, size_t count)
+  {
+    PathBuilder &pb = SRC->MainRenderBatch.Path;
+    if (pb.Commands.size() == 0 || pb.Commands.back().Type != PathCommandType_LineTo)
+    {
+      PathRecordCommand(PathCommandType_LineTo);
+    }
+    pb.CommandPoints.insert(pb.CommandPoints.end(), positions, positions + count);
+    pb.Commands.back().Count += count;
+  }
+
+  R_API void srPathMoveTo(const glm::vec2 &position)
+  {
+    PathRecordPoint(PathRecordCommand(PathCommandType_MoveTo), position);
+  }
+
+  static void PathFlattenMoveTo(PathBuilder &pb, const glm::vec2 &position)
+  {
+    const unsigned int currentStart = pb.SubpathStarts.size() > 0 ? pb.SubpathStarts.back() : 0;
+
+    if (pb.Points.size() > 0 && pb.Points.size() - currentStart == 1)
+    {
+      // Current subpath only has its start point. Just move it
+      pb.Points.back() = position;
+      return;
+    }
+    if (pb.Points.size() > 0)
+    {
+      pb.SubpathStarts.push_back(pb.Points.size());
+    }
+    pb.Points.push_back(position);
+  }
+
+  static unsigned int PathSubpathCount(const PathBuilder &pb)
+  {
+    return pb.SubpathStarts.size() + 1;
+  }
+
+  // First point index and point count of a subpath
+  static void PathGetSubpath(const PathBuilder &pb, unsigned int subpath, unsigned int *first, unsigned int *count)
+  {
+    *first = subpath == 0 ? 0 : pb.SubpathStarts[subpath - 1];
+    const unsigned int end = subpath < pb.SubpathStarts.size() ? pb.SubpathStarts[subpath] : pb.Points.size();
+    *count = end - *first;
+  }
+
+  R_API void srPathSetTolerance(float pixels)
+  {
+    SRC->PathTolerance = srMax(pixels, 0.01f);
+  }
+
+  R_API float srPathGetTolerance()
+  {
+    return SRC->PathTolerance;
+  }
+
+  R_API void srSetAntiAliasing(bool enabled)
+  {
+    SRC->AntiAliasing = enabled;
+  }
+
+  R_API bool srGetAntiAliasing()
+  {
+    return SRC->AntiAliasing;
+  }
+
+  R_API float srGetPixelScale()
+  {
+    // Length of the projected unit axis in ndc, times half the framebuffer size
+    const glm::mat4 &proj = SRC->CurrentProjection;
+    const float scaleX = glm::length(glm::vec2(proj[0][0], proj[0][1])) * SRC->FrameWidth * 0.5f;
+    const float scaleY = glm::length(glm::vec2(proj[1][0], proj[1][1])) * SRC->FrameHeight * 0.5f;
+    const float scale = srMax(scaleX, scaleY);
+    return scale > 0.0f ? scale : 1.0f;
+  }
+
+  // Tolerance in path units
+  static float PathToleranceWorld()
+  {
+    return SRC->PathTolerance / srGetPixelScale();
+  }
+
+  // Recursive subdivision until the control points are within the tolerance of the chord
+  static void PathFlattenCubic(PathBuilder &pb, const glm::vec2 &p1, const glm::vec2 &p2, const glm::vec2 &p3, const glm::vec2 &p4, float tolSqr, int level)
+  {
+    const glm::vec2 d = p4 - p1;
+    const float lengthSqr = glm::dot(d, d);
+
+    float flatness = 0.0f;
+    if (lengthSqr > 1e-12f)
+    {
+      // Distance of the controll points to the chord, scaled by chord length
+      const float d2 = srAbs((p2.x - p4.x) * d.y - (p2.y - p4.y) * d.x);
+      const float d3 = srAbs((p3.x - p4.x) * d.y - (p3.y - p4.y) * d.x);
+      flatness = (d2 + d3) * (d2 + d3) / lengthSqr;
+    }
+    else
+    {
+      // Start and end are the same. Use the distance of the controll points instead
+      const float d2 = glm::length(p2 - p1);
+      const float d3 = glm::length(p3 - p1);
+      flatness = (d2 + d3) * (d2 + d3);
+    }
+
+    if (flatness <= tolSqr || level >= 10)
+    {
+      pb.Points.push_back(p4);
+      return;
+    }
+
+    const glm::vec2 p12 = (p1 + p2) * 0.5f;
+    const glm::vec2 p23 = (p2 + p3) * 0.5f;
+    const glm::vec2 p34 = (p3 + p4) * 0.5f;
+    const glm::vec2 p123 = (p12 + p23) * 0.5f;
+    const glm::vec2 p234 = (p23 + p34) * 0.5f;
+    const glm::vec2 p1234 = (p123 + p234) * 0.5f;
+
+    PathFlattenCubic(pb, p1, p12, p123, p1234, tolSqr, level + 1);
+    PathFlattenCubic(pb, p1234, p234, p34, p4, tolSqr, level + 1);
+  }
+
+  R_API void srPathArc(const glm::vec2 &center, float startAngle, float endAngle, float radius, unsigned int segmentCount)
+  {
+    PathCommand &command = PathRecordCommand(PathCommandType_Arc, segmentCount);
+    command.Params[0] = startAngle;
+    command.Params[1] = endAngle;
+    command.Params[2] = radius;
+    PathRecordPoint(command, center);
+  }
+
+  static void PathFlattenArc(PathBuilder &pb, const glm::vec2 &center, float startAngle, float endAngle, float radius, unsigned int segmentCount)
+  {
+    if (segmentCount == 0)
+    {
+      segmentCount = PathArcAutoSegmentCount(radius, (endAngle - startAngle) * DEG2RAD);
+    }
+
+    ArcForEachPoint(center, startAngle, endAngle, radius, segmentCount, [&pb](const glm::vec2 &point)
+                    { pb.Points.push_back(point); });
+  }
+
+  // https://www.w3.org/TR/SVG/implnote.html#ArcImplementationNotes
+  R_API void srPathEllipticalArc(const glm::vec2 &end_point, float angle, float radius_x, float radius_y, bool large_arc_flag, bool sweep_flag, unsigned int segmentCount)
+  {
+    PathCommand &command = PathRecordCommand(PathCommandType_EllipticalArc, segmentCount);
+    command.Params[0] = angle;
+    command.Params[1] = radius_x;
+    command.Params[2] = radius_y;
+    command.Params[3] = large_arc_flag ? 1.0f : 0.0f;
+    command.Params[4] = sweep_flag ? 1.0f : 0.0f;
+    PathRecordPoint(command, end_point);
+  }
+
+  static void PathFlattenEllipticalArc(PathBuilder &pb, const glm::vec2 &end_point, float angle, float radius_x, float radius_y, bool large_arc_flag, bool sweep_flag, unsigned int segmentCount)
+  {
+    assert(pb.Points.size() > 0);
+    glm::vec2 start_point = pb.Points.back();
+    // Use angle in radiens. Comes in as deg
+    angle = (angle * DEG2RAD);
+
+    // Into the frame of the ellipse axes, so rotate by -angle (glm matrices are column major)
+    glm::mat2 rotation_matrix = glm::mat2(glm::vec2(cosf(angle), -sinf(angle)), glm::vec2(sinf(angle), cosf(angle)));
+    glm::vec2 v = rotation_matrix * ((start_point - end_point) / 2.0f);
+
+    float x1p = v.x;
+    float y1p = v.y;
+
+    radius_x = srAbs(radius_x);
+    radius_y = srAbs(radius_y);
+
+    float lamba = ((x1p * x1p) / (radius_x * radius_x)) + ((y1p * y1p) / (radius_y * radius_y));
+    if (lamba > 1.0f)
+    {
+      radius_x *= sqrtf(lamba);
+      radius_y *= sqrtf(lamba);
     }
 
     float radius_x_sqr = radius_x * radius_x;
@@ -2027,293 +4715,2379 @@ namespace sr
     float x1p_sqr = x1p * x1p;
     float y1p_sqr = y1p * y1p;
 
-    float sign = (large_arc_flag == sweep_flag) ? -1.0f : 1.0f;
-    float c = sign * sqrtf(((radius_x_sqr * radius_y_sqr) - (radius_x_sqr * y1p_sqr) - (radius_y_sqr * x1p_sqr)) / ((radius_x_sqr * y1p_sqr) + (radius_y_sqr * x1p_sqr)));
+    float sign = (large_arc_flag == sweep_flag) ? -1.0f : 1.0f;
+    // Radii that just fit (half ellipses) can round to a slightly negative radicand
+    float c = sign * sqrtf(srMax(((radius_x_sqr * radius_y_sqr) - (radius_x_sqr * y1p_sqr) - (radius_y_sqr * x1p_sqr)) / ((radius_x_sqr * y1p_sqr) + (radius_y_sqr * x1p_sqr)), 0.0f));
+
+    glm::vec2 cp = c * glm::vec2((radius_x * y1p) / radius_y, (-radius_y * x1p) / radius_x);
+    glm::mat2 cp_rotation_matrix = glm::mat2(glm::vec2(cosf(angle), sinf(angle)), glm::vec2(-sinf(angle), cosf(angle)));
+
+    glm::vec2 center_point = (cp_rotation_matrix * cp) + glm::vec2{(start_point.x + end_point.x) / 2.0f, (start_point.y + end_point.y) / 2.0f};
+
+    glm::vec2 angle_v = {(x1p - cp.x) / radius_x, (y1p - cp.y) / radius_y};
+
+    // Signed angle from a to b. Also defined for parallel vectors, which half ellipses have
+    auto arccos = [](const glm::vec2 &a, const glm::vec2 &b) -> float
+    {
+      return atan2f((a.x * b.y) - (a.y * b.x), glm::dot(a, b));
+    };
+
+    float start_angle = arccos(glm::vec2{1.0f, 0.0f}, angle_v);
+
+    glm::vec2 angle_range_v = {(-x1p - cp.x) / radius_x, (-y1p - cp.y) / radius_y};
+    float angle_range = arccos(angle_v, angle_range_v);
+
+    if (!sweep_flag && angle_range > 0.0f)
+    {
+      angle_range -= 2.0f * PI;
+    }
+    else if (sweep_flag && angle_range < 0.0f)
+    {
+      angle_range += 2.0f * PI;
+    }
+
+    if (segmentCount == 0)
+    {
+      segmentCount = PathArcSegmentCount(srMax(radius_x, radius_y), angle_range);
+    }
+
+    // Rotate the unit point by the step instead of evaluating sin and cos per segment
+    const float sinStep = sinf(angle_range / segmentCount);
+    const float cosStep = cosf(angle_range / segmentCount);
+    glm::vec2 unit(cosf(start_angle), sinf(start_angle));
+
+    for (unsigned int i = 1; i < segmentCount; i++)
+    {
+      unit = glm::vec2(unit.x * cosStep - unit.y * sinStep, unit.y * cosStep + unit.x * sinStep);
+      glm::vec2 currentPosition = cp_rotation_matrix * glm::vec2(radius_x * unit.x, radius_y * unit.y);
+
+      pb.Points.push_back(center_point + currentPosition);
+    }
+    pb.Points.push_back(end_point);
+  }
+
+  R_API void srPathCubicBezierTo(const glm::vec2 &controll1, const glm::vec2 &controll2, const glm::vec2 &endPosition, unsigned int segmentCount)
+  {
+    PathCommand &command = PathRecordCommand(PathCommandType_CubicBezier, segmentCount);
+    PathRecordPoint(command, controll1);
+    PathRecordPoint(command, controll2);
+    PathRecordPoint(command, endPosition);
+  }
+
+  static void PathFlattenCubicBezier(PathBuilder &pb, const glm::vec2 &controll1, const glm::vec2 &controll2, const glm::vec2 &endPosition, unsigned int segmentCount)
+  {
+    assert(pb.Points.size() > 0);
+    glm::vec2 start_point = pb.Points.back();
+
+    if (segmentCount == 0)
+    {
+      const float tolerance = PathToleranceWorld();
+      PathFlattenCubic(pb, start_point, controll1, controll2, endPosition, tolerance * tolerance, 0);
+      return;
+    }
+
+    for (unsigned int i = 1; i <= segmentCount; i++)
+    {
+      float t = (float)i / (float)segmentCount;
+      float u = 1.0f - t;
+      float tt = t * t;
+      float uu = u * u;
+      float uuu = uu * u;
+      float ttt = tt * t;
+
+      glm::vec2 p = uuu * start_point;
+      p += 3 * uu * t * controll1;
+      p += 3 * u * tt * controll2;
+      p += ttt * endPosition;
+
+      pb.Points.push_back(p);
+    }
+  }
+
+  R_API void srPathQuadraticBezierTo(const glm::vec2 &controll, const glm::vec2 &endPosition, unsigned int segmentCount)
+  {
+    PathCommand &command = PathRecordCommand(PathCommandType_QuadraticBezier, segmentCount);
+    PathRecordPoint(command, controll);
+    PathRecordPoint(command, endPosition);
+  }
+
+  static void PathFlattenQuadraticBezier(PathBuilder &pb, const glm::vec2 &controll, const glm::vec2 &endPosition, unsigned int segmentCount)
+  {
+    assert(pb.Points.size() > 0);
+    glm::vec2 start_point = pb.Points.back();
+
+    if (segmentCount == 0)
+    {
+      // Degree elevation to a cubic, which has the same shape
+      const glm::vec2 controll1 = start_point + (controll - start_point) * (2.0f / 3.0f);
+      const glm::vec2 controll2 = endPosition + (controll - endPosition) * (2.0f / 3.0f);
+      const float tolerance = PathToleranceWorld();
+      PathFlattenCubic(pb, start_point, controll1, controll2, endPosition, tolerance * tolerance, 0);
+      return;
+    }
+
+    for (unsigned int i = 1; i <= segmentCount; i++)
+    {
+      float t = (float)i / (float)segmentCount;
+      float u = 1.0f - t;
+      float tt = t * t;
+      float uu = u * u;
+
+      glm::vec2 p = uu * start_point;
+      p += 2 * u * t * controll;
+      p += tt * endPosition;
+
+      pb.Points.push_back(p);
+    }
+  }
+
+  R_API void srPathSetStrokeEnabled(bool showStroke)
+  {
+    if (showStroke)
+      SRC->MainRenderBatch.Path.RenderType |= PathType_Stroke;
+    else
+      SRC->MainRenderBatch.Path.RenderType &= ~PathType_Stroke;
+  }
+
+  R_API void srPathSetFillEnabled(bool fill)
+  {
+    if (fill)
+      SRC->MainRenderBatch.Path.RenderType |= PathType_Fill;
+    else
+      SRC->MainRenderBatch.Path.RenderType &= ~PathType_Fill;
+  }
+
+  R_API void srPathSetFillColor(Color color)
+  {
+    SRC->MainRenderBatch.Path.CurrentPathStyle.FillColor = color;
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetFillColor(const glm::vec4 &color)
+  {
+    srPathSetFillColor(srGetColorFromFloat(color));
+  }
+
+  R_API void srPathSetStrokeColor(Color color)
+  {
+    SRC->MainRenderBatch.Path.CurrentPathStyle.StrokeColor = color;
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetStrokeColor(const glm::vec4 &color)
+  {
+    srPathSetStrokeColor(srGetColorFromFloat(color));
+  }
+
+  R_API void srPathSetStrokeWidth(float width)
+  {
+    SRC->MainRenderBatch.Path.CurrentPathStyle.StrokeWidth = width;
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetLineJoin(LineJoin_ join)
+  {
+    SRC->MainRenderBatch.Path.CurrentPathStyle.LineJoin = join;
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetLineCap(LineCap_ cap)
+  {
+    SRC->MainRenderBatch.Path.CurrentPathStyle.LineCap = cap;
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetMiterLimit(float limit)
+  {
+    SRC->MainRenderBatch.Path.CurrentPathStyle.MiterLimit = srMax(limit, 1.0f);
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetDash(float length, float gap, float offset)
+  {
+    PathStyle &style = SRC->MainRenderBatch.Path.CurrentPathStyle;
+    style.DashLength = srMax(length, 0.0f);
+    style.DashGap = srMax(gap, 0.0f);
+    style.DashOffset = offset;
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetFillGradient(GradientHandle gradient)
+  {
+    SRC->MainRenderBatch.Path.CurrentPathStyle.FillGradient = gradient;
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetStrokeGradient(GradientHandle gradient)
+  {
+    SRC->MainRenderBatch.Path.CurrentPathStyle.StrokeGradient = gradient;
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetStyle(const PathStyle &style)
+  {
+    SRC->MainRenderBatch.Path.CurrentPathStyle = style;
+    PathRecordStyle();
+  }
+
+  R_API void srPathSetFillRule(FillRule_ rule)
+  {
+    SRC->MainRenderBatch.Path.FillRule = rule;
+  }
+
+  R_API void srPathSetFillMode(PathFillMode_ mode)
+  {
+    SRC->MainRenderBatch.Path.FillMode = mode;
+  }
+
+  R_API void srPathSetStrokeMode(PathStrokeMode_ mode)
+  {
+    SRC->MainRenderBatch.Path.StrokeMode = mode;
+  }
+
+  R_API void srPathSetSimplify(bool enabled)
+  {
+    SRC->MainRenderBatch.Path.Simplify = enabled;
+  }
+
+  static PathBuilder::PathStyleIndex &PathBuilderNewStyle(PathBuilder &pb)
+  {
+    if (pb.Styles.size() == 0)
+    {
+      PathBuilder::PathStyleIndex newStyleIndex;
+      newStyleIndex.first = pb.Points.size();
+      newStyleIndex.second = pb.CurrentPathStyle;
+      pb.Styles.push_back(newStyleIndex);
+      pb.PreviousStyleVertexIndex = 0;
+      return pb.Styles.back();
+    }
+
+    PathBuilder::PathStyleIndex &lastStyle = pb.Styles.back();
+
+    // We have no new points, we can just modify the current one
+    if (pb.Points.size() - (pb.PreviousStyleVertexIndex + lastStyle.first) == 0)
+    {
+      return lastStyle;
+    }
+
+    lastStyle.first = pb.Points.size() - pb.PreviousStyleVertexIndex;
+    pb.PreviousStyleVertexIndex += lastStyle.first;
+
+    // Create new style index
+    PathBuilder::PathStyleIndex newStyleIndex;
+    newStyleIndex.second = lastStyle.second;
+
+    pb.Styles.push_back(newStyleIndex);
+    return pb.Styles.back();
+  }
+
+  R_API PathBuilder::PathStyleIndex &srPathBuilderNewStyle()
+  {
+    return PathBuilderNewStyle(SRC->MainRenderBatch.Path);
+  }
+
+  static void PathFlatten(PathBuilder &pb)
+  {
+    for (const PathCommand &command : pb.Commands)
+    {
+      const glm::vec2 *points = pb.CommandPoints.data() + command.First;
+      switch (command.Type)
+      {
+      case PathCommandType_MoveTo:
+        PathFlattenMoveTo(pb, points[0]);
+        break;
+      case PathCommandType_LineTo:
+        pb.Points.insert(pb.Points.end(), points, points + command.Count);
+        break;
+      case PathCommandType_Arc:
+        PathFlattenArc(pb, points[0], command.Params[0], command.Params[1], command.Params[2], command.SegmentCount);
+        break;
+      case PathCommandType_EllipticalArc:
+        PathFlattenEllipticalArc(pb, points[0], command.Params[0], command.Params[1], command.Params[2], command.Params[3] != 0.0f, command.Params[4] != 0.0f, command.SegmentCount);
+        break;
+      case PathCommandType_CubicBezier:
+        PathFlattenCubicBezier(pb, points[0], points[1], points[2], command.SegmentCount);
+        break;
+      case PathCommandType_QuadraticBezier:
+        PathFlattenQuadraticBezier(pb, points[0], points[1], command.SegmentCount);
+        break;
+      case PathCommandType_Close:
+        if (pb.Points.size() > 1)
+        {
+          pb.Points.push_back(pb.Points[0]);
+        }
+        break;
+      case PathCommandType_Style:
+        PathBuilderNewStyle(pb).second = pb.CommandStyles[command.First];
+        break;
+      }
+    }
+  }
+
+  // Path simplification
+  //
+  // Runs of points within the same pixel column are reduced to their first, lowest, highest and last point first.
+  // That is linear and keeps the look of dense time series no matter how many samples share a pixel. Douglas-Peucker
+  // then removes the points within the tolerance of the polyline that remains. Subpath starts and style changes are
+  // always kept. Column width and tolerance snap to powers of two of the path units, so zooming reuses the cached
+  // result of the level until it is off by more than a factor of two
+
+  struct SimplifyScratch
+  {
+    std::vector<glm::vec2> Points;
+    std::vector<glm::vec2> Columns;
+    std::vector<unsigned char> Keep;
+    std::vector<std::pair<unsigned int, unsigned int>> Stack;
+    std::vector<unsigned int> StyleStarts;
+  };
+  static thread_local SimplifyScratch sSimplifyScratch;
+
+  // Keeps the first, lowest, highest and last point of every run of points in the same column
+  static void SimplifyColumns(const glm::vec2 *points, size_t count, float cell, std::vector<glm::vec2> &out)
+  {
+    size_t i = 0;
+    while (i < count)
+    {
+      const float left = floorf(points[i].x / cell) * cell;
+      const float right = left + cell;
+      size_t low = i;
+      size_t high = i;
+      float lowY = points[i].y;
+      float highY = points[i].y;
+      size_t end = i + 1;
+      while (end < count && points[end].x >= left && points[end].x < right)
+      {
+        const float y = points[end].y;
+        if (y < lowY)
+        {
+          lowY = y;
+          low = end;
+        }
+        if (y > highY)
+        {
+          highY = y;
+          high = end;
+        }
+        end++;
+      }
+
+      const size_t last = end - 1;
+      const size_t first = srMin(low, high);
+      const size_t second = srMax(low, high);
+      out.push_back(points[i]);
+      if (first != i && first != last)
+      {
+        out.push_back(points[first]);
+      }
+      if (second != first && second != i && second != last)
+      {
+        out.push_back(points[second]);
+      }
+      if (last != i)
+      {
+        out.push_back(points[last]);
+      }
+      i = end;
+    }
+  }
+
+  static float SimplifySegmentDistanceSqr(const glm::vec2 &point, const glm::vec2 &a, const glm::vec2 &b)
+  {
+    const glm::vec2 ab = b - a;
+    const float lengthSqr = glm::dot(ab, ab);
+    const float t = lengthSqr > 0.0f ? srClamp(glm::dot(point - a, ab) / lengthSqr, 0.0f, 1.0f) : 0.0f;
+    const glm::vec2 d = point - (a + ab * t);
+    return glm::dot(d, d);
+  }
+
+  // Appends the simplified points. The first point is left out when it was already added by the range before
+  static void SimplifyRange(const glm::vec2 *points, size_t count, float cell, float tolerance, bool skipFirst, std::vector<glm::vec2> &out)
+  {
+    SimplifyScratch &scratch = sSimplifyScratch;
+    scratch.Columns.clear();
+    SimplifyColumns(points, count, cell, scratch.Columns);
+
+    const std::vector<glm::vec2> &columns = scratch.Columns;
+    const unsigned int columnCount = columns.size();
+    scratch.Keep.assign(columnCount, 0);
+    scratch.Keep[0] = 1;
+    scratch.Keep[columnCount - 1] = 1;
+
+    // Douglas-Peucker without recursion
+    const float toleranceSqr = tolerance * tolerance;
+    scratch.Stack.clear();
+    scratch.Stack.push_back({0u, columnCount - 1});
+    while (!scratch.Stack.empty())
+    {
+      const std::pair<unsigned int, unsigned int> range = scratch.Stack.back();
+      scratch.Stack.pop_back();
+
+      float farthestSqr = 0.0f;
+      unsigned int farthest = 0;
+      for (unsigned int i = range.first + 1; i < range.second; i++)
+      {
+        const float distanceSqr = SimplifySegmentDistanceSqr(columns[i], columns[range.first], columns[range.second]);
+        if (distanceSqr > farthestSqr)
+        {
+          farthestSqr = distanceSqr;
+          farthest = i;
+        }
+      }
+      if (farthestSqr > toleranceSqr)
+      {
+        scratch.Keep[farthest] = 1;
+        scratch.Stack.push_back({range.first, farthest});
+        scratch.Stack.push_back({farthest, range.second});
+      }
+    }
+
+    for (unsigned int i = skipFirst ? 1 : 0; i < columnCount; i++)
+    {
+      if (scratch.Keep[i])
+      {
+        out.push_back(columns[i]);
+      }
+    }
+  }
+
+  // Turns the new style start indices back into the point counts of PathBuilder::Styles
+  static void PathSimplifyApplyStyles(PathBuilder &pb, const std::vector<unsigned int> &styleStarts)
+  {
+    unsigned int previous = 0;
+    for (size_t i = 0; i < styleStarts.size(); i++)
+    {
+      pb.Styles[i].first = styleStarts[i] - previous;
+      previous = styleStarts[i];
+    }
+  }
+
+  static void PathSimplifyCacheEvict(PathSimplifyCache *cache)
+  {
+    while (cache->Bytes > cache->Budget && cache->Entries.size() > 0)
+    {
+      const PathSimplifyEntry &last = cache->Entries.back();
+      cache->Bytes -= last.Bytes;
+      cache->Lookup.erase(last.Key);
+      cache->Entries.pop_back();
+    }
+  }
+
+  static bool PathSimplifyEntryMatches(const PathSimplifyEntry &entry, const PathBuilder &pb, const std::vector<unsigned int> &styleStarts, int level)
+  {
+    return entry.Level == level && entry.Tolerance == SRC->PathTolerance && entry.SourcePoints.size() == pb.Points.size() &&
+           entry.SourceSubpathStarts == pb.SubpathStarts && entry.SourceStyleStarts == styleStarts &&
+           memcmp(entry.SourcePoints.data(), pb.Points.data(), pb.Points.size() * sizeof(glm::vec2)) == 0;
+  }
+
+  static void PathSimplify(PathBuilder &pb)
+  {
+    SimplifyScratch &scratch = sSimplifyScratch;
+
+    // Style changes as point indices. The count of the last style is not used
+    scratch.StyleStarts.clear();
+    unsigned int styleStart = 0;
+    for (size_t i = 0; i + 1 < pb.Styles.size(); i++)
+    {
+      styleStart += pb.Styles[i].first;
+      scratch.StyleStarts.push_back(styleStart);
+    }
+
+    const int level = (int)floorf(log2f(1.0f / srGetPixelScale()));
+    const float cell = ldexpf(1.0f, level);
+    const float tolerance = cell * SRC->PathTolerance;
+
+    // Paths small enough for the path cache get their tessellation cached instead
+    PathSimplifyCache *cache = GetPathSimplifyCache();
+    const bool cacheable = pb.Points.size() > SR_PATH_CACHE_MAX_POINTS && cache->Budget > 0;
+    uint64_t key = 0;
+    if (cacheable)
+    {
+      key = srHashMemory(pb.Points.data(), pb.Points.size() * sizeof(glm::vec2), (uint64_t)(level + 1024));
+      key = srHashMemory(pb.SubpathStarts.data(), pb.SubpathStarts.size() * sizeof(unsigned int), key);
+      key = srHashMemory(scratch.StyleStarts.data(), scratch.StyleStarts.size() * sizeof(unsigned int), key);
+      key = srHashMemory(&SRC->PathTolerance, sizeof(float), key);
+
+      std::lock_guard<std::mutex> lock(cache->Mutex);
+      auto found = cache->Lookup.find(key);
+      if (found != cache->Lookup.end() && PathSimplifyEntryMatches(*found->second, pb, scratch.StyleStarts, level))
+      {
+        cache->Entries.splice(cache->Entries.begin(), cache->Entries, found->second);
+        const PathSimplifyEntry &entry = *found->second;
+        pb.Points.assign(entry.Points.begin(), entry.Points.end());
+        pb.SubpathStarts.assign(entry.SubpathStarts.begin(), entry.SubpathStarts.end());
+        scratch.StyleStarts.assign(entry.StyleStarts.begin(), entry.StyleStarts.end());
+        PathSimplifyApplyStyles(pb, scratch.StyleStarts);
+        return;
+      }
+    }
+
+    // The source goes into the entry before the points are replaced
+    PathSimplifyEntry entry;
+    if (cacheable)
+    {
+      entry.Key = key;
+      entry.Level = level;
+      entry.Tolerance = SRC->PathTolerance;
+      entry.SourcePoints = pb.Points;
+      entry.SourceSubpathStarts = pb.SubpathStarts;
+      entry.SourceStyleStarts = scratch.StyleStarts;
+    }
+
+    std::vector<glm::vec2> &out = scratch.Points;
+    out.clear();
+    size_t nextStyle = 0;
+    for (unsigned int subpath = 0; subpath < PathSubpathCount(pb); subpath++)
+    {
+      unsigned int first = 0;
+      unsigned int count = 0;
+      PathGetSubpath(pb, subpath, &first, &count);
+      if (subpath > 0)
+      {
+        pb.SubpathStarts[subpath - 1] = out.size();
+      }
+      if (count == 0)
+      {
+        continue;
+      }
+      while (nextStyle < scratch.StyleStarts.size() && scratch.StyleStarts[nextStyle] <= first)
+      {
+        scratch.StyleStarts[nextStyle++] = out.size();
+      }
+
+      // Split at the style changes, the points there are shared by both ranges
+      const unsigned int end = first + count;
+      unsigned int rangeStart = first;
+      while (true)
+      {
+        const bool styleChange = nextStyle < scratch.StyleStarts.size() && scratch.StyleStarts[nextStyle] < end;
+        const unsigned int rangeEnd = styleChange ? scratch.StyleStarts[nextStyle] : end - 1;
+        SimplifyRange(pb.Points.data() + rangeStart, rangeEnd - rangeStart + 1, cell, tolerance, rangeStart != first, out);
+        if (!styleChange)
+        {
+          break;
+        }
+        scratch.StyleStarts[nextStyle++] = out.size() - 1;
+        rangeStart = rangeEnd;
+      }
+    }
+    while (nextStyle < scratch.StyleStarts.size())
+    {
+      scratch.StyleStarts[nextStyle++] = out.size();
+    }
+
+    pb.Points.assign(out.begin(), out.end()); // Not swapped, so both keep their capacity for the next path
+    PathSimplifyApplyStyles(pb, scratch.StyleStarts);
+
+    if (!cacheable)
+    {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(cache->Mutex);
+    if (cache->Lookup.count(key) == 0) // Another worker may have simplified the same path, or one with the same hash
+    {
+      entry.Points = pb.Points;
+      entry.SubpathStarts = pb.SubpathStarts;
+      entry.StyleStarts = scratch.StyleStarts;
+      entry.Bytes = (entry.SourcePoints.size() + entry.Points.size()) * sizeof(glm::vec2) + sizeof(PathSimplifyEntry) +
+                    (entry.SourceSubpathStarts.size() + entry.SourceStyleStarts.size() + entry.SubpathStarts.size() + entry.StyleStarts.size()) * sizeof(unsigned int);
+      cache->Bytes += entry.Bytes;
+      cache->Entries.push_front(std::move(entry));
+      cache->Lookup[key] = cache->Entries.begin();
+      PathSimplifyCacheEvict(cache);
+    }
+  }
+
+  // Path cache
+  //
+  // The key covers everything the tessellation depends on. Points are taken relative to the first recorded point and
+  // snapped to a small fraction of the tolerance, so the same shape at another position gets the same key.
+
+  static bool PathCacheGetKey(const PathBuilder &pb, bool closedPath, uint64_t *key, std::vector<uint32_t> &keyData, glm::vec2 *anchor)
+  {
+    if (GetPathCache()->Budget == 0 || pb.CommandPoints.size() == 0 || pb.CommandPoints.size() > SR_PATH_CACHE_MAX_POINTS)
+    {
+      return false;
+    }
+
+    keyData.clear();
+    auto pushFloat = [&keyData](float value)
+    {
+      uint32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      keyData.push_back(bits);
+    };
+
+    keyData.push_back(pb.RenderType);
+    keyData.push_back(closedPath ? 1 : 0);
+    keyData.push_back(pb.FillRule);
+    keyData.push_back(pb.FillMode);
+    keyData.push_back(pb.StrokeMode);
+    keyData.push_back(pb.Simplify ? 1 : 0);
+    keyData.push_back(SRC->AntiAliasing ? 1 : 0);
+    pushFloat(SRC->PathTolerance);
+    pushFloat(srGetPixelScale());
+
+    for (const PathCommand &command : pb.Commands)
+    {
+      keyData.push_back(command.Type);
+      keyData.push_back(command.Count);
+      keyData.push_back(command.SegmentCount);
+      for (float param : command.Params)
+      {
+        pushFloat(param);
+      }
+    }
+
+    auto pushStyle = [&keyData, &pushFloat](const PathStyle &style)
+    {
+      pushFloat(style.StrokeWidth);
+      keyData.push_back(style.StrokeColor);
+      keyData.push_back(style.FillColor);
+      keyData.push_back(style.LineJoin);
+      keyData.push_back(style.LineCap);
+      pushFloat(style.MiterLimit);
+      pushFloat(style.DashLength);
+      pushFloat(style.DashGap);
+      pushFloat(style.DashOffset);
+      keyData.push_back(style.FillGradient);
+      keyData.push_back(style.StrokeGradient);
+    };
+
+    // Points before the first style command are drawn with the current style
+    pushStyle(pb.CurrentPathStyle);
+    for (const PathStyle &style : pb.CommandStyles)
+    {
+      pushStyle(style);
+    }
+
+    *anchor = pb.CommandPoints[0];
+    const float quantum = PathToleranceWorld() / 64.0f;
+    for (const glm::vec2 &point : pb.CommandPoints)
+    {
+      const int64_t x = llroundf((point.x - anchor->x) / quantum);
+      const int64_t y = llroundf((point.y - anchor->y) / quantum);
+      keyData.push_back((uint32_t)x);
+      keyData.push_back((uint32_t)(x >> 32));
+      keyData.push_back((uint32_t)y);
+      keyData.push_back((uint32_t)(y >> 32));
+    }
+
+    *key = srHashMemory(keyData.data(), keyData.size() * sizeof(uint32_t));
+    return true;
+  }
+
+  // Adds a tessellated path to the batch, moved to the anchor and the current depth
+  static void PathReplayEntry(const PathCacheEntry &entry, const glm::vec2 &anchor)
+  {
+    RenderBatch &rb = SRC->MainRenderBatch;
+    const glm::vec3 offset(anchor.x, anchor.y, (float)rb.CurrentDepth);
+    const RenderBatch::Vertex *vertex = entry.Vertices.data();
+    const unsigned int *index = entry.Indices.data();
+    for (const PathCacheEntry::Draw &draw : entry.Draws)
+    {
+      SRC->Stencil = draw.Stencil;
+      srBegin(draw.Mode, draw.Mat);
+      srCheckRenderBatchLimit(draw.VertexCount, draw.IndexCount);
+
+      const unsigned int base = rb.VertexCounter;
+      for (unsigned int i = 0; i < draw.VertexCount; i++)
+      {
+        RenderBatch::Vertex &target = rb.DrawBuffer.Vertices[rb.VertexCounter++];
+        target = vertex[i];
+        target.Pos += offset;
+      }
+      for (unsigned int i = 0; i < draw.IndexCount; i++)
+      {
+        rb.DrawBuffer.DynamicIndices[rb.IndexCounter++] = base + index[i];
+      }
+      rb.DrawCalls[rb.CurrentDraw].VertexCount += draw.VertexCount;
+      rb.DrawCalls[rb.CurrentDraw].IndexCount += draw.IndexCount;
+
+      vertex += draw.VertexCount;
+      index += draw.IndexCount;
+    }
+    SRC->Stencil = StencilMode_None;
+    rb.CurrentDepth += entry.DepthAdvance;
+  }
+
+  static bool PathCacheReplay(uint64_t key, const std::vector<uint32_t> &keyData, const glm::vec2 &anchor)
+  {
+    PathCache *cache = GetPathCache();
+    auto found = cache->Lookup.find(key);
+    if (found == cache->Lookup.end() || found->second->KeyData != keyData)
+    {
+      cache->Misses++;
+      return false;
+    }
+    cache->Hits++;
+    cache->Entries.splice(cache->Entries.begin(), cache->Entries, found->second);
+    PathReplayEntry(*found->second, anchor);
+    return true;
+  }
+
+  // Batch position before a path gets tessellated
+  struct PathCapture
+  {
+    unsigned int FlushCounter;
+    unsigned int Draw;
+    unsigned int Vertex;
+    unsigned int Index;
+    unsigned int DrawVertex; // Where the draw call at the capture starts
+    unsigned int DrawIndex;
+    double Depth;
+  };
+
+  static PathCapture PathCaptureBegin()
+  {
+    const RenderBatch &rb = RecordingBatch();
+    const RenderBatch::DrawCall &drawCall = rb.DrawCalls[rb.CurrentDraw];
+    return {rb.FlushCounter, rb.CurrentDraw, rb.VertexCounter, rb.IndexCounter, rb.VertexCounter - drawCall.VertexCount, rb.IndexCounter - drawCall.IndexCount, rb.CurrentDepth};
+  }
+
+  // Copies what was added to the batch since the capture began. Returns false when parts of the path were already drawn
+  static bool PathCaptureEnd(const PathCapture &capture, const glm::vec2 &anchor, PathCacheEntry &entry)
+  {
+    const RenderBatch &rb = RecordingBatch();
+    if (rb.FlushCounter != capture.FlushCounter)
+    {
+      return false;
+    }
+
+    entry.Draws.clear();
+    entry.Vertices.clear();
+    entry.Indices.clear();
+    entry.DepthAdvance = (float)(rb.CurrentDepth - capture.Depth);
+
+    const glm::vec3 offset(anchor.x, anchor.y, (float)capture.Depth);
+    unsigned int drawVertexStart = capture.DrawVertex;
+    unsigned int drawIndexStart = capture.DrawIndex;
+    for (unsigned int i = capture.Draw; i <= rb.CurrentDraw; i++)
+    {
+      const RenderBatch::DrawCall &drawCall = rb.DrawCalls[i];
+      const unsigned int vertexBegin = i == capture.Draw ? capture.Vertex : drawVertexStart;
+      const unsigned int vertexEnd = drawVertexStart + drawCall.VertexCount;
+      const unsigned int indexBegin = i == capture.Draw ? capture.Index : drawIndexStart;
+      const unsigned int indexEnd = drawIndexStart + drawCall.IndexCount;
+
+      if (vertexEnd > vertexBegin)
+      {
+        entry.Draws.push_back({drawCall.Mode, drawCall.Mat, drawCall.Stencil, vertexEnd - vertexBegin, indexEnd - indexBegin});
+        for (unsigned int v = vertexBegin; v < vertexEnd; v++)
+        {
+          RenderBatch::Vertex vertex = rb.DrawBuffer.Vertices[v];
+          vertex.Pos -= offset;
+          entry.Vertices.push_back(vertex);
+        }
+        for (unsigned int index = indexBegin; index < indexEnd; index++)
+        {
+          entry.Indices.push_back(rb.DrawBuffer.DynamicIndices[index] - vertexBegin);
+        }
+      }
+
+      drawVertexStart += drawCall.VertexCount + drawCall.VertexAlignment;
+      drawIndexStart += drawCall.IndexCount;
+    }
+
+    entry.Bytes = sizeof(PathCacheEntry) + entry.Draws.size() * sizeof(PathCacheEntry::Draw) + entry.Vertices.size() * sizeof(RenderBatch::Vertex) + entry.Indices.size() * sizeof(unsigned int);
+    return true;
+  }
+
+  static void PathCacheEvict(PathCache *cache)
+  {
+    while (cache->Bytes > cache->Budget && cache->Entries.size() > 0)
+    {
+      const PathCacheEntry &last = cache->Entries.back();
+      cache->Bytes -= last.Bytes;
+      cache->Lookup.erase(last.Key);
+      cache->Entries.pop_back();
+    }
+  }
+
+  static void PathCacheInsert(PathCacheEntry &&entry)
+  {
+    PathCache *cache = GetPathCache();
+    entry.Bytes += entry.KeyData.capacity() * sizeof(uint32_t);
+    if (entry.Bytes > cache->Budget)
+    {
+      return;
+    }
+
+    // Another path with the same hash
+    const uint64_t key = entry.Key;
+    auto found = cache->Lookup.find(key);
+    if (found != cache->Lookup.end())
+    {
+      cache->Bytes -= found->second->Bytes;
+      cache->Entries.erase(found->second);
+      cache->Lookup.erase(found);
+    }
+
+    cache->Bytes += entry.Bytes;
+    cache->Entries.push_front(std::move(entry));
+    cache->Lookup[key] = cache->Entries.begin();
+    PathCacheEvict(cache);
+  }
+
+  // Flattens and tessellates the path into the recording batch. Returns false when the path has no points
+  static bool PathTessellate(PathBuilder &pb, bool closedPath)
+  {
+    PathFlatten(pb);
+    if (pb.Simplify && pb.Points.size() > 2)
+    {
+      PathSimplify(pb);
+    }
+    if (pb.Points.size() == 0)
+    {
+      return false;
+    }
+
+    if (pb.RenderType & PathType_Fill)
+    {
+      srAddPolyFilled(pb);
+    }
+    if (pb.RenderType & PathType_Stroke)
+    {
+      srAddPolyline(pb, closedPath);
+    }
+    return true;
+  }
+
+  // Replays the path from the cache, or tessellates and stores it
+  static void PathDraw(PathBuilder &pb, bool closedPath)
+  {
+    uint64_t key = 0;
+    static thread_local std::vector<uint32_t> keyData;
+    glm::vec2 anchor{};
+    const bool cacheable = PathCacheGetKey(pb, closedPath, &key, keyData, &anchor);
+    if (cacheable && PathCacheReplay(key, keyData, anchor))
+    {
+      return;
+    }
+
+    const PathCapture capture = PathCaptureBegin();
+    if (PathTessellate(pb, closedPath) && cacheable)
+    {
+      PathCacheEntry entry;
+      entry.Key = key;
+      entry.KeyData = keyData;
+      if (PathCaptureEnd(capture, anchor, entry))
+      {
+        PathCacheInsert(std::move(entry));
+      }
+    }
+  }
+
+  // Deferred paths
+  //
+  // srEndPath copies the path and the state it depends on into the queue. The queue is drawn before anything else gets
+  // added to the batch, so the draw order is the same as without deferring. Runs of queued paths with the same state are
+  // flattened and tessellated by all workers at once, each into a batch of its own. The results are then copied into the
+  // main batch in the order the paths were ended. Paths in the path cache, stencil fills and paths that would not fit
+  // into the main batch are drawn by the flushing thread.
+
+  static bool PathJobSameState(const PathJob &a, const PathJob &b)
+  {
+    return a.Scissor == b.Scissor && a.Projection == b.Projection && a.Tolerance == b.Tolerance && a.AntiAliasing == b.AntiAliasing;
+  }
+
+  // Every draw of the entry has to fit into an empty main batch
+  static bool PathEntryFits(const PathCacheEntry &entry)
+  {
+    const RenderBatch &rb = SRC->MainRenderBatch;
+    for (const PathCacheEntry::Draw &draw : entry.Draws)
+    {
+      if (draw.VertexCount + 8 >= rb.DrawBuffer.ElementCount || draw.IndexCount > rb.DrawBuffer.IndexCapacity)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static void PathJobTessellate(PathJob &job, RenderBatch &batch)
+  {
+    batch.CurrentDraw = 0;
+    batch.DrawCalls[0] = RenderBatch::DrawCall{};
+    batch.VertexCounter = 0;
+    batch.IndexCounter = 0;
+    batch.CurrentDepth = 0.0;
+
+    tPathWorkerBatch = &batch;
+    tPathWorkerOverflow = false;
+    const PathCapture capture = PathCaptureBegin();
+    const bool drawn = PathTessellate(job.Path, job.Closed);
+    job.Parallel = drawn && !tPathWorkerOverflow && PathCaptureEnd(capture, job.Cacheable ? job.Anchor : glm::vec2(0.0f), job.Result) && PathEntryFits(job.Result);
+    tPathWorkerBatch = nullptr;
+  }
+
+  static void PathWorkerRun(PathQueue *queue, RenderBatch &batch)
+  {
+    for (size_t i = queue->NextWork++; i < queue->Work.size(); i = queue->NextWork++)
+    {
+      PathJobTessellate(*queue->Work[i], batch);
+    }
+  }
+
+  static void PathWorkerLoop(PathQueue *queue)
+  {
+    RenderBatch batch{};
+    PathWorkerBatchInit(batch);
+
+    uint64_t generation = 0;
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(queue->Mutex);
+        queue->WorkReady.wait(lock, [queue, generation]
+                              { return queue->Quit || queue->Generation != generation; });
+        if (queue->Quit)
+        {
+          break;
+        }
+        generation = queue->Generation;
+      }
+
+      PathWorkerRun(queue, batch);
+
+      std::lock_guard<std::mutex> lock(queue->Mutex);
+      if (--queue->Busy == 0)
+      {
+        queue->WorkDone.notify_one();
+      }
+    }
+    PathWorkerBatchFree(batch);
+  }
+
+  // Tessellates queue->Work on the calling thread and all workers. Returns when every job is done
+  static void PathWorkersTessellate(PathQueue *queue)
+  {
+    const unsigned int cores = std::thread::hardware_concurrency();
+    if (queue->Work.empty() || cores <= 1)
+    {
+      return; // Without workers the jobs are drawn directly, which saves copying them
+    }
+    if (!queue->Batch.DrawCalls)
+    {
+      PathWorkerBatchInit(queue->Batch);
+    }
+    if (queue->Work.size() > 1 && queue->Threads.empty())
+    {
+      for (unsigned int i = 0; i < srMin(cores - 1, (unsigned int)SR_PATH_MAX_WORKERS); i++)
+      {
+        queue->Threads.emplace_back(PathWorkerLoop, queue);
+      }
+    }
+
+    queue->NextWork = 0;
+    const bool parallel = queue->Work.size() > 1 && !queue->Threads.empty();
+    if (parallel)
+    {
+      {
+        std::lock_guard<std::mutex> lock(queue->Mutex);
+        queue->Busy = queue->Threads.size();
+        queue->Generation++;
+      }
+      queue->WorkReady.notify_all();
+    }
+
+    PathWorkerRun(queue, queue->Batch);
+
+    if (parallel)
+    {
+      std::unique_lock<std::mutex> lock(queue->Mutex);
+      queue->WorkDone.wait(lock, [queue]
+                           { return queue->Busy == 0; });
+    }
+  }
+
+  static void PathQueueFlush()
+  {
+    PathQueue *queue = sPathQueue;
+    if (!queue || queue->JobCount == 0 || queue->Flushing)
+    {
+      return;
+    }
+    queue->Flushing = true;
+
+    const ScissorTest scissor = SRC->Scissor;
+    const glm::mat4 projection = SRC->CurrentProjection;
+    const float tolerance = SRC->PathTolerance;
+    const bool antiAliasing = SRC->AntiAliasing;
+
+    PathCache *cache = GetPathCache();
+    size_t runStart = 0;
+    while (runStart < queue->JobCount)
+    {
+      size_t runEnd = runStart + 1;
+      while (runEnd < queue->JobCount && PathJobSameState(queue->Jobs[runStart], queue->Jobs[runEnd]))
+      {
+        runEnd++;
+      }
+
+      // The workers only read the context
+      const PathJob &state = queue->Jobs[runStart];
+      SRC->Scissor = state.Scissor;
+      SRC->CurrentProjection = state.Projection;
+      SRC->PathTolerance = state.Tolerance;
+      SRC->AntiAliasing = state.AntiAliasing;
+
+      queue->Work.clear();
+      queue->WorkKeys.clear();
+      for (size_t i = runStart; i < runEnd; i++)
+      {
+        PathJob &job = queue->Jobs[i];
+        job.Parallel = false;
+        const bool stencil = (job.Path.RenderType & PathType_Fill) && job.Path.FillMode == PathFillMode_Stencil;
+        const bool cached = job.Cacheable && (cache->Lookup.count(job.Key) > 0 || !queue->WorkKeys.insert(job.Key).second);
+        if (!stencil && !cached)
+        {
+          queue->Work.push_back(&job);
+        }
+      }
+      PathWorkersTessellate(queue);
+
+      for (size_t i = runStart; i < runEnd; i++)
+      {
+        PathJob &job = queue->Jobs[i];
+        if (job.Parallel)
+        {
+          PathReplayEntry(job.Result, job.Cacheable ? job.Anchor : glm::vec2(0.0f));
+          if (job.Cacheable)
+          {
+            cache->Misses++;
+            PathCacheEntry entry = job.Result;
+            entry.Key = job.Key;
+            entry.KeyData = job.KeyData;
+            PathCacheInsert(std::move(entry));
+          }
+        }
+        else
+        {
+          // Flattened again from the commands
+          job.Path.Points.clear();
+          job.Path.Styles.clear();
+          job.Path.SubpathStarts.clear();
+          PathDraw(job.Path, job.Closed);
+        }
+      }
+      runStart = runEnd;
+    }
 
-    glm::vec2 cp = c * glm::vec2((radius_x * y1p) / radius_y, (-radius_y * x1p) / radius_x);
-    glm::mat2 cp_rotation_matrix = glm::mat2(glm::vec2(cosf(angle), -sinf(angle)), glm::vec2(sinf(angle), cosf(angle)));
+    SRC->Scissor = scissor;
+    SRC->CurrentProjection = projection;
+    SRC->PathTolerance = tolerance;
+    SRC->AntiAliasing = antiAliasing;
+    queue->JobCount = 0;
+    queue->Flushing = false;
+  }
 
-    glm::vec2 center_point = (cp_rotation_matrix * cp) + glm::vec2{(start_point.x + end_point.x) / 2.0f, (start_point.y + end_point.y) / 2.0f};
+  static void PathQueuePush(const PathBuilder &pb, bool closedPath)
+  {
+    PathQueue *queue = GetPathQueue();
+    if (queue->JobCount == queue->Jobs.size())
+    {
+      queue->Jobs.emplace_back();
+    }
+    PathJob &job = queue->Jobs[queue->JobCount++];
+    job.Path = pb; // Copy assigned, so the vectors of the job keep their capacity
+    job.Closed = closedPath;
+    job.Cacheable = PathCacheGetKey(pb, closedPath, &job.Key, job.KeyData, &job.Anchor);
+    job.Scissor = SRC->Scissor;
+    job.Projection = SRC->CurrentProjection;
+    job.Tolerance = SRC->PathTolerance;
+    job.AntiAliasing = SRC->AntiAliasing;
+  }
 
-    glm::vec2 angle_v = {(x1p - cp.x) / radius_x, (y1p - cp.y) / radius_y};
+  R_API void srEndPath(bool closedPath)
+  {
+    PathBuilder &pb = SRC->MainRenderBatch.Path;
+    if (SRC->DeferredPaths)
+    {
+      if (pb.CommandPoints.size() > 0)
+      {
+        PathQueuePush(pb, closedPath);
+      }
+    }
+    else
+    {
+      PathQueueFlush();
+      PathDraw(pb, closedPath);
+    }
 
-    auto arccos = [](const glm::vec2 &a, const glm::vec2 &b) -> float
+    pb.Commands.clear();
+    pb.CommandPoints.clear();
+    pb.CommandStyles.clear();
+    pb.Styles.clear();
+    pb.Points.clear();
+    pb.SubpathStarts.clear();
+  }
+
+  R_API void srSetDeferredPaths(bool enabled)
+  {
+    if (!enabled)
     {
-      float sign = (a.x * b.y) - (a.y * b.x);
-      sign = sign / srAbs(sign);
-      return sign * acosf(glm::dot(a, b) / (glm::length(a) * glm::length(b)));
-    };
+      PathQueueFlush();
+    }
+    SRC->DeferredPaths = enabled;
+  }
 
-    float start_angle = arccos(glm::vec2{1.0f, 0.0f}, angle_v);
+  R_API bool srGetDeferredPaths()
+  {
+    return SRC->DeferredPaths;
+  }
 
-    glm::vec2 angle_range_v = {(-x1p - cp.x) / radius_x, (-y1p - cp.y) / radius_y};
-    float angle_range = arccos(angle_v, angle_range_v);
+  R_API void srPathClose()
+  {
+    PathRecordCommand(PathCommandType_Close);
+    srEndPath(true);
+  }
 
-    if (!sweep_flag && angle_range > 0.0f)
+  R_API void srPathCacheSetBudget(size_t bytes)
+  {
+    PathCache *cache = GetPathCache();
+    cache->Budget = bytes;
+    PathCacheEvict(cache);
+  }
+
+  R_API void srPathCacheClear()
+  {
+    PathCache *cache = GetPathCache();
+    cache->Entries.clear();
+    cache->Lookup.clear();
+    cache->Bytes = 0;
+  }
+
+  R_API void srPathSimplifyCacheSetBudget(size_t bytes)
+  {
+    PathSimplifyCache *cache = GetPathSimplifyCache();
+    std::lock_guard<std::mutex> lock(cache->Mutex);
+    cache->Budget = bytes;
+    PathSimplifyCacheEvict(cache);
+  }
+
+  R_API void srPathSimplifyCacheClear()
+  {
+    PathSimplifyCache *cache = GetPathSimplifyCache();
+    std::lock_guard<std::mutex> lock(cache->Mutex);
+    cache->Entries.clear();
+    cache->Lookup.clear();
+    cache->Bytes = 0;
+  }
+
+  R_API PathCacheStats srPathCacheGetStats()
+  {
+    PathCache *cache = GetPathCache();
+    PathCacheStats stats;
+    stats.Hits = cache->Hits;
+    stats.Misses = cache->Misses;
+    stats.Bytes = cache->Bytes;
+    stats.Entries = cache->Entries.size();
+    return stats;
+  }
+
+  // Stroking
+  //
+  // Segment directions and lengths are computed up front for a whole subpath, four segments at a time where sse2
+  // is available. Every point then emits the two edge vertices of the stroke and indexes them into quads, so
+  // straight runs and small angles cost 2 vertices and 6 indices per point. Sharper corners get their join geometry
+  // fanned around the inner corner.
+  //
+  // With anti aliasing every outline vertex gets a transparent twin one pixel further out. The fringe triangles between
+  // them are indexed after the opaque ones of the subpath, so the depth test keeps them from covering the stroke itself.
+  //
+  // Dashed paths carry the arc length and the dash pattern in their vertices and are cut into dashes by the DashShader,
+  // so they cost the same as solid ones.
+
+  struct StrokeScratch
+  {
+    std::vector<glm::vec2> Points;
+    std::vector<unsigned int> Source; // Index into the path points, for the style changes
+    std::vector<float> DirX;
+    std::vector<float> DirY;
+    std::vector<float> Length;
+    std::vector<unsigned int> FringeIndices; // Waiting for the opaque triangles of the subpath
+  };
+  static thread_local StrokeScratch sStrokeScratch;
+
+  // Offsets and colors of the current style
+  struct StrokeParams
+  {
+    PathStyle Style;
+    bool AntiAlias;
+    bool Dashed;       // The path is drawn with the dash material
+    float Gradient;    // Normal.z of the vertices. 0 without a gradient
+    float FringeWidth; // One pixel in path units
+    float Solid;       // Distance of the opaque vertices from the center line
+    float Fringe;      // Distance of the transparent vertices. Same as Solid without anti aliasing
+    Color SolidColor;
+    Color FringeColor;
+  };
+
+  // A vertex on the outline, at Center + Offset * distance. With anti aliasing it has a transparent twin
+  struct StrokePoint
+  {
+    unsigned int Solid;
+    unsigned int Fringe;
+    glm::vec2 Center;
+    glm::vec2 Offset;
+    float Distance; // Along the stroke, for dashes
+  };
+
+  // Cross section at the end of the last emitted stroke section. Plus is on the side of the segment normal (dir.y, -dir.x)
+  struct StrokeEdge
+  {
+    StrokePoint Plus;
+    StrokePoint Minus;
+  };
+
+  static Color ColorScaleAlpha(Color color, float scale)
+  {
+    const unsigned int alpha = (unsigned int)((color >> 24) * srClamp(scale, 0.0f, 1.0f));
+    return (color & 0x00ffffff) | (alpha << 24);
+  }
+
+  static StrokeParams StrokeGetParams(const PathStyle &style, float width, bool dashed)
+  {
+    StrokeParams params;
+    params.Style = style;
+    params.AntiAlias = SRC->AntiAliasing;
+    params.Dashed = dashed;
+    params.Gradient = (float)style.StrokeGradient;
+    params.SolidColor = style.StrokeGradient != 0 ? (style.StrokeColor | 0x00ffffff) : style.StrokeColor;
+
+    const float halfWidth = width * 0.5f;
+    if (params.AntiAlias)
     {
-      angle_range -= 2.0f * PI;
+      // Lines thinner than the fringe fade out instead of getting thinner
+      params.FringeWidth = 1.0f / srGetPixelScale();
+      params.Solid = srMax(halfWidth - params.FringeWidth * 0.5f, 0.0f);
+      params.Fringe = srMax(halfWidth, params.FringeWidth * 0.5f) + params.FringeWidth * 0.5f;
+      if (width < params.FringeWidth)
+      {
+        params.SolidColor = ColorScaleAlpha(params.SolidColor, width / params.FringeWidth);
+      }
     }
-    else if (sweep_flag && angle_range < 0.0f)
+    else
     {
-      angle_range += 2.0f * PI;
+      params.FringeWidth = 0.0f;
+      params.Solid = halfWidth;
+      params.Fringe = halfWidth;
+    }
+    params.FringeColor = params.SolidColor & 0x00ffffff;
+    return params;
+  }
+
+  static void StrokeComputeSegments(const glm::vec2 *points, size_t segmentCount, float *dirX, float *dirY, float *length)
+  {
+    size_t i = 0;
+#ifdef SR_USE_SSE2
+    static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "Points have to be tightly packed");
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= segmentCount; i += 4)
+    {
+      const float *p = &points[i].x;
+      const __m128 a = _mm_loadu_ps(p);     // x0 y0 x1 y1
+      const __m128 b = _mm_loadu_ps(p + 4); // x2 y2 x3 y3
+      const __m128 c = _mm_loadu_ps(p + 2); // x1 y1 x2 y2
+      const __m128 d = _mm_loadu_ps(p + 6); // x3 y3 x4 y4
+
+      const __m128 dx = _mm_sub_ps(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      const __m128 dy = _mm_sub_ps(_mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+      const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+      const __m128 invLen = _mm_and_ps(_mm_cmpgt_ps(len, zero), _mm_div_ps(one, len));
+
+      _mm_storeu_ps(dirX + i, _mm_mul_ps(dx, invLen));
+      _mm_storeu_ps(dirY + i, _mm_mul_ps(dy, invLen));
+      _mm_storeu_ps(length + i, len);
+    }
+#endif
+    for (; i < segmentCount; i++)
+    {
+      const float dx = points[i + 1].x - points[i].x;
+      const float dy = points[i + 1].y - points[i].y;
+      const float len = sqrtf(dx * dx + dy * dy);
+      const float invLen = len > 0.0f ? 1.0f / len : 0.0f;
+      dirX[i] = dx * invLen;
+      dirY[i] = dy * invLen;
+      length[i] = len;
+    }
+  }
+
+  // Fills the scratch with the subpath without repeated points. Closed subpaths repeat their first point at the end,
+  // closed is cleared when there are too few points for an area. Returns the number of segments
+  static size_t StrokeLoadSubpath(const PathBuilder &pb, unsigned int first, unsigned int count, bool &closed)
+  {
+    StrokeScratch &scratch = sStrokeScratch;
+    scratch.Points.clear();
+    scratch.Source.clear();
+    for (unsigned int i = first; i < first + count; i++)
+    {
+      if (scratch.Points.empty() || pb.Points[i] != scratch.Points.back())
+      {
+        scratch.Points.push_back(pb.Points[i]);
+        scratch.Source.push_back(i);
+      }
+    }
+    closed = closed && scratch.Points.size() > 2;
+    if (closed)
+    {
+      if (scratch.Points.back() == scratch.Points.front())
+      {
+        scratch.Points.pop_back();
+        scratch.Source.pop_back();
+      }
+      scratch.Points.push_back(scratch.Points.front());
+      scratch.Source.push_back(scratch.Source.front());
+    }
+    if (scratch.Points.size() < 2)
+    {
+      return 0;
+    }
+
+    const size_t segmentCount = scratch.Points.size() - 1;
+    scratch.DirX.resize(segmentCount);
+    scratch.DirY.resize(segmentCount);
+    scratch.Length.resize(segmentCount);
+    StrokeComputeSegments(scratch.Points.data(), segmentCount, scratch.DirX.data(), scratch.DirY.data(), scratch.Length.data());
+    return segmentCount;
+  }
+
+  static unsigned int StrokeVertex(const glm::vec2 &position)
+  {
+    const unsigned int index = srGetCurrentVertexIndex();
+    srVertex2f(position);
+    return index;
+  }
+
+  static void StrokeTriangle(unsigned int a, unsigned int b, unsigned int c)
+  {
+    srIndex1ui(a);
+    srIndex1ui(b);
+    srIndex1ui(c);
+  }
+
+  // Every vertex of a join shares the distance of its point
+  static void StrokeSetDistance(const StrokeParams &params, float distance)
+  {
+    if (params.Dashed)
+    {
+      srNormal3f(params.Style.DashLength, params.Style.DashGap, params.Gradient);
+      srTextureCoord2f(distance + params.Style.DashOffset, 0.0f);
+    }
+    else
+    {
+      srNormal3f(0.0f, 0.0f, params.Gradient);
+    }
+  }
+
+  static StrokePoint StrokeEmit(const StrokeParams &params, const glm::vec2 &center, const glm::vec2 &offset, float distance, bool transparent = false)
+  {
+    StrokePoint point;
+    point.Center = center;
+    point.Offset = offset;
+    point.Distance = distance;
+    StrokeSetDistance(params, distance);
+
+    srColor11c(transparent ? params.FringeColor : params.SolidColor);
+    point.Solid = StrokeVertex(center + offset * params.Solid);
+    point.Fringe = point.Solid;
+    if (params.AntiAlias)
+    {
+      srColor11c(params.FringeColor);
+      point.Fringe = StrokeVertex(center + offset * params.Fringe);
+    }
+    return point;
+  }
+
+  // Fringe between two neighbouring outline points
+  static void StrokeFringe(const StrokeParams &params, const StrokePoint &a, const StrokePoint &b)
+  {
+    if (!params.AntiAlias)
+    {
+      return;
     }
+    std::vector<unsigned int> &fringe = sStrokeScratch.FringeIndices;
+    fringe.insert(fringe.end(), {a.Fringe, a.Solid, b.Solid, b.Solid, b.Fringe, a.Fringe});
+  }
+
+  static void StrokeFlushFringe()
+  {
+    std::vector<unsigned int> &fringe = sStrokeScratch.FringeIndices;
+    for (unsigned int index : fringe)
+    {
+      srIndex1ui(index);
+    }
+    fringe.clear();
+  }
+
+  // Makes room for the next section. The last edge gets emitted again when the batch was flushed
+  static void StrokeReserve(StrokeEdge &edge, const StrokeParams &params, unsigned int numVerts, unsigned int numIndices)
+  {
+    if (params.AntiAlias)
+    {
+      numVerts *= 2;
+      numIndices *= 3;
+    }
+    const RenderBatch &rb = RecordingBatch();
+    const unsigned int pending = sStrokeScratch.FringeIndices.size();
+    if (rb.VertexCounter + numVerts + 4 < rb.DrawBuffer.ElementCount && rb.IndexCounter + numIndices + pending <= rb.DrawBuffer.IndexCapacity)
+    {
+      return;
+    }
+
+    // The pending fringe still references vertices of this batch
+    StrokeFlushFringe();
+    if (srCheckRenderBatchLimit(numVerts + 4, numIndices))
+    {
+      edge.Plus = StrokeEmit(params, edge.Plus.Center, edge.Plus.Offset, edge.Plus.Distance);
+      edge.Minus = StrokeEmit(params, edge.Minus.Center, edge.Minus.Offset, edge.Minus.Distance);
+    }
+  }
+
+  // Quad from the last edge to the given one
+  static void StrokeSection(StrokeEdge &edge, const StrokeParams &params, const StrokePoint &plus, const StrokePoint &minus)
+  {
+    StrokeTriangle(edge.Plus.Solid, edge.Minus.Solid, minus.Solid);
+    StrokeTriangle(minus.Solid, plus.Solid, edge.Plus.Solid);
+    StrokeFringe(params, edge.Plus, plus);
+    StrokeFringe(params, edge.Minus, minus);
+    edge.Plus = plus;
+    edge.Minus = minus;
+  }
+
+  // Ends the incoming section at a join. A closed subpath starts at a join, there the end is kept for the last section
+  static void StrokeEndSection(StrokeEdge &edge, const StrokeParams &params, StrokeEdge *open, const StrokePoint &plus, const StrokePoint &minus)
+  {
+    if (open)
+    {
+      *open = {plus, minus};
+      edge = *open;
+      return;
+    }
+    StrokeSection(edge, params, plus, minus);
+  }
+
+  static glm::vec2 StrokeRotate(const glm::vec2 &v, float cosAngle, float sinAngle)
+  {
+    return glm::vec2(v.x * cosAngle - v.y * sinAngle, v.x * sinAngle + v.y * cosAngle);
+  }
+
+  // Half circle around center, from the plus to the minus side of the edge. Positive directions turn towards the stroke direction
+  static void StrokeRoundCap(StrokeEdge &edge, const StrokeParams &params, const glm::vec2 &center, float distance, float direction)
+  {
+    const unsigned int steps = srMax(PathArcSegmentCount(params.Fringe, (float)PI), 2u);
+    const float step = direction * (float)PI / steps;
+    const float cosStep = cosf(step);
+    const float sinStep = sinf(step);
+
+    StrokeReserve(edge, params, steps + 1, steps * 3);
+    srColor11c(params.SolidColor);
+    StrokeSetDistance(params, distance);
+    const unsigned int centerIndex = StrokeVertex(center);
+    StrokePoint previous = edge.Plus;
+    glm::vec2 offset = edge.Plus.Offset;
+    const glm::vec2 along(-offset.y, offset.x);
+    for (unsigned int i = 1; i < steps; i++)
+    {
+      offset = StrokeRotate(offset, cosStep, sinStep);
+      const StrokePoint next = StrokeEmit(params, center, offset, distance + glm::dot(offset, along) * params.Solid);
+      StrokeTriangle(centerIndex, previous.Solid, next.Solid);
+      StrokeFringe(params, previous, next);
+      previous = next;
+    }
+    StrokeTriangle(centerIndex, previous.Solid, edge.Minus.Solid);
+    StrokeFringe(params, previous, edge.Minus);
+  }
+
+  // Starts a subpath. With anti aliasing butt and square ends are pulled in by half a pixel and fade out over a pixel
+  static void StrokeStartCap(StrokeEdge &edge, const StrokeParams &params, const glm::vec2 &point, const glm::vec2 &direction)
+  {
+    const glm::vec2 normal(direction.y, -direction.x);
+    if (params.Style.LineCap == LineCap_Round)
+    {
+      srCheckRenderBatchLimit(4);
+      edge = {StrokeEmit(params, point, normal, 0.0f), StrokeEmit(params, point, -normal, 0.0f)};
+      StrokeRoundCap(edge, params, point, 0.0f, -1.0f);
+      return;
+    }
+
+    const float extend = (params.Style.LineCap == LineCap_Square ? params.Style.StrokeWidth * 0.5f : 0.0f) - params.FringeWidth * 0.5f;
+    const glm::vec2 center = point - direction * extend;
+    srCheckRenderBatchLimit(8, 6);
+    if (params.AntiAlias)
+    {
+      const glm::vec2 fade = center - direction * params.FringeWidth;
+      const float fadeDistance = -extend - params.FringeWidth;
+      edge = {StrokeEmit(params, fade, normal, fadeDistance, true), StrokeEmit(params, fade, -normal, fadeDistance, true)};
+      StrokeSection(edge, params, StrokeEmit(params, center, normal, -extend), StrokeEmit(params, center, -normal, -extend));
+      return;
+    }
+    edge = {StrokeEmit(params, center, normal, -extend), StrokeEmit(params, center, -normal, -extend)};
+  }
+
+  static void StrokeEndCap(StrokeEdge &edge, const StrokeParams &params, const glm::vec2 &point, const glm::vec2 &direction, float distance)
+  {
+    const glm::vec2 normal(direction.y, -direction.x);
+    if (params.Style.LineCap == LineCap_Round)
+    {
+      StrokeReserve(edge, params, 2, 6);
+      StrokeSection(edge, params, StrokeEmit(params, point, normal, distance), StrokeEmit(params, point, -normal, distance));
+      StrokeRoundCap(edge, params, point, distance, 1.0f);
+      return;
+    }
+
+    const float extend = (params.Style.LineCap == LineCap_Square ? params.Style.StrokeWidth * 0.5f : 0.0f) - params.FringeWidth * 0.5f;
+    const glm::vec2 center = point + direction * extend;
+    StrokeReserve(edge, params, 4, 12);
+    StrokeSection(edge, params, StrokeEmit(params, center, normal, distance + extend), StrokeEmit(params, center, -normal, distance + extend));
+    if (params.AntiAlias)
+    {
+      const glm::vec2 fade = center + direction * params.FringeWidth;
+      const float fadeDistance = distance + extend + params.FringeWidth;
+      StrokeSection(edge, params, StrokeEmit(params, fade, normal, fadeDistance, true), StrokeEmit(params, fade, -normal, fadeDistance, true));
+    }
+  }
+
+  // Corner at point between the segments with the directions d0 and d1. Ends the incoming section and starts the outgoing one
+  static void StrokeJoin(StrokeEdge &edge, const StrokeParams &params, const glm::vec2 &point, float distance, const glm::vec2 &d0, const glm::vec2 &d1, float len0, float len1, StrokeEdge *open = NULL)
+  {
+    const PathStyle &style = params.Style;
+    const glm::vec2 n0(d0.y, -d0.x);
+    const glm::vec2 n1(d1.y, -d1.x);
+    const float dot = d0.x * d1.x + d0.y * d1.y;
+    const float cross = d0.x * d1.y - d0.y * d1.x;
+
+    // Miter offset per unit of width is (n0 + n1) / (1 + cos(angle)). It reaches tan(angle / 2) along the segments
+    const float denom = 1.0f + dot;
+    const bool hasMiter = denom > 1e-6f;
+    const glm::vec2 miter = hasMiter ? (n0 + n1) / denom : n0;
+    const bool innerFits = hasMiter && params.Fringe * srAbs(cross) <= denom * srMin(len0, len1);
+    const bool miterFits = hasMiter && 2.0f <= style.MiterLimit * style.MiterLimit * denom;
+
+    // Bevels and round joins look like a miter, while the miter tip is within the tolerance of the bevel
+    const bool miterInTolerance = hasMiter && params.Fringe * (sqrtf(2.0f / denom) - sqrtf(denom * 0.5f)) <= PathToleranceWorld();
+    if (innerFits && (miterInTolerance || (style.LineJoin == LineJoin_Miter && miterFits)))
+    {
+      StrokeReserve(edge, params, 2, 6);
+      const StrokePoint plus = StrokeEmit(params, point, miter, distance);
+      const StrokePoint minus = StrokeEmit(params, point, -miter, distance);
+      StrokeEndSection(edge, params, open, plus, minus);
+      return;
+    }
+
+    // Outer side of the corner, relative to the normals
+    const float side = cross > 0.0f ? 1.0f : -1.0f;
+    const glm::vec2 outer0 = n0 * side;
+    const glm::vec2 outer1 = n1 * side;
+    const glm::vec2 inner0 = innerFits ? -miter * side : -n0 * side;
+    const glm::vec2 inner1 = innerFits ? inner0 : -n1 * side;
+
+    unsigned int roundSteps = 0;
+    if (style.LineJoin == LineJoin_Round)
+    {
+      roundSteps = PathArcSegmentCount(params.Fringe, atan2f(srAbs(cross), dot));
+    }
+    const unsigned int outerPoints = style.LineJoin == LineJoin_Round ? roundSteps - 1 : (style.LineJoin == LineJoin_Miter && miterFits ? 1 : 0);
+
+    StrokeReserve(edge, params, 5 + outerPoints, 6 + 3 * (outerPoints + 1));
+
+    const StrokePoint innerPoint0 = StrokeEmit(params, point, inner0, distance);
+    const StrokePoint outerPoint0 = StrokeEmit(params, point, outer0, distance);
+    if (side > 0.0f)
+    {
+      StrokeEndSection(edge, params, open, outerPoint0, innerPoint0);
+    }
+    else
+    {
+      StrokeEndSection(edge, params, open, innerPoint0, outerPoint0);
+    }
+
+    // Without a shared inner corner both sections end at the point itself
+    unsigned int pivot = innerPoint0.Solid;
+    if (!innerFits)
+    {
+      srColor11c(params.SolidColor);
+      StrokeSetDistance(params, distance);
+      pivot = StrokeVertex(point);
+    }
+    StrokePoint previous = outerPoint0;
+    if (style.LineJoin == LineJoin_Round)
+    {
+      // Turn from outer0 to outer1 around the outside. A reversal has no turn direction and goes around the tip
+      const float step = side * atan2f(srAbs(cross), dot) / roundSteps;
+      const float cosStep = cosf(step);
+      const float sinStep = sinf(step);
+      glm::vec2 offset = outer0;
+      for (unsigned int i = 0; i < outerPoints; i++)
+      {
+        offset = StrokeRotate(offset, cosStep, sinStep);
+        const StrokePoint next = StrokeEmit(params, point, offset, distance);
+        StrokeTriangle(pivot, previous.Solid, next.Solid);
+        StrokeFringe(params, previous, next);
+        previous = next;
+      }
+    }
+    else if (outerPoints > 0)
+    {
+      const StrokePoint miterPoint = StrokeEmit(params, point, miter * side, distance);
+      StrokeTriangle(pivot, previous.Solid, miterPoint.Solid);
+      StrokeFringe(params, previous, miterPoint);
+      previous = miterPoint;
+    }
+    const StrokePoint outerPoint1 = StrokeEmit(params, point, outer1, distance);
+    StrokeTriangle(pivot, previous.Solid, outerPoint1.Solid);
+    StrokeFringe(params, previous, outerPoint1);
+
+    const StrokePoint innerPoint1 = innerFits ? innerPoint0 : StrokeEmit(params, point, inner1, distance);
+    if (side > 0.0f)
+    {
+      edge = {outerPoint1, innerPoint1};
+    }
+    else
+    {
+      edge = {innerPoint1, outerPoint1};
+    }
+  }
+
+  // Flushing path
+  // One SEGMENTS vertex per segment. Neighbouring segments meet in their round caps, the ends of open subpaths get
+  // the cap of the style
+  static void StrokeInstanced(const PathBuilder &pb, bool closedPath)
+  {
+    PathStyle style = pb.Styles.size() > 0 ? pb.Styles[0].second : pb.CurrentPathStyle;
+    unsigned int nextStyleChange = pb.Styles.size() > 0 ? pb.Styles[0].first : 0;
+    unsigned int styleIndex = 0;
+
+    srBegin(SEGMENTS);
+    const StrokeScratch &scratch = sStrokeScratch;
+    for (unsigned int subpath = 0; subpath < PathSubpathCount(pb); subpath++)
+    {
+      unsigned int first = 0;
+      unsigned int count = 0;
+      PathGetSubpath(pb, subpath, &first, &count);
+
+      bool closed = closedPath;
+      const size_t segmentCount = StrokeLoadSubpath(pb, first, count, closed);
+      for (size_t i = 0; i < segmentCount; i++)
+      {
+        while (styleIndex + 1 < pb.Styles.size() && nextStyleChange <= scratch.Source[i])
+        {
+          styleIndex++;
+          style = pb.Styles[styleIndex].second;
+          nextStyleChange += pb.Styles[styleIndex].first;
+        }
+
+        const LineCap_ startCap = i == 0 && !closed ? style.LineCap : LineCap_Round;
+        const LineCap_ endCap = i + 1 == segmentCount && !closed ? style.LineCap : LineCap_Round;
+        SegmentEmit(scratch.Points[i], scratch.Points[i + 1], style.StrokeWidth, style.StrokeColor, startCap, endCap);
+      }
+    }
+    srEnd();
+  }
+
+  R_API void srAddPolyline(const PathBuilder &pb, bool closedPath)
+  {
+    PathStyle currentStyle = pb.CurrentPathStyle;
+    unsigned int nextStyleChange = 0;
+    unsigned int currentStyleIndex = 0;
+    if (pb.Styles.size() > 0)
+    {
+      currentStyle = pb.Styles[0].second;
+      nextStyleChange = pb.Styles[0].first;
+    }
+    bool dashed = currentStyle.DashLength > 0.0f && currentStyle.DashGap > 0.0f;
+    bool gradient = currentStyle.StrokeGradient != 0;
+    for (const PathBuilder::PathStyleIndex &style : pb.Styles)
+    {
+      dashed = dashed || (style.second.DashLength > 0.0f && style.second.DashGap > 0.0f);
+      gradient = gradient || style.second.StrokeGradient != 0;
+    }
+    if (pb.StrokeMode == PathStrokeMode_Instanced && !dashed && !gradient)
+    {
+      StrokeInstanced(pb, closedPath);
+      return;
+    }
+    StrokeParams params = StrokeGetParams(currentStyle, currentStyle.StrokeWidth, dashed);
+
+    Material material{};
+    if (gradient)
+    {
+      material.ShaderProgram = SRC->GradientShader;
+    }
+    else if (dashed)
+    {
+      material.ShaderProgram = SRC->DashShader;
+    }
+    srBegin(TRIANGLES_INDEXED, material);
 
-    const float degIncrease = angle_range / segmentCount;
+    StrokeScratch &scratch = sStrokeScratch;
+    for (unsigned int subpath = 0; subpath < PathSubpathCount(pb); subpath++)
+    {
+      unsigned int first = 0;
+      unsigned int count = 0;
+      PathGetSubpath(pb, subpath, &first, &count);
+
+      // Repeated points have no direction
+      bool closed = closedPath;
+      const size_t segmentCount = StrokeLoadSubpath(pb, first, count, closed);
+      if (segmentCount == 0)
+      {
+        continue;
+      }
+      const glm::vec2 *points = scratch.Points.data();
+      auto direction = [&scratch](size_t segment)
+      { return glm::vec2(scratch.DirX[segment], scratch.DirY[segment]); };
 
-    float currentAngle = start_angle + degIncrease;
+      StrokeEdge edge{};
+      StrokeEdge closing{};
+      if (closed)
+      {
+        // The join at the first point starts the stroke. Its incoming side is where the last segment ends
+        const size_t last = segmentCount - 1;
+        StrokeJoin(edge, params, points[0], 0.0f, direction(last), direction(0), scratch.Length[last], scratch.Length[0], &closing);
+      }
+      else
+      {
+        StrokeStartCap(edge, params, points[0], direction(0));
+      }
 
-    float rot_angle_sin = sinf(angle);
-    float rot_angle_cos = cosf(angle);
+      float distance = 0.0f;
+      for (size_t i = 1; i < segmentCount; i++)
+      {
+        distance += scratch.Length[i - 1];
+        StrokeJoin(edge, params, points[i], distance, direction(i - 1), direction(i), scratch.Length[i - 1], scratch.Length[i]);
 
-    for (unsigned int i = 0; i < segmentCount; i++)
-    {
-      glm::vec2 currentPosition = cp_rotation_matrix * glm::vec2(radius_x * cosf(currentAngle), radius_y * sinf(currentAngle));
+        bool styleChanged = false;
+        while (currentStyleIndex + 1 < pb.Styles.size() && nextStyleChange <= scratch.Source[i])
+        {
+          currentStyleIndex++;
+          currentStyle = pb.Styles[currentStyleIndex].second;
+          nextStyleChange += pb.Styles[currentStyleIndex].first;
+          styleChanged = true;
+        }
+        if (styleChanged)
+        {
+          params = StrokeGetParams(currentStyle, currentStyle.StrokeWidth, dashed);
+        }
+      }
 
-      srPathLineTo(center_point + currentPosition);
-      currentAngle += degIncrease;
+      distance += scratch.Length[segmentCount - 1];
+      if (closed)
+      {
+        StrokeReserve(edge, params, 2, 6);
+        StrokeSection(edge, params, StrokeEmit(params, closing.Plus.Center, closing.Plus.Offset, distance), StrokeEmit(params, closing.Minus.Center, closing.Minus.Offset, distance));
+      }
+      else
+      {
+        StrokeEndCap(edge, params, points[segmentCount], direction(segmentCount - 1), distance);
+      }
+      StrokeFlushFringe();
     }
+    srEnd();
   }
 
-  R_API void srPathCubicBezierTo(const glm::vec2 &controll1, const glm::vec2 &controll2, const glm::vec2 &endPosition, unsigned int segmentCount)
-  {
-    assert(SRC->MainRenderBatch.Path.Points.size() > 0);
-    glm::vec2 start_point = SRC->MainRenderBatch.Path.Points.back();
-
-    for (unsigned int i = 1; i <= segmentCount; i++)
+  // Fill tessellation
+  //
+  // Sweep line over all subpath edges from top to bottom. The active edges are kept ordered by x in a tree, and an
+  // event (a vertex or an edge intersection) only touches the edges that start, end or cross there. The tree orders
+  // slots that hold an edge each, so where a subpath goes on downwards the next edge takes over the slot of the
+  // ending one without a tree update. Edges are tested for a crossing when they become neighbours, since the first
+  // crossing below the sweep line is always between neighbours. Every active edge keeps the winding right of it, so
+  // after an event the fill rule only runs from the changed edges to the first edge whose winding stays the same.
+  // A span between two edges stays open for as long as the same two edges bound it. It is emitted as one
+  // trapezoid when it ends, so the output stays close to the monotone pieces of the polygon.
+
+  struct FillTessellator;
+
+  // Orders the slots of the active edges by x on the sweep line. Coincident edges are ordered by where they go
+  struct FillEdgeOrder
+  {
+    const FillTessellator *Tess;
+    bool operator()(unsigned int a, unsigned int b) const;
+  };
+
+  struct FillEdge
+  {
+    glm::vec2 Top;
+    glm::vec2 Bottom;
+    float Slope; // dx / dy
+    int Winding;
+    int WindingRight;   // Of the region right of the edge, while it is active
+    int Slot;           // -1 when the edge is not active
+    unsigned int Stamp; // Event the edge got its slot at
+
+    // Open span with this edge as left border
+    int OpenRight;
+    float OpenTop;
+
+    float X(float y) const { return Top.x + (y - Top.y) * Slope; }
+  };
+
+  struct FillCrossing
+  {
+    float Y;
+    unsigned int Left;
+    unsigned int Right;
+  };
+
+  struct FillTessellator
+  {
+    using ActiveSet = std::set<unsigned int, FillEdgeOrder>;
+
+    std::vector<FillEdge> Edges;         // Sorted by top
+    std::vector<unsigned int> Ends;      // Edge indices sorted by bottom
+    std::vector<FillCrossing> Crossings; // Heap, the nearest on top
+    ActiveSet Active{FillEdgeOrder{this}};
+    std::vector<unsigned int> SlotEdges;         // Edge in each slot
+    std::vector<ActiveSet::iterator> Nodes;      // Of each slot. Active.end() when the slot is free
+    std::vector<ActiveSet::node_type> FreeNodes; // Free slots, reused with their nodes so the sweep does not allocate
+    std::vector<unsigned int> Crossed;
+    std::vector<unsigned int> Starting;
+    std::vector<int> Seeds; // Slots the fill rule runs from after an event. -1 for the first slot
+    float SweepY = 0.0f;
+  };
+
+  bool FillEdgeOrder::operator()(unsigned int a, unsigned int b) const
+  {
+    const unsigned int edgeA = Tess->SlotEdges[a];
+    const unsigned int edgeB = Tess->SlotEdges[b];
+    const FillEdge &ea = Tess->Edges[edgeA];
+    const FillEdge &eb = Tess->Edges[edgeB];
+    const float xa = ea.X(Tess->SweepY);
+    const float xb = eb.X(Tess->SweepY);
+    const float epsilonX = 1e-5f * (1.0f + srMax(srAbs(xa), srAbs(xb)));
+    if (srAbs(xa - xb) > epsilonX)
     {
-      float t = (float)i / (float)segmentCount;
-      float u = 1.0f - t;
-      float tt = t * t;
-      float uu = u * u;
-      float uuu = uu * u;
-      float ttt = tt * t;
-
-      glm::vec2 p = uuu * start_point;
-      p += 3 * uu * t * controll1;
-      p += 3 * u * tt * controll2;
-      p += ttt * endPosition;
-
-      srPathLineTo(p);
+      return xa < xb;
     }
+    if (ea.Slope != eb.Slope)
+    {
+      return ea.Slope < eb.Slope;
+    }
+    return edgeA < edgeB;
   }
 
-  R_API void srPathQuadraticBezierTo(const glm::vec2 &controll, const glm::vec2 &endPosition, unsigned int segmentCount)
-  {
-    assert(SRC->MainRenderBatch.Path.Points.size() > 0);
-    glm::vec2 start_point = SRC->MainRenderBatch.Path.Points.back();
+  static thread_local FillTessellator sFillTessellator;
 
-    for (unsigned int i = 1; i <= segmentCount; i++)
+  static void FillEmitTrapezoid(const FillEdge &left, const FillEdge &right, float top, float bottom)
+  {
+    if (bottom <= top)
     {
-      float t = (float)i / (float)segmentCount;
-      float u = 1.0f - t;
-      float tt = t * t;
-      float uu = u * u;
-
-      glm::vec2 p = uu * start_point;
-      p += 2 * u * t * controll;
-      p += tt * endPosition;
-
-      srPathLineTo(p);
+      return;
     }
-  }
+    srCheckRenderBatchLimit(4, 6);
+    const unsigned int first = srGetCurrentVertexIndex();
+    srVertex2f(left.X(top), top);
+    srVertex2f(right.X(top), top);
+    srVertex2f(right.X(bottom), bottom);
+    srVertex2f(left.X(bottom), bottom);
 
-  R_API void srPathSetStrokeEnabled(bool showStroke)
-  {
-    if (showStroke)
-      SRC->MainRenderBatch.Path.RenderType |= PathType_Stroke;
-    else
-      SRC->MainRenderBatch.Path.RenderType &= ~PathType_Stroke;
+    srIndex1ui(first);
+    srIndex1ui(first + 1);
+    srIndex1ui(first + 2);
+    srIndex1ui(first);
+    srIndex1ui(first + 2);
+    srIndex1ui(first + 3);
   }
 
-  R_API void srPathSetFillEnabled(bool fill)
+  static bool FillIsInside(int winding, FillRule_ rule)
   {
-    if (fill)
-      SRC->MainRenderBatch.Path.RenderType |= PathType_Fill;
-    else
-      SRC->MainRenderBatch.Path.RenderType &= ~PathType_Fill;
+    return rule == FillRule_EvenOdd ? (winding & 1) != 0 : winding != 0;
   }
 
-  R_API void srPathSetFillColor(Color color)
+  static bool FillCrossingLater(const FillCrossing &a, const FillCrossing &b)
   {
-    PathBuilder::PathStyleIndex &styleIndex = srPathBuilderNewStyle();
-    styleIndex.second.FillColor = color;
-    SRC->MainRenderBatch.Path.CurrentPathStyle.FillColor = color;
+    return a.Y > b.Y;
   }
 
-  R_API void srPathSetFillColor(const glm::vec4 &color)
+  // Ends the open span of the edge at the sweep line when its right border changes or it is no longer inside.
+  // right is -1 when the edge is the last one or leaves
+  static void FillUpdateSpan(FillTessellator &tess, unsigned int edgeIndex, int right, FillRule_ rule)
   {
-    srPathSetFillColor(srGetColorFromFloat(color));
+    FillEdge &edge = tess.Edges[edgeIndex];
+    if (right >= 0 && !FillIsInside(edge.WindingRight, rule))
+    {
+      right = -1;
+    }
+    if (edge.OpenRight == right)
+    {
+      return;
+    }
+    if (edge.OpenRight >= 0)
+    {
+      FillEmitTrapezoid(edge, tess.Edges[edge.OpenRight], edge.OpenTop, tess.SweepY);
+    }
+    edge.OpenRight = right;
+    edge.OpenTop = tess.SweepY;
   }
 
-  R_API void srPathSetStrokeColor(Color color)
+  // Queues where two neighbours cross, when that is before one of them ends
+  static void FillQueueCrossing(FillTessellator &tess, unsigned int left, unsigned int right)
   {
-    PathBuilder::PathStyleIndex &styleIndex = srPathBuilderNewStyle();
-    styleIndex.second.StrokeColor = color;
-    SRC->MainRenderBatch.Path.CurrentPathStyle.StrokeColor = color;
-  }
+    const FillEdge &a = tess.Edges[left];
+    const FillEdge &b = tess.Edges[right];
+    const float y0 = tess.SweepY;
+    const float y1 = srMin(a.Bottom.y, b.Bottom.y);
+    if (a.Slope <= b.Slope || a.X(y1) <= b.X(y1))
+    {
+      return;
+    }
 
-  R_API void srPathSetStrokeColor(const glm::vec4 &color)
-  {
-    srPathSetStrokeColor(srGetColorFromFloat(color));
+    // Edges that are out of order by a rounding error are swapped just below the sweep line, so it keeps moving
+    const float epsilonY = 1e-5f * (1.0f + srAbs(y0));
+    const float crossY = srMax(y0 + (b.X(y0) - a.X(y0)) / (a.Slope - b.Slope), y0 + epsilonY);
+    if (crossY < y1)
+    {
+      tess.Crossings.push_back({crossY, left, right});
+      std::push_heap(tess.Crossings.begin(), tess.Crossings.end(), FillCrossingLater);
+    }
   }
 
-  R_API void srPathSetStrokeWidth(float width)
+  // The slot left of the changed one has a new right neighbour, the fill rule runs from there
+  static void FillAddSeed(FillTessellator &tess, unsigned int slot)
   {
-    PathBuilder::PathStyleIndex &styleIndex = srPathBuilderNewStyle();
-    styleIndex.second.StrokeWidth = width;
-    SRC->MainRenderBatch.Path.CurrentPathStyle.StrokeWidth = width;
+    const FillTessellator::ActiveSet::iterator node = tess.Nodes[slot];
+    tess.Seeds.push_back(node == tess.Active.begin() ? (int)slot : (int)*std::prev(node));
   }
 
-  R_API void srPathSetStyle(const PathStyle &style)
+  static void FillRemoveEdge(FillTessellator &tess, unsigned int edgeIndex, FillRule_ rule)
   {
-    PathBuilder::PathStyleIndex &styleIndex = srPathBuilderNewStyle();
-    styleIndex.second = style;
-    SRC->MainRenderBatch.Path.CurrentPathStyle = style;
+    FillEdge &edge = tess.Edges[edgeIndex];
+    FillTessellator::ActiveSet::iterator &node = tess.Nodes[edge.Slot];
+    FillUpdateSpan(tess, edgeIndex, -1, rule);
+    tess.Seeds.push_back(node == tess.Active.begin() ? -1 : (int)*std::prev(node));
+    tess.FreeNodes.push_back(tess.Active.extract(node));
+    node = tess.Active.end();
+    edge.Slot = -1;
   }
 
-  R_API PathBuilder::PathStyleIndex &srPathBuilderNewStyle()
+  static void FillInsertEdge(FillTessellator &tess, unsigned int edgeIndex, unsigned int stamp)
   {
-    PathBuilder &pb = SRC->MainRenderBatch.Path;
-
-    if (pb.Styles.size() == 0)
+    unsigned int slot;
+    if (tess.FreeNodes.empty())
     {
-      PathBuilder::PathStyleIndex newStyleIndex;
-      newStyleIndex.first = pb.Points.size();
-      newStyleIndex.second = pb.CurrentPathStyle;
-      pb.Styles.push_back(newStyleIndex);
-      pb.PreviousStyleVertexIndex = 0;
-      return pb.Styles.back();
+      slot = (unsigned int)tess.SlotEdges.size();
+      tess.SlotEdges.push_back(edgeIndex);
+      tess.Nodes.push_back(tess.Active.insert(slot).first);
     }
-
-    PathBuilder::PathStyleIndex &lastStyle = pb.Styles.back();
-
-    // We have no new points, we can just modify the current one
-    if (pb.Points.size() - (pb.PreviousStyleVertexIndex + lastStyle.first) == 0)
+    else
     {
-      return lastStyle;
+      slot = tess.FreeNodes.back().value();
+      tess.SlotEdges[slot] = edgeIndex;
+      tess.Nodes[slot] = tess.Active.insert(std::move(tess.FreeNodes.back())).position;
+      tess.FreeNodes.pop_back();
+    }
+    FillEdge &edge = tess.Edges[edgeIndex];
+    edge.Slot = (int)slot;
+    edge.Stamp = stamp;
+    FillAddSeed(tess, slot);
+  }
+
+  // The next edge of a subpath takes over the slot of the edge ending where it starts, if that keeps the slots in
+  // order. An edge can end past its neighbours when it is almost horizontal
+  static bool FillContinueEdge(FillTessellator &tess, unsigned int ending, unsigned int starting, FillRule_ rule)
+  {
+    const unsigned int slot = (unsigned int)tess.Edges[ending].Slot;
+    const FillTessellator::ActiveSet::iterator node = tess.Nodes[slot];
+    const FillTessellator::ActiveSet::iterator next = std::next(node);
+    const FillEdgeOrder order = tess.Active.key_comp();
+    tess.SlotEdges[slot] = starting;
+    if ((node != tess.Active.begin() && !order(*std::prev(node), slot)) || (next != tess.Active.end() && !order(slot, *next)))
+    {
+      tess.SlotEdges[slot] = ending;
+      return false;
     }
 
-    lastStyle.first = pb.Points.size() - pb.PreviousStyleVertexIndex;
-    pb.PreviousStyleVertexIndex += lastStyle.first;
-
-    // Create new style index
-    PathBuilder::PathStyleIndex newStyleIndex;
-    PathStyle newStyle = lastStyle.second;
-
-    pb.Styles.push_back(newStyleIndex);
-    return pb.Styles.back();
+    // The winding does not change, only the spans next to the slot and the neighbours it can cross
+    FillUpdateSpan(tess, ending, -1, rule);
+    tess.Edges[ending].Slot = -1;
+    FillEdge &edge = tess.Edges[starting];
+    edge.Slot = (int)slot;
+    edge.WindingRight = tess.Edges[ending].WindingRight;
+    if (node != tess.Active.begin())
+    {
+      const unsigned int left = tess.SlotEdges[*std::prev(node)];
+      FillUpdateSpan(tess, left, (int)starting, rule);
+      FillQueueCrossing(tess, left, starting);
+    }
+    const int right = next != tess.Active.end() ? (int)tess.SlotEdges[*next] : -1;
+    FillUpdateSpan(tess, starting, right, rule);
+    if (right >= 0)
+    {
+      FillQueueCrossing(tess, starting, right);
+    }
+    return true;
   }
 
-  // Flushing path
-  R_API void srAddPolyline(const PathBuilder &pb, bool closedPath)
+  static void FillTessellate(const PathBuilder &pb)
   {
-    const size_t count = pb.Points.size();
-    srCheckRenderBatchLimit(count * 4);
+    FillTessellator &tess = sFillTessellator;
+    tess.Edges.clear();
+    tess.Ends.clear();
+    tess.Crossings.clear();
 
-    PathStyle currentStyle = pb.CurrentPathStyle;
-    unsigned int nextStyleChange = 0;
-    unsigned int currentStyleIndex = 0;
-    if (pb.Styles.size() > 0)
+    // Collect edges of all (implicitly closed) subpaths. Horizontal edges do not change the winding
+    for (unsigned int subpath = 0; subpath < PathSubpathCount(pb); subpath++)
     {
-      currentStyle = pb.Styles[0].second;
-      nextStyleChange = pb.Styles[0].first;
-    }
-
-    srBegin(TRIANGLES);
-    srColor11c(currentStyle.StrokeColor);
-
-    glm::vec2 lastTop{};
-    glm::vec2 lastBottom{};
-
-    closedPath = closedPath && pb.Points[0] != pb.Points.back();
+      unsigned int first = 0;
+      unsigned int count = 0;
+      PathGetSubpath(pb, subpath, &first, &count);
+      for (unsigned int i = 0; i < count && count > 2; i++)
+      {
+        const glm::vec2 &a = pb.Points[first + i];
+        const glm::vec2 &b = pb.Points[first + (i + 1) % count];
+        if (a.y == b.y)
+        {
+          continue;
+        }
 
-    for (size_t i1 = 0; i1 < count + (closedPath ? 1 : 0); i1++)
+        FillEdge edge;
+        edge.Top = a.y < b.y ? a : b;
+        edge.Bottom = a.y < b.y ? b : a;
+        edge.Slope = (b.x - a.x) / (b.y - a.y);
+        edge.Winding = a.y < b.y ? 1 : -1;
+        edge.WindingRight = 0;
+        edge.Slot = -1;
+        edge.Stamp = 0;
+        edge.OpenRight = -1;
+        edge.OpenTop = 0.0f;
+        tess.Edges.push_back(edge);
+      }
+    }
+    if (tess.Edges.size() < 2)
     {
-      const glm::vec2 &currentPoint = pb.Points[i1 % count];
-      const glm::vec2 &previousPoint = pb.Points[i1 == 0 ? (closedPath ? pb.Points.size() - 1 : 0) : (i1 - 1)];
-      const glm::vec2 &nextPoint = pb.Points[(i1 + 1) % count];
-
-      const float prevLength = glm::length(currentPoint - previousPoint);
-      const float nextLength = glm::length(nextPoint - currentPoint);
-
-      const glm::vec2 dir1 = glm::normalize(currentPoint - previousPoint);
-      const glm::vec2 dir2 = glm::normalize(nextPoint - currentPoint);
+      return;
+    }
 
-      // 90° dir vector
-      const glm::vec2 normalWidthVector1 = glm::normalize(glm::vec2(dir1.y, -dir1.x));
-      const glm::vec2 normalWidthVector2 = glm::normalize(glm::vec2(dir2.y, -dir2.x));
+    // Edges starting and ending at the same height are sorted by x, so the ones meeting at a vertex can be paired
+    std::sort(tess.Edges.begin(), tess.Edges.end(), [](const FillEdge &a, const FillEdge &b)
+              { return a.Top.y < b.Top.y || (a.Top.y == b.Top.y && a.Top.x < b.Top.x); });
+    for (unsigned int i = 0; i < tess.Edges.size(); i++)
+    {
+      tess.Ends.push_back(i);
+    }
+    std::sort(tess.Ends.begin(), tess.Ends.end(), [&tess](unsigned int a, unsigned int b)
+              {
+                const glm::vec2 &ea = tess.Edges[a].Bottom;
+                const glm::vec2 &eb = tess.Edges[b].Bottom;
+                return ea.y < eb.y || (ea.y == eb.y && ea.x < eb.x); });
+
+    const FillRule_ rule = pb.FillRule;
+    size_t nextEdge = 0;
+    size_t nextEnd = 0;
+    unsigned int stamp = 0;
+    while (nextEnd < tess.Ends.size())
+    {
+      stamp++;
 
-      const glm::vec2 widthVector1 = normalWidthVector1 * currentStyle.StrokeWidth * 0.5f;
-      const glm::vec2 widthVector2 = normalWidthVector2 * currentStyle.StrokeWidth * 0.5f;
+      // The next event. Edges end before the last one starts, so the sweep is done when all have ended
+      float y = tess.Edges[tess.Ends[nextEnd]].Bottom.y;
+      if (nextEdge < tess.Edges.size())
+      {
+        y = srMin(y, tess.Edges[nextEdge].Top.y);
+      }
+      if (!tess.Crossings.empty())
+      {
+        y = srMin(y, tess.Crossings.front().Y);
+      }
+      tess.SweepY = y;
+      tess.Seeds.clear();
+      tess.Crossed.clear();
+      tess.Starting.clear();
+
+      // Edges that cross here are inserted again in their new order. Crossings of edges that are no longer
+      // neighbours are out of date
+      while (!tess.Crossings.empty() && tess.Crossings.front().Y <= y)
+      {
+        const FillCrossing crossing = tess.Crossings.front();
+        std::pop_heap(tess.Crossings.begin(), tess.Crossings.end(), FillCrossingLater);
+        tess.Crossings.pop_back();
 
-      glm::vec2 currentConnectedTop = currentPoint + widthVector1;
-      glm::vec2 currentConnectedBottom = currentPoint - widthVector1;
+        const int left = tess.Edges[crossing.Left].Slot;
+        const int right = tess.Edges[crossing.Right].Slot;
+        if (left < 0 || right < 0 || std::next(tess.Nodes[left]) == tess.Active.end() || (int)*std::next(tess.Nodes[left]) != right)
+        {
+          continue;
+        }
+        tess.Crossed.push_back(crossing.Left);
+        tess.Crossed.push_back(crossing.Right);
+      }
+      for (unsigned int edgeIndex : tess.Crossed)
+      {
+        if (tess.Edges[edgeIndex].Slot >= 0)
+        {
+          FillRemoveEdge(tess, edgeIndex, rule);
+        }
+      }
 
-      if (!closedPath && i1 == 0)
+      // Edges ending here are removed, or continued by an edge starting at the same point in the same direction
+      while (nextEnd < tess.Ends.size() && tess.Edges[tess.Ends[nextEnd]].Bottom.y <= y)
+      {
+        const unsigned int ending = tess.Ends[nextEnd++];
+        const FillEdge &edge = tess.Edges[ending];
+        while (nextEdge < tess.Edges.size() && tess.Edges[nextEdge].Top.y <= y && tess.Edges[nextEdge].Top.x < edge.Bottom.x)
+        {
+          tess.Starting.push_back(nextEdge++);
+        }
+        if (nextEdge < tess.Edges.size() && tess.Edges[nextEdge].Top == edge.Bottom && tess.Edges[nextEdge].Winding == edge.Winding)
+        {
+          if (!FillContinueEdge(tess, ending, nextEdge, rule))
+          {
+            FillRemoveEdge(tess, ending, rule);
+            tess.Starting.push_back(nextEdge);
+          }
+          nextEdge++;
+        }
+        else
+        {
+          FillRemoveEdge(tess, ending, rule);
+        }
+      }
+      while (nextEdge < tess.Edges.size() && tess.Edges[nextEdge].Top.y <= y)
+      {
+        tess.Starting.push_back(nextEdge++);
+      }
+      for (unsigned int edgeIndex : tess.Crossed)
+      {
+        if (tess.Edges[edgeIndex].Slot < 0)
+        {
+          FillInsertEdge(tess, edgeIndex, stamp);
+        }
+      }
+      for (unsigned int edgeIndex : tess.Starting)
       {
-        currentConnectedTop = currentPoint + widthVector2;
-        currentConnectedBottom = currentPoint - widthVector2;
+        FillInsertEdge(tess, edgeIndex, stamp);
       }
 
-      if ((i1 < count - 1 && i1 > 0) || closedPath)
+      // Run the fill rule from each changed place on, until the winding is the same as before. The walks go from left
+      // to right, so each one starts from a winding that is up to date and skips what the last one went over
+      const FillEdgeOrder order = tess.Active.key_comp();
+      tess.Seeds.erase(std::remove_if(tess.Seeds.begin(), tess.Seeds.end(), [&tess](int seed)
+                                      { return seed >= 0 && tess.Nodes[seed] == tess.Active.end(); }),
+                       tess.Seeds.end()); // Removed after the event changed its right neighbour
+      std::sort(tess.Seeds.begin(), tess.Seeds.end(), [&order](int a, int b)
+                { return b >= 0 && (a < 0 || order((unsigned int)a, (unsigned int)b)); });
+      tess.Seeds.erase(std::unique(tess.Seeds.begin(), tess.Seeds.end()), tess.Seeds.end());
+      int walked = -1; // Slot the last walk ended at
+      for (int seed : tess.Seeds)
       {
-        // Get calc points
-        const glm::vec2 cornerA = currentPoint + widthVector1;
-        const glm::vec2 cornerB = currentPoint + widthVector2;
+        if (walked >= 0 && seed >= 0 && order((unsigned int)seed, (unsigned int)walked))
+        {
+          continue;
+        }
 
-        // Check which point is pos and which negative
-        const glm::vec2 center = cornerA + ((cornerB - cornerA) / 2.0f);
+        FillTessellator::ActiveSet::iterator node = seed < 0 ? tess.Active.begin() : tess.Nodes[seed];
+        int winding = node == tess.Active.begin() ? 0 : tess.Edges[tess.SlotEdges[*std::prev(node)]].WindingRight;
+        for (bool first = true; node != tess.Active.end(); first = false)
+        {
+          const unsigned int edgeIndex = tess.SlotEdges[*node];
+          FillEdge &edge = tess.Edges[edgeIndex];
+          winding += edge.Winding;
+          const bool settled = !first && edge.Stamp != stamp && edge.WindingRight == winding;
+          edge.WindingRight = winding;
+          walked = (int)*node;
+
+          const int right = ++node != tess.Active.end() ? (int)tess.SlotEdges[*node] : -1;
+          FillUpdateSpan(tess, edgeIndex, right, rule);
+          if (right >= 0)
+          {
+            FillQueueCrossing(tess, edgeIndex, right);
+          }
+          if (settled)
+          {
+            break;
+          }
+        }
+      }
+    }
+  }
 
-        const float connectionLength = glm::length(cornerB - cornerA);
-        const float diagonalLength = glm::length(currentPoint - center);
+  // A single subpath that turns in one direction and goes around once can be drawn as a fan
+  static bool PathIsConvex(const PathBuilder &pb)
+  {
+    if (pb.SubpathStarts.size() > 0)
+    {
+      return false;
+    }
 
-        float a = ((connectionLength / 2.0f) / diagonalLength) * (currentStyle.StrokeWidth / 2.0f);
-        // SR_TRACE("SF=%f, f=%f, a=%f", connectionLength, diagonalLength, a);
-        float a_clamp = srMin(prevLength, nextLength);
-        a = srClamp(a, -a_clamp, a_clamp);
+    const size_t count = pb.Points.size();
+    int turnSign = 0;
+    int xDirectionChanges = 0;
+    int lastXDirection = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      const glm::vec2 &a = pb.Points[i];
+      const glm::vec2 &b = pb.Points[(i + 1) % count];
+      const glm::vec2 &c = pb.Points[(i + 2) % count];
 
-        float dot = glm::dot(dir1, normalWidthVector2);
-        float funny = dot / srAbs(dot);
-        if (funny == 0)
-          funny = 1;
-        currentConnectedTop += (dir1 * a) * funny;
-        currentConnectedBottom -= (dir1 * a) * funny;
+      const float cross = (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+      if (cross != 0.0f)
+      {
+        const int sign = cross > 0.0f ? 1 : -1;
+        if (turnSign != 0 && sign != turnSign)
+        {
+          return false;
+        }
+        turnSign = sign;
       }
 
-      if (i1 == 0)
+      const float dx = b.x - a.x;
+      if (dx != 0.0f)
       {
-        lastTop = currentConnectedTop;       // We use widthVector2 because prev and current is the same point
-        lastBottom = currentConnectedBottom; // We want the distance to the next point
-        continue;
+        const int direction = dx > 0.0f ? 1 : -1;
+        if (lastXDirection != 0 && direction != lastXDirection)
+        {
+          xDirectionChanges++;
+        }
+        lastXDirection = direction;
       }
+    }
+    // Going around more than once (like a star) changes the x direction more often
+    return xDirectionChanges <= 2;
+  }
 
-      // Find connection point for good filling
+  // One pixel ring around every subpath, from the fill color on the outline to transparent. It is emitted before the
+  // fill, so the depth test keeps the fill out of the inner half of the ring
+  static void FillFringe(const PathBuilder &pb)
+  {
+    const float halfFringe = 0.5f / srGetPixelScale();
 
-      srVertex2f(lastBottom);
-      srVertex2f(currentConnectedBottom);
-      srVertex2f(currentConnectedTop);
+    // The outside is on the same side of every subpath as on the largest one, assuming holes wind the other way
+    float largestArea = 0.0f;
+    for (unsigned int subpath = 0; subpath < PathSubpathCount(pb); subpath++)
+    {
+      unsigned int first = 0;
+      unsigned int count = 0;
+      PathGetSubpath(pb, subpath, &first, &count);
+      float area = 0.0f;
+      for (unsigned int i = 0; i < count; i++)
+      {
+        const glm::vec2 &a = pb.Points[first + i];
+        const glm::vec2 &b = pb.Points[first + (i + 1) % count];
+        area += a.x * b.y - b.x * a.y;
+      }
+      if (srAbs(area) > srAbs(largestArea))
+      {
+        largestArea = area;
+      }
+    }
+    const float outward = largestArea > 0.0f ? halfFringe : -halfFringe;
 
-      srVertex2f(currentConnectedTop);
-      srVertex2f(lastTop);
-      srVertex2f(lastBottom);
+    unsigned int nextStyleChange = pb.Styles.size() > 0 ? pb.Styles[0].first : 0;
+    unsigned int currentStyleIndex = 0;
+    auto fillStyle = [&](unsigned int point) -> const PathStyle &
+    {
+      if (pb.Styles.empty())
+      {
+        return pb.CurrentPathStyle;
+      }
+      while (currentStyleIndex + 1 < pb.Styles.size() && nextStyleChange <= point)
+      {
+        currentStyleIndex++;
+        nextStyleChange += pb.Styles[currentStyleIndex].first;
+      }
+      return pb.Styles[currentStyleIndex].second;
+    };
 
-      // SR_TRACE("Rendering QUAD index %d\nLT(%f, %f)\nCT(%f, %f)\nCB(%f, %f)\nLB(%f, %f)", i1, lastTop.x, lastTop.y, currentConnectedTop.x, currentConnectedTop.y, currentConnectedBottom.x, currentConnectedBottom.y, lastBottom.x, lastBottom.y);
+    StrokeScratch &scratch = sStrokeScratch;
+    for (unsigned int subpath = 0; subpath < PathSubpathCount(pb); subpath++)
+    {
+      unsigned int first = 0;
+      unsigned int count = 0;
+      PathGetSubpath(pb, subpath, &first, &count);
 
-      lastBottom = currentConnectedBottom;
-      lastTop = currentConnectedTop;
+      bool closed = true;
+      const size_t segmentCount = StrokeLoadSubpath(pb, first, count, closed);
+      if (!closed)
+      {
+        continue;
+      }
 
-      if (nextStyleChange <= i1)
+      // Inner and outer vertex of every point, along the miter of its corner. Sharp corners get a shorter miter
+      StrokeParams params;
+      params.AntiAlias = true;
+      params.Dashed = false;
+      params.Solid = -outward;
+      params.Fringe = outward;
+      StrokePoint firstPoint{};
+      StrokePoint previous{};
+      for (size_t i = 0; i <= segmentCount; i++)
       {
-        currentStyleIndex++;
-        if (currentStyleIndex < pb.Styles.size())
+        const size_t k = i % segmentCount;
+        const size_t k0 = (k + segmentCount - 1) % segmentCount;
+        const glm::vec2 n0(scratch.DirY[k0], -scratch.DirX[k0]);
+        const glm::vec2 n1(scratch.DirY[k], -scratch.DirX[k]);
+        const float denom = 1.0f + glm::dot(n0, n1);
+        glm::vec2 miter = denom > 1e-6f ? (n0 + n1) / denom : n0;
+        const float miterLength = glm::length(miter);
+        if (miterLength > 4.0f)
         {
-          currentStyle = pb.Styles[currentStyleIndex].second;
-          nextStyleChange += pb.Styles[currentStyleIndex].first;
-          srColor11c(currentStyle.StrokeColor);
+          miter *= 4.0f / miterLength;
+        }
+
+        const PathStyle &style = fillStyle(scratch.Source[k]);
+        params.Gradient = (float)style.FillGradient;
+        params.SolidColor = style.FillGradient != 0 ? (style.FillColor | 0x00ffffff) : style.FillColor;
+        params.FringeColor = params.SolidColor & 0x00ffffff;
+        if (srCheckRenderBatchLimit(4, 6) && i > 0)
+        {
+          previous = StrokeEmit(params, previous.Center, previous.Offset, 0.0f);
+        }
+        const StrokePoint current = i < segmentCount ? StrokeEmit(params, scratch.Points[k], miter, 0.0f) : StrokeEmit(params, firstPoint.Center, firstPoint.Offset, 0.0f);
+        if (i == 0)
+        {
+          firstPoint = current;
         }
+        else
+        {
+          StrokeTriangle(previous.Fringe, previous.Solid, current.Solid);
+          StrokeTriangle(current.Solid, current.Fringe, previous.Fringe);
+        }
+        previous = current;
+      }
+    }
+  }
+
+  // Stencil then cover. Every subpath is fanned into the stencil buffer, where the winding adds up.
+  // The bounding box is then drawn where the stencil is set, which also clears it again
+  static void FillStencilCover(const PathBuilder &pb, const Material &material, Color color, GradientHandle gradient)
+  {
+    glm::vec2 boundsMin = pb.Points[0];
+    glm::vec2 boundsMax = pb.Points[0];
+    for (const glm::vec2 &point : pb.Points)
+    {
+      boundsMin = glm::vec2(srMin(boundsMin.x, point.x), srMin(boundsMin.y, point.y));
+      boundsMax = glm::vec2(srMax(boundsMax.x, point.x), srMax(boundsMax.y, point.y));
+    }
+
+    SRC->Stencil = pb.FillRule == FillRule_EvenOdd ? StencilMode_WriteEvenOdd : StencilMode_WriteNonZero;
+    srBegin(TRIANGLES);
+    for (unsigned int subpath = 0; subpath < PathSubpathCount(pb); subpath++)
+    {
+      unsigned int first = 0;
+      unsigned int count = 0;
+      PathGetSubpath(pb, subpath, &first, &count);
+      for (unsigned int i = first + 1; i + 1 < first + count; i++)
+      {
+        srCheckRenderBatchLimit(3);
+        srVertex2f(pb.Points[first]);
+        srVertex2f(pb.Points[i]);
+        srVertex2f(pb.Points[i + 1]);
       }
     }
+
+    SRC->Stencil = StencilMode_Cover;
+    srBegin(QUADS, material);
+    PaintApply(color, gradient);
+    srCheckRenderBatchLimit(4);
+    srVertex2f(boundsMin.x, boundsMin.y);
+    srVertex2f(boundsMax.x, boundsMin.y);
+    srVertex2f(boundsMax.x, boundsMax.y);
+    srVertex2f(boundsMin.x, boundsMax.y);
     srEnd();
+
+    SRC->Stencil = StencilMode_None;
   }
 
   R_API void srAddPolyFilled(const PathBuilder &pb)
@@ -2324,7 +7098,6 @@ namespace sr
       return;
     }
     const size_t count = pb.Points.size();
-    srCheckRenderBatchLimit(count * 3);
 
     PathStyle currentStyle = pb.CurrentPathStyle;
     unsigned int nextStyleChange = 0;
@@ -2335,24 +7108,60 @@ namespace sr
       nextStyleChange = pb.Styles[0].first;
     }
 
-    srBegin(TRIANGLES);
-    srColor11c(currentStyle.FillColor);
+    Material material{};
+    if (currentStyle.FillGradient != 0 || std::any_of(pb.Styles.begin(), pb.Styles.end(), [](const PathBuilder::PathStyleIndex &style)
+                                                      { return style.second.FillGradient != 0; }))
+    {
+      material.ShaderProgram = SRC->GradientShader;
+    }
+
+    if (pb.FillMode == PathFillMode_Stencil)
+    {
+      FillStencilCover(pb, material, currentStyle.FillColor, currentStyle.FillGradient);
+      return;
+    }
+
+    // Indexed like strokes, so fill and stroke of a path end up in the same draw call
+    srBegin(TRIANGLES_INDEXED, material);
+    if (SRC->AntiAliasing)
+    {
+      FillFringe(pb);
+    }
+    PaintApply(currentStyle.FillColor, currentStyle.FillGradient);
+
+    if (!PathIsConvex(pb))
+    {
+      FillTessellate(pb);
+      srEnd();
+      return;
+    }
 
-    for (size_t i = 1; i < count; i++)
+    // Fan around the first point. It and the previous point are emitted again when the color changes or the batch overflows
+    srCheckRenderBatchLimit(2);
+    unsigned int center = StrokeVertex(pb.Points[0]);
+    unsigned int previous = StrokeVertex(pb.Points[1]);
+    for (size_t i = 2; i < count; i++)
     {
-      const size_t i2 = (i + 1) % count;
-      srVertex2f(pb.Points[0]);
-      srVertex2f(pb.Points[i]);
-      srVertex2f(pb.Points[i2]);
+      if (srCheckRenderBatchLimit(3, 3))
+      {
+        center = StrokeVertex(pb.Points[0]);
+        previous = StrokeVertex(pb.Points[i - 1]);
+      }
+      const unsigned int current = StrokeVertex(pb.Points[i]);
+      StrokeTriangle(center, previous, current);
+      previous = current;
 
-      if (nextStyleChange <= i)
+      if (nextStyleChange <= i - 1)
       {
         currentStyleIndex++;
         if (currentStyleIndex < pb.Styles.size())
         {
           currentStyle = pb.Styles[currentStyleIndex].second;
           nextStyleChange += pb.Styles[currentStyleIndex].first;
-          srColor11c(currentStyle.FillColor);
+          PaintApply(currentStyle.FillColor, currentStyle.FillGradient);
+          srCheckRenderBatchLimit(2);
+          center = StrokeVertex(pb.Points[0]);
+          previous = StrokeVertex(pb.Points[i]);
         }
       }
     }
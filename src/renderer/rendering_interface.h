@@ -1,6 +1,20 @@
 #pragma once
 
 #define SR_BATCH_DRAW_CALLS 256
+#define SR_BATCH_UPLOAD_CHUNK_SIZE 256 // Vertices per hashed chunk. Only changed chunks get uploaded
+#define SR_MAX_FRAMES_IN_FLIGHT 3       // Upper limit for srSetFramesInFlight
+#define SR_PATH_CACHE_BUDGET (8 * 1024 * 1024) // Default bytes of tessellated paths kept across frames
+#define SR_PATH_CACHE_MAX_POINTS 4096          // Paths with more recorded points are not cached
+#define SR_PATH_SIMPLIFY_CACHE_BUDGET (64 * 1024 * 1024) // Default bytes of large paths and their simplified points kept across frames
+#define SR_ARC_MAX_SEGMENTS 4096               // Segments of a full circle at the finest level of detail
+#define SR_GRADIENT_RAMP_SIZE 256              // Color samples per gradient
+#define SR_GRADIENT_MAX_COUNT 256              // Gradients that can be loaded at the same time
+#define SR_PATH_MAX_WORKERS 15                 // Threads tessellating deferred paths next to the flushing one
+#define SR_TEXT_CACHE_BUDGET (8 * 1024 * 1024) // Default bytes of laid out strings kept across frames
+#define SR_TEXT_CACHE_MAX_LENGTH 1024          // Longer strings are laid out on every call
+#define SR_FONT_LOAD_WORKERS 8                 // Threads rendering the glyphs of a font while it is loaded
+#define SR_FONT_SDF_SIZE 32                    // Size the glyphs of a face are rendered at. Every other size draws them scaled
+#define SR_FONT_ATLAS_BUDGET (16 * 1024 * 1024) // Default bytes of glyph atlas pages. Beyond it, cold glyphs are evicted
 
 namespace sr
 {
@@ -22,6 +36,23 @@ namespace sr
     R_API void srNewFrame(int frameWidth, int frameHeight, int windowWidth, int windowHeight);
     R_API void srEndFrame();
 
+    /**
+     * @brief Sets how many frames the cpu may record ahead of the gpu.
+     * Every flush of the batch writes its vertices into its own slice of the batch buffer and is guarded by a fence,
+     * so a frame that flushes in the middle waits for the gpu sooner.
+     *
+     * @param count Clamped to 1 - SR_MAX_FRAMES_IN_FLIGHT
+     */
+    R_API void srSetFramesInFlight(unsigned int count);
+    R_API unsigned int srGetFramesInFlight();
+
+    /**
+     * @brief Time the cpu spent waiting on frame fences during the last frame
+     *
+     * @return double Seconds
+     */
+    R_API double srGetFenceWaitTime();
+
     /**
      * @brief Clears framebuffer
      *
@@ -90,6 +121,15 @@ namespace sr
         float Height;
     };
 
+    // Stencil state of a draw call. Used for stencil then cover path fills
+    enum StencilMode_
+    {
+        StencilMode_None,
+        StencilMode_WriteNonZero, // Front faces increment, back faces decrement. No color output
+        StencilMode_WriteEvenOdd, // Every face inverts. No color output
+        StencilMode_Cover         // Draws where the stencil is not 0 and resets it
+    };
+
     /**
      * @brief Takes a rectangle and rotates it around the origin
      *
@@ -129,6 +169,16 @@ namespace sr
         return srMin(srMax(value, min), max);
     }
 
+    /**
+     * @brief Fast non cryptographic 64 bit hash
+     *
+     * @param data Memory to hash
+     * @param size Size in bytes
+     * @param seed Start value. Can be used to chain hashes
+     * @return uint64_t
+     */
+    R_API uint64_t srHashMemory(const void *data, size_t size, uint64_t seed = 0);
+
     // Shaders
     enum class EUniformLocation : int
     {
@@ -171,6 +221,7 @@ namespace sr
     R_API void srShaderSetUniform1f(Shader shader, const char *name, float value);
     R_API void srShaderSetUniform2f(Shader shader, const char *name, const glm::vec2 &value);
     R_API void srShaderSetUniform3f(Shader shader, const char *name, const glm::vec3 &value);
+    R_API void srShaderSetUniform4f(Shader shader, const char *name, const glm::vec4 &value);
     R_API void srShaderSetUniformMat4(Shader shader, const char *name, const glm::mat4 &value);
     R_API void srSetDefaultShaderUniforms(Shader shader); // Binds the shader in this call as well
 
@@ -221,6 +272,76 @@ namespace sr
 
     R_API void srPushMaterial(const Material &mat);
 
+    // Gradients
+    // All gradients share one float texture with their color ramps and geometry, bound to texture unit 1. Vertices pick
+    // their gradient with Normal.z, so paths and text with different gradients still end up in the same draw call
+
+    typedef unsigned int GradientHandle; // 0 is no gradient
+
+    enum GradientSpread_
+    {
+        GradientSpread_Pad, // Keeps the color of the first and last stop outside of the gradient
+        GradientSpread_Repeat,
+        GradientSpread_Reflect
+    };
+
+    struct GradientStop
+    {
+        float Offset; // 0 to 1 along the gradient. Stops have to be sorted by offset
+        Color StopColor;
+    };
+
+    /**
+     * @brief Loads a gradient that changes color along the line from start to end. Positions are in the same units as the
+     * vertices, so the gradient stays in place when the shapes using it move
+     *
+     * @param stops     Colors along the gradient, interpolated with premultiplied alpha
+     * @param stopCount Number of stops
+     * @param spread    Color outside of the 0 to 1 range
+     * @return Handle for srPathSetFillGradient, srPathSetStrokeGradient and srDrawTextGradient. 0 when all
+     * SR_GRADIENT_MAX_COUNT gradients are in use
+     */
+    R_API GradientHandle srLoadLinearGradient(const glm::vec2 &start, const glm::vec2 &end, const GradientStop *stops, unsigned int stopCount, GradientSpread_ spread = GradientSpread_Pad);
+    R_API GradientHandle srLoadRadialGradient(const glm::vec2 &center, float radius, const GradientStop *stops, unsigned int stopCount, GradientSpread_ spread = GradientSpread_Pad);
+    R_API GradientHandle srLoadConicGradient(const glm::vec2 &center, float startAngle, const GradientStop *stops, unsigned int stopCount, GradientSpread_ spread = GradientSpread_Pad); // Sweeps around the center. Angles in degree, measured like in srPathArc
+    R_API void srUnloadGradient(GradientHandle gradient);
+
+    // Time series
+    // Samples are uploaded once into a ring buffer on the gpu. The vertex shader expands every pair of neighbouring samples
+    // into an anti aliased line segment, so drawing a series costs no cpu time per sample
+
+    typedef unsigned int TimeSeriesHandle; // 0 is no time series
+
+    /**
+     * @brief Creates the gpu ring buffer of a time series
+     *
+     * @param capacity Samples kept. Appending more overwrites the oldest ones
+     * @return Handle for the srTimeSeries functions and srDrawTimeSeries
+     */
+    R_API TimeSeriesHandle srLoadTimeSeries(unsigned int capacity);
+    R_API void srUnloadTimeSeries(TimeSeriesHandle series);
+
+    /**
+     * @brief Uploads samples behind the newest ones. Only the new samples are sent, in at most two buffer updates.
+     * Samples are stored as 32 bit floats, so keep them relative to an origin close to the data (e.g. the start time)
+     *
+     * @param samples (x, y) pairs in the order they are connected
+     * @param count   Number of samples
+     */
+    R_API void srTimeSeriesAppend(TimeSeriesHandle series, const glm::vec2 *samples, size_t count);
+    R_API void srTimeSeriesClear(TimeSeriesHandle series);
+    R_API unsigned int srTimeSeriesGetCount(TimeSeriesHandle series);
+
+    /**
+     * @brief Draws the samples of a series as a connected line. Pan and zoom only change uniforms. Flushes the batch,
+     * so draw all series of a panel after each other
+     *
+     * @param offset    Position of the sample (0, 0)
+     * @param scale     Units per sample unit on both axis. Use a negative y to plot upwards
+     * @param thickness Line width in units. Thinner lines than a pixel fade out instead
+     */
+    R_API void srDrawTimeSeries(TimeSeriesHandle series, const glm::vec2 &offset, const glm::vec2 &scale, float thickness, Color color = 0xffffffff);
+
     // Vertex Array
     // Used to store all buffers to be able to render
     enum class EVertexAttributeType
@@ -330,7 +451,9 @@ namespace sr
         TRIANGLES = 1,
         QUADS,
         LINES,
-        POINTS
+        POINTS,
+        TRIANGLES_INDEXED, // Triangles from the indices given with srIndex1ui
+        SEGMENTS           // Every vertex is a line segment, expanded by the SegmentShader. See srDrawLineSegment
     };
 
     typedef uint32_t PathType;
@@ -340,23 +463,98 @@ namespace sr
         PathType_Fill = 1 << 1
     };
 
+    // How srAddPolyFilled produces fills
+    enum PathFillMode_
+    {
+        PathFillMode_Tessellate, // Triangulated on the cpu
+        PathFillMode_Stencil     // Fan into the stencil buffer, then cover the bounding box. Needs a stencil buffer
+    };
+
+    // How srAddPolyline produces strokes
+    enum PathStrokeMode_
+    {
+        PathStrokeMode_Tessellate, // Outline triangulated on the cpu
+        PathStrokeMode_Instanced   // One SEGMENTS vertex per segment. Joins are always round. Dashes and gradients get tessellated
+    };
+
+    // Decides which regions of a self intersecting or multi subpath fill are inside
+    enum FillRule_
+    {
+        FillRule_NonZero,
+        FillRule_EvenOdd
+    };
+
+    enum LineJoin_
+    {
+        LineJoin_Miter, // Falls back to bevel when the miter gets longer than MiterLimit * StrokeWidth
+        LineJoin_Bevel,
+        LineJoin_Round
+    };
+
+    enum LineCap_
+    {
+        LineCap_Butt,
+        LineCap_Square, // Extends the ends by half the stroke width
+        LineCap_Round
+    };
+
     struct PathStyle
     {
         float StrokeWidth = 0.01f;
         Color StrokeColor = 0xffffffff;
         Color FillColor = 0xffffffff;
+        LineJoin_ LineJoin = LineJoin_Miter;
+        LineCap_ LineCap = LineCap_Butt;
+        float MiterLimit = 4.0f;
+        float DashLength = 0.0f; // Dashes are drawn by the DashShader when length and gap are set
+        float DashGap = 0.0f;
+        float DashOffset = 0.0f; // Distance into the pattern at the start of every subpath
+        GradientHandle FillGradient = 0; // Replaces the rgb of the fill color. Its alpha stays as opacity
+        GradientHandle StrokeGradient = 0;
+    };
+
+    enum PathCommandType_
+    {
+        PathCommandType_MoveTo,
+        PathCommandType_LineTo, // Every point of consecutive srPathLineTo calls
+        PathCommandType_Arc,
+        PathCommandType_EllipticalArc,
+        PathCommandType_CubicBezier,
+        PathCommandType_QuadraticBezier,
+        PathCommandType_Close,
+        PathCommandType_Style
+    };
+
+    struct PathCommand
+    {
+        PathCommandType_ Type;
+        unsigned int First = 0; // First entry in CommandPoints. Index into CommandStyles for PathCommandType_Style
+        unsigned int Count = 0; // Entries in CommandPoints
+        float Params[5] = {};   // Angles, radii and flags of arcs
+        unsigned int SegmentCount = 0;
     };
 
     struct PathBuilder
     {
+        // Recorded by the srPath functions. Flattened into Points by srEndPath, unless the path is cached
+        std::vector<PathCommand> Commands;
+        std::vector<glm::vec2> CommandPoints;
+        std::vector<PathStyle> CommandStyles;
+
         std::vector<glm::vec2> Points;
-        PathStyle CurrentPathStyle; // Not used right now. Can be removed
+        PathStyle CurrentPathStyle; // Recorded with every style change
         PathType RenderType = 0;
 
         using PathStyleIndex = std::pair<unsigned int, PathStyle>;
         std::vector<PathStyleIndex> Styles;
 
         unsigned int PreviousStyleVertexIndex = 0;
+
+        std::vector<unsigned int> SubpathStarts; // Index of the first point of every subpath after the first one
+        FillRule_ FillRule = FillRule_NonZero;
+        PathFillMode_ FillMode = PathFillMode_Tessellate;
+        PathStrokeMode_ StrokeMode = PathStrokeMode_Tessellate;
+        bool Simplify = false;
     };
 
     struct RenderBatch
@@ -373,9 +571,25 @@ namespace sr
         struct Buffer
         {
             Vertex *Vertices = NULL; // Drawing buffer
-            unsigned int *Indices = NULL;
+            unsigned int *Indices = NULL; // Static quad pattern
             unsigned int ElementCount = 0;
-            VertexBuffers GlBinding; // Rendering buffer
+            unsigned int *DynamicIndices = NULL; // Indices of TRIANGLES_INDEXED draws
+            unsigned int IndexCapacity = 0;
+            unsigned int SegmentVAO = 0; // Reads the vertices of SEGMENTS draws from the vbo as instances
+            // Rendering buffer. The vbo holds one slice of ElementCount vertices per frame in flight.
+            // The ibo holds the quad pattern followed by one slice of IndexCapacity dynamic indices per frame in flight
+            VertexBuffers GlBinding;
+        };
+
+        // Resources owned by one flush in flight. A frame that flushes more than once uses more than one
+        struct FrameResources
+        {
+            void *Fence = NULL;            // GLsync. Signaled when the gpu is done with this slice
+            unsigned int VertexOffset = 0; // First vertex of this frames slice in the vbo
+
+            // Hash of every SR_BATCH_UPLOAD_CHUNK_SIZE vertices that are currently in the slice
+            uint64_t *ChunkHashes = NULL;
+            unsigned int ChunkCount = 0;
         };
 
         struct DrawCall
@@ -384,14 +598,26 @@ namespace sr
             Material Mat = {0};
             unsigned int VertexCount = 0;
             unsigned int VertexAlignment = 0; // Number for alining (LINE, TRIANGLES) to quads
+            unsigned int IndexCount = 0;      // Only used by TRIANGLES_INDEXED
 
             ScissorTest Scissor;
+            StencilMode_ Stencil = StencilMode_None;
         };
 
         Buffer DrawBuffer;
         DrawCall *DrawCalls; // size = SR_BATCH_DRAW_CALLS
+
+        FrameResources Frames[SR_MAX_FRAMES_IN_FLIGHT];
+        unsigned int FramesInFlight = 2;
+        unsigned int CurrentFrame = 0;
+        bool FrameSynced = false;     // Fence of the current frame was already waited for
+        double FenceWaitTime = 0.0;   // Seconds waited on fences in the current frame
+        double LastFenceWaitTime = 0.0;
         unsigned int CurrentDraw = 0;
         unsigned int VertexCounter = 0;
+        unsigned int IndexCounter = 0;
+        unsigned int FlushCounter = 0; // Incremented by every srDrawRenderBatch
+        unsigned int UploadedVertexCount = 0; // Vertices sent to the gpu by the last srDrawRenderBatch
 
         double CurrentDepth = 0;
 
@@ -413,17 +639,19 @@ namespace sr
     R_API RenderBatch srLoadRenderBatch(unsigned int bufferSize);
 
     R_API void srIncreaseRenderBatchCurrentDraw(RenderBatch *batch);
-    R_API bool srCheckRenderBatchLimit(unsigned int numVerts); // Returns true if batch overflowed
+    R_API bool srCheckRenderBatchLimit(unsigned int numVerts, unsigned int numIndices = 0); // Returns true if batch overflowed
     R_API void srDrawRenderBatch(RenderBatch *batch);
 
     R_API void srEnableScissor(float x, float y, float width, float height);
     R_API void srDisableScissor();
 
-    R_API void srBegin(EBatchDrawMode mode);
+    R_API void srBegin(EBatchDrawMode mode, const Material &material = {}); // Starts a new draw call when mode, material or state changed
     R_API void srVertex3f(float x, float y, float z);
     R_API void srVertex3f(const glm::vec3 &vertex);
     R_API void srVertex2f(float x, float y);
     R_API void srVertex2f(const glm::vec2 &vertex);
+    R_API unsigned int srGetCurrentVertexIndex(); // Index the next vertex will get. Only valid until the batch overflows
+    R_API void srIndex1ui(unsigned int index);    // For TRIANGLES_INDEXED. Reserve the indices with srCheckRenderBatchLimit first
     R_API void srNormal3f(float x, float y, float z);
     R_API void srNormal3f(const glm::vec3 &normal);
     R_API void srColor11c(Color color);
@@ -442,13 +670,51 @@ namespace sr
 
     // Path builder. Begin with srBeginPath(), and end with srEndPath(type). The type can be PathType_Stroke, PathType_Fill. You can also or them together to get stroke and fill
 
+    // Curves take a segmentCount. Passing 0 derives the count from the path tolerance (see srPathSetTolerance)
+
     R_API void srBeginPath(PathType type);
     R_API void srEndPath(bool closedPath = false);
     R_API void srPathLineTo(const glm::vec2 &position);
-    R_API void srPathArc(const glm::vec2 &center, float startAngle, float endAngle, float radius, unsigned int segmentCount = 22);
-    R_API void srPathEllipticalArc(const glm::vec2 &end_point, float angle, float radius_x, float radius_y, bool large_arc_flag, bool sweep_flag, unsigned int segmentCount = 22);
-    R_API void srPathCubicBezierTo(const glm::vec2 &controll1, const glm::vec2 &controll2, const glm::vec2 &endPosition, unsigned int segmentCount = 22);
-    R_API void srPathQuadraticBezierTo(const glm::vec2 &controll, const glm::vec2 &endPosition, unsigned int segmentCount = 22);
+    R_API void srPathLinesTo(const glm::vec2 *positions, size_t count); // Same as srPathLineTo for every position
+    R_API void srPathMoveTo(const glm::vec2 &position); // Starts a new subpath. Use them for holes in fills
+    R_API void srPathArc(const glm::vec2 &center, float startAngle, float endAngle, float radius, unsigned int segmentCount = 0);
+    R_API void srPathEllipticalArc(const glm::vec2 &end_point, float angle, float radius_x, float radius_y, bool large_arc_flag, bool sweep_flag, unsigned int segmentCount = 0);
+    R_API void srPathCubicBezierTo(const glm::vec2 &controll1, const glm::vec2 &controll2, const glm::vec2 &endPosition, unsigned int segmentCount = 0);
+    R_API void srPathQuadraticBezierTo(const glm::vec2 &controll, const glm::vec2 &endPosition, unsigned int segmentCount = 0);
+
+    /**
+     * @brief Sets the maximum distance between a curve and its flattened polyline
+     *
+     * @param pixels Error in framebuffer pixels (default 0.25)
+     */
+    R_API void srPathSetTolerance(float pixels);
+    R_API float srPathGetTolerance();
+
+    /**
+     * @brief Framebuffer pixels covered by one unit in path coordinates. Derived from the current projection
+     *
+     * @return float
+     */
+    R_API float srGetPixelScale();
+
+    /**
+     * @brief Fades the outline of strokes and tessellated fills out over one pixel. Looks close to multisampling
+     * without needing a multisampled framebuffer. Stencil fills are not affected
+     *
+     * @param enabled Default false
+     */
+    R_API void srSetAntiAliasing(bool enabled);
+    R_API bool srGetAntiAliasing();
+
+    /**
+     * @brief While enabled srEndPath only queues the path. Queued paths are flattened and tessellated on all cores before
+     * the next draw that is not a path, or when the batch gets drawn, and land in the batch in the order they were ended.
+     * Pays off for frames with many paths, like the features of a map
+     *
+     * @param enabled Default false
+     */
+    R_API void srSetDeferredPaths(bool enabled);
+    R_API bool srGetDeferredPaths();
 
     R_API void srPathSetStrokeEnabled(bool showStroke);
     R_API void srPathSetFillEnabled(bool fill);
@@ -457,10 +723,56 @@ namespace sr
     R_API void srPathSetStrokeColor(Color color);
     R_API void srPathSetStrokeColor(const glm::vec4 &color);
     R_API void srPathSetStrokeWidth(float width);
+    R_API void srPathSetLineJoin(LineJoin_ join);
+    R_API void srPathSetLineCap(LineCap_ cap);
+    R_API void srPathSetMiterLimit(float limit);
+    R_API void srPathSetDash(float length, float gap, float offset = 0.0f); // A length or gap of 0 draws solid strokes
+    R_API void srPathSetFillGradient(GradientHandle gradient);   // 0 fills with the fill color again
+    R_API void srPathSetStrokeGradient(GradientHandle gradient); // 0 strokes with the stroke color again
     R_API void srPathSetStyle(const PathStyle &style);
+    R_API void srPathSetFillRule(FillRule_ rule); // Gets reset to FillRule_NonZero by srBeginPath
+    R_API void srPathSetFillMode(PathFillMode_ mode); // Gets reset to PathFillMode_Tessellate by srBeginPath
+    R_API void srPathSetStrokeMode(PathStrokeMode_ mode); // Gets reset to PathStrokeMode_Tessellate by srBeginPath
+
+    /**
+     * @brief Drops the points of the flattened path that do not change it on screen, for polylines with far more points
+     * than pixels. Runs of points within one pixel column keep their first, lowest, highest and last point, then every
+     * point within the path tolerance of the remaining polyline is removed. Gets reset to false by srBeginPath
+     *
+     * @param enabled Default false
+     */
+    R_API void srPathSetSimplify(bool enabled);
 
     R_API PathBuilder::PathStyleIndex &srPathBuilderNewStyle();
 
+    struct PathCacheStats
+    {
+        uint64_t Hits = 0;
+        uint64_t Misses = 0;
+        size_t Bytes = 0;
+        unsigned int Entries = 0;
+    };
+
+    /**
+     * @brief srEndPath keeps the tessellated vertices of paths across frames. Paths with the same commands relative to their
+     * first point, the same styles and the same pixel scale are replayed with a translation instead of being tessellated again.
+     * Least recently used paths get evicted, when the cache grows over the budget.
+     *
+     * @param bytes Budget in bytes (default SR_PATH_CACHE_BUDGET). 0 disables the cache
+     */
+    R_API void srPathCacheSetBudget(size_t bytes);
+    R_API void srPathCacheClear();
+    R_API PathCacheStats srPathCacheGetStats();
+
+    /**
+     * @brief Paths with srPathSetSimplify and more points than the path cache takes keep their simplified points across
+     * frames, per zoom level. Least recently used paths get evicted, when the cache grows over the budget.
+     *
+     * @param bytes Budget in bytes (default SR_PATH_SIMPLIFY_CACHE_BUDGET). 0 disables the cache
+     */
+    R_API void srPathSimplifyCacheSetBudget(size_t bytes);
+    R_API void srPathSimplifyCacheClear();
+
     // Flushing path
     R_API void srAddPolyline(const PathBuilder &pathBuilder, bool closedPath);
     R_API void srAddPolyFilled(const PathBuilder &pathBuilder);
@@ -486,7 +798,16 @@ namespace sr
 
     R_API void srDrawTexturePro(Texture texture, const glm::vec2 &position, const Rectangle &rect, float rotation);
 
-    R_API void srDrawGrid(const glm::vec2 &position, unsigned int columns, unsigned int rows, float cellSizeX, float cellSizeY);
+    R_API void srDrawGrid(const glm::vec2 &position, unsigned int columns, unsigned int rows, float cellSizeX, float cellSizeY, float thickness = 1.0f, Color color = 0xffffffff);
+
+    /**
+     * @brief Draws a line as a single vertex of a SEGMENTS draw call. The quad around it and its anti aliased outline
+     * are computed on the gpu, so this costs a sixth of a tessellated stroke
+     *
+     * @param width Line width in units. Thinner lines than a pixel fade out instead
+     * @param cap   End of the line at both points
+     */
+    R_API void srDrawLineSegment(const glm::vec2 &p0, const glm::vec2 &p1, float width, Color color = 0xffffffff, LineCap_ cap = LineCap_Butt);
 
     // Fonts
 
@@ -500,14 +821,44 @@ namespace sr
         float u1;
         float v1;
         unsigned int CharCode;
+        unsigned int Page; // Of the shared atlas
+        int Bin;           // In the packer of the page, -1 for empty and evicted glyphs
+        uint32_t LastUsed; // Frame the glyph was last laid out or drawn in
+    };
+    struct FontCodepoint
+    {
+        uint32_t Codepoint; // 0 marks an empty slot
+        uint32_t Glyph;     // Index into FontTexture::Glyphs
+    };
+    struct FontKerning
+    {
+        uint32_t Pair; // (first + 1) << 16 | second, as indices into FontTexture::Glyphs. 0 marks an empty slot
+        int32_t X; // In 1/64 pixels of the face size, scaled with the font when it is used
     };
+    // The glyphs of a face. Their pixels live in the atlas pages shared by all faces
     struct FontTexture
     {
-        Texture Image;
-        glm::ivec2 Size;
-        uint8_t *ImageData;
-        void *ShelfPack; // For packing the glyphs
-        std::unordered_map<unsigned int, FontGlyph> CharMap;
+        std::vector<FontGlyph> Glyphs;
+        std::unordered_map<unsigned int, unsigned int> GlyphIndices; // FreeType glyph index to Glyphs, only used when loading
+        uint32_t Latin1[256];                                      // Glyphs + 1 of the first codepoints, 0 for control characters
+        std::vector<FontCodepoint> Codepoints;                     // Open addressing for the other codepoints. Size is a power of two
+        unsigned int CodepointCount;
+        std::vector<FontKerning> Kerning; // Open addressing for the pairs with a kerning. Size is a power of two
+        unsigned int KerningCount;
+    };
+
+    // A font file with its glyphs, shared by the fonts of every size loaded from it
+    struct FontFace
+    {
+        FT_Face Handle;      // Set to SR_FONT_SDF_SIZE
+        int Size;            // Of the glyphs in the texture
+        FontTexture Texture;
+        unsigned int References;
+
+        // Where the face was loaded from, so other threads can open their own instance
+        std::string FilePath;
+        const unsigned char *Data;
+        unsigned int DataSize;
     };
 
     struct Font
@@ -516,8 +867,8 @@ namespace sr
         int LineHeight;
         int LineTop;
         int LineBottom;
-        FT_Face Face;
-        FontTexture Texture;
+        float Scale; // From the glyphs of the face to this size
+        FontFace *Face;
     };
 
     typedef unsigned int FontHandle;
@@ -526,6 +877,24 @@ namespace sr
     R_API FontHandle srLoadFontFromMemory(const unsigned char *data, unsigned int data_size, unsigned int font_size = 24);
     R_API void srUnloadFont(FontHandle font);
 
+    /**
+     * @brief Lets srLoadFont keep the rendered glyphs of printable Latin-1, their metrics and their kerning in one file per
+     * font. Later loads of the same font data map the file and upload it, instead of rendering the glyphs again. Files of another version or font are ignored and replaced
+     *
+     * @param directory Existing directory for the cache files. nullptr or "" turns the cache off (default)
+     */
+    R_API void srFontSetCacheDirectory(const char *directory);
+
+    /**
+     * @brief Sets how many bytes of texture the glyph atlas may use. Glyphs of all fonts share pages of 2048x2048 texels,
+     * which are added when the others are full. Once another page would exceed the budget, the glyphs that were not used
+     * for the longest time make room and are rendered again when they come back. Glyphs used in the current frame are
+     * never evicted. A lower budget only applies when the atlas grows next
+     *
+     * @param bytes Budget in bytes (default SR_FONT_ATLAS_BUDGET). At least one page is always allocated
+     */
+    R_API void srFontSetAtlasBudget(size_t bytes);
+
     R_API int srFontGetTextWidth(FontHandle font, const char *text);
     R_API int srFontGetTextHeight(FontHandle font, const char *text);
     R_API glm::ivec2 srFontGetTextSize(FontHandle font, const char *text);
@@ -536,28 +905,51 @@ namespace sr
     R_API int srFontGetSize(FontHandle font);
     R_API const char *srFontGetName(FontHandle font);
 
-    R_API unsigned int srFontGetTextureId(FontHandle font);
+    // The glyphs of a font can sit on any page of the shared atlas. Pages are counted among those holding its glyphs
+    R_API unsigned int srFontGetAtlasPageCount(FontHandle font);
+    R_API unsigned int srFontGetTextureId(FontHandle font, unsigned int page = 0); // 0 when the font has no such page
+
+    /**
+     * @brief srDrawText and the text measuring functions keep the glyph quads of strings across frames. A string that is
+     * drawn or measured again with the same font is copied into the batch instead of being decoded, looked up and kerned
+     * again. Least recently used strings get evicted, when the cache grows over the budget.
+     *
+     * @param bytes Budget in bytes (default SR_TEXT_CACHE_BUDGET). 0 disables the cache
+     */
+    R_API void srTextCacheSetBudget(size_t bytes);
+    R_API void srTextCacheClear();
 
     R_API void srDrawText(FontHandle font, const char *text, const glm::vec2 &position, Color color = 0xff000000, float outline_thickness = 0.0f, Color outline_color = 0xff000000);
+    R_API void srDrawTextGradient(FontHandle font, const char *text, const glm::vec2 &position, GradientHandle gradient, float outline_thickness = 0.0f, Color outline_color = 0xff000000);
 
-    R_API void srDrawCircle(const glm::vec2 &center, float radius, Color color = 0xffffffff, unsigned int segmentCount = 36);
-    R_API void srDrawCircleOutline(const glm::vec2 &center, float radius, float thickness, Color color = 0xffffffff, unsigned int segmentCount = 36);
-    R_API void srDrawArc(const glm::vec2 &center, float startAngle, float endAngle, float radius, Color color = 0xffffffff, unsigned int segmentCount = 22);
+    // A segmentCount of 0 derives the count from the radius on screen and the path tolerance
+    R_API void srDrawCircle(const glm::vec2 &center, float radius, Color color = 0xffffffff, unsigned int segmentCount = 0);
+    R_API void srDrawCircleOutline(const glm::vec2 &center, float radius, float thickness, Color color = 0xffffffff, unsigned int segmentCount = 0);
+    R_API void srDrawArc(const glm::vec2 &center, float startAngle, float endAngle, float radius, Color color = 0xffffffff, unsigned int segmentCount = 0);
 
     struct SRContext
     {
         RenderBatch MainRenderBatch;
         Shader DefaultShader;
         Shader DistanceFieldShader;
+        Shader DashShader; // Strokes with the arc length in TexCoord.x and the dash pattern in Normal.xy
+        Shader GradientShader; // Paths with a gradient in Normal.z. Draws dashes like the DashShader
+        Shader TimeSeriesShader; // Instanced segments of srDrawTimeSeries
+        Shader SegmentShader;    // SEGMENTS draw calls. Point, offset to the second point, width and caps per vertex
         std::vector<Mesh> AutoReleaseMeshes;
         glm::mat4 CurrentProjection;
-        
+        float PathTolerance = 0.25f; // Max flattening error in pixels
+        bool AntiAliasing = false;   // One pixel fringe around paths
+        bool DeferredPaths = false;  // srEndPath queues paths for the path workers
 
         // Scissoring
         ScissorTest Scissor;
+        StencilMode_ Stencil; // Stencil mode for the next srBegin
         // This will get updated every call to newFrame
         float ScissorScale; // When window width != viewport width (ie. on mac with retina display)
         float WindowHeight; // For flipping the scissor, because Ortho matrix is up = 0 and scissor coords is bottom = 0
+        float FrameWidth;
+        float FrameHeight;
     };
 
 }
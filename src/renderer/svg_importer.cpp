@@ -0,0 +1,1554 @@
+#include "../pch.h"
+#include "renderer.h"
+
+#include <string.h>
+
+// Streaming SVG import
+//
+// The document is scanned tag by tag, without building a tree. Every shape is turned into absolute path commands
+// that go to a sink: either straight into the srPath functions or into the compiled binary form. The state
+// inherited through groups lives in a fixed stack, so parsing itself allocates nothing.
+
+namespace sr
+{
+  struct SvgView
+  {
+    const char *Begin = NULL;
+    const char *End = NULL;
+
+    bool Empty() const { return Begin == End; }
+    bool Equals(const char *text) const
+    {
+      const size_t length = strlen(text);
+      return (size_t)(End - Begin) == length && memcmp(Begin, text, length) == 0;
+    }
+  };
+
+  // x' = A * x + C * y + E, y' = B * x + D * y + F. Same order as the matrix() transform
+  struct SvgTransform
+  {
+    float A = 1.0f, B = 0.0f, C = 0.0f, D = 1.0f, E = 0.0f, F = 0.0f;
+
+    glm::vec2 Apply(const glm::vec2 &p) const { return glm::vec2(A * p.x + C * p.y + E, B * p.x + D * p.y + F); }
+    float Determinant() const { return A * D - B * C; }
+  };
+
+  static SvgTransform operator*(const SvgTransform &m, const SvgTransform &n)
+  {
+    SvgTransform result;
+    result.A = m.A * n.A + m.C * n.B;
+    result.B = m.B * n.A + m.D * n.B;
+    result.C = m.A * n.C + m.C * n.D;
+    result.D = m.B * n.C + m.D * n.D;
+    result.E = m.A * n.E + m.C * n.F + m.E;
+    result.F = m.B * n.E + m.D * n.F + m.F;
+    return result;
+  }
+
+  // Number parsing
+
+  static bool SvgIsSpace(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+  }
+
+  static bool SvgIsDigit(char c)
+  {
+    return c >= '0' && c <= '9';
+  }
+
+  static const char *SvgSkipSpace(const char *p, const char *end)
+  {
+    while (p < end && SvgIsSpace(*p))
+    {
+      p++;
+    }
+    return p;
+  }
+
+  // White space with at most one comma
+  static const char *SvgSkipSeparator(const char *p, const char *end)
+  {
+    p = SvgSkipSpace(p, end);
+    if (p < end && *p == ',')
+    {
+      p = SvgSkipSpace(p + 1, end);
+    }
+    return p;
+  }
+
+  // Locale independent and without the zero termination strtof needs. Returns NULL when there is no number
+  static const char *SvgParseNumber(const char *p, const char *end, float *out)
+  {
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-'))
+    {
+      negative = *p == '-';
+      p++;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool digits = false;
+    for (; p < end && SvgIsDigit(*p); p++, digits = true)
+    {
+      if (mantissa < 100000000000000000ull)
+        mantissa = mantissa * 10 + (*p - '0');
+      else
+        exponent++;
+    }
+    if (p < end && *p == '.')
+    {
+      for (p++; p < end && SvgIsDigit(*p); p++, digits = true)
+      {
+        if (mantissa < 100000000000000000ull)
+        {
+          mantissa = mantissa * 10 + (*p - '0');
+          exponent--;
+        }
+      }
+    }
+    if (!digits)
+    {
+      return NULL;
+    }
+
+    // An e without digits belongs to a unit like em
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+      const char *e = p + 1;
+      bool negativeExponent = false;
+      if (e < end && (*e == '+' || *e == '-'))
+      {
+        negativeExponent = *e == '-';
+        e++;
+      }
+      if (e < end && SvgIsDigit(*e))
+      {
+        int value = 0;
+        for (; e < end && SvgIsDigit(*e); e++)
+        {
+          value = srMin(value * 10 + (*e - '0'), 1000);
+        }
+        exponent += negativeExponent ? -value : value;
+        p = e;
+      }
+    }
+
+    double result = (double)mantissa;
+    if (mantissa != 0 && exponent != 0)
+    {
+      const int magnitude = exponent < 0 ? -exponent : exponent;
+      const double scale = magnitude < 23 ? powers[magnitude] : pow(10.0, magnitude);
+      result = exponent < 0 ? result / scale : result * scale;
+    }
+    *out = (float)(negative ? -result : result);
+    return p;
+  }
+
+  static bool SvgViewToNumber(const SvgView &view, float *out)
+  {
+    const char *p = SvgSkipSpace(view.Begin, view.End);
+    return SvgParseNumber(p, view.End, out) != NULL;
+  }
+
+  static float SvgViewToNumber(const SvgView &view, float fallback)
+  {
+    float value = fallback;
+    return SvgViewToNumber(view, &value) ? value : fallback;
+  }
+
+  // Path output
+
+  // Shape as it is handed to a sink
+  struct SvgShape
+  {
+    PathType Type;
+    PathStyle Style;
+    FillRule_ Rule;
+  };
+
+  // Draws into the path builder
+  struct SvgPathSink
+  {
+    void Begin(const SvgShape &shape)
+    {
+      srBeginPath(shape.Type);
+      srPathSetStyle(shape.Style);
+      srPathSetFillRule(shape.Rule);
+    }
+    void End(bool closed) { srEndPath(closed); }
+    void MoveTo(const glm::vec2 &p) { srPathMoveTo(p); }
+    void LineTo(const glm::vec2 &p) { srPathLineTo(p); }
+    void CubicTo(const glm::vec2 &c1, const glm::vec2 &c2, const glm::vec2 &p) { srPathCubicBezierTo(c1, c2, p); }
+    void QuadraticTo(const glm::vec2 &c, const glm::vec2 &p) { srPathQuadraticBezierTo(c, p); }
+    void ArcTo(const glm::vec2 &p, float angle, float rx, float ry, bool largeArc, bool sweep) { srPathEllipticalArc(p, angle, rx, ry, largeArc, sweep); }
+  };
+
+  // Compiled form. A header followed by records, each starting with its op. All values are little endian
+  enum SvgOp_ : uint8_t
+  {
+    SvgOp_Begin = 1, // PathType u8, FillRule u8, style
+    SvgOp_End,       // Closed u8
+    SvgOp_MoveTo,    // Point
+    SvgOp_LineTo,    // Point
+    SvgOp_CubicTo,   // Control 1, control 2, point
+    SvgOp_QuadraticTo, // Control, point
+    SvgOp_ArcTo      // Point, angle f32, radii f32 f32, flags u8 (1 large arc, 2 sweep)
+  };
+
+  static const char SvgCompiledMagic[4] = {'S', 'R', 'S', 'V'};
+  static const uint32_t SvgCompiledVersion = 1;
+
+  struct SvgCompileSink
+  {
+    std::vector<uint8_t> &Out;
+
+    void Write(const void *data, size_t size)
+    {
+      const uint8_t *bytes = (const uint8_t *)data;
+      Out.insert(Out.end(), bytes, bytes + size);
+    }
+    void Op(SvgOp_ op) { Out.push_back(op); }
+    void U8(uint8_t value) { Out.push_back(value); }
+    void U32(uint32_t value)
+    {
+      const uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+      Write(bytes, sizeof(bytes));
+    }
+    void F32(float value)
+    {
+      uint32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      U32(bits);
+    }
+    void Point(const glm::vec2 &p)
+    {
+      F32(p.x);
+      F32(p.y);
+    }
+
+    void Begin(const SvgShape &shape)
+    {
+      Op(SvgOp_Begin);
+      U8((uint8_t)shape.Type);
+      U8((uint8_t)shape.Rule);
+      F32(shape.Style.StrokeWidth);
+      U32(shape.Style.StrokeColor);
+      U32(shape.Style.FillColor);
+      U8((uint8_t)shape.Style.LineJoin);
+      U8((uint8_t)shape.Style.LineCap);
+      F32(shape.Style.MiterLimit);
+      F32(shape.Style.DashLength);
+      F32(shape.Style.DashGap);
+      F32(shape.Style.DashOffset);
+    }
+    void End(bool closed)
+    {
+      Op(SvgOp_End);
+      U8(closed ? 1 : 0);
+    }
+    void MoveTo(const glm::vec2 &p)
+    {
+      Op(SvgOp_MoveTo);
+      Point(p);
+    }
+    void LineTo(const glm::vec2 &p)
+    {
+      Op(SvgOp_LineTo);
+      Point(p);
+    }
+    void CubicTo(const glm::vec2 &c1, const glm::vec2 &c2, const glm::vec2 &p)
+    {
+      Op(SvgOp_CubicTo);
+      Point(c1);
+      Point(c2);
+      Point(p);
+    }
+    void QuadraticTo(const glm::vec2 &c, const glm::vec2 &p)
+    {
+      Op(SvgOp_QuadraticTo);
+      Point(c);
+      Point(p);
+    }
+    void ArcTo(const glm::vec2 &p, float angle, float rx, float ry, bool largeArc, bool sweep)
+    {
+      Op(SvgOp_ArcTo);
+      Point(p);
+      F32(angle);
+      F32(rx);
+      F32(ry);
+      U8((largeArc ? 1 : 0) | (sweep ? 2 : 0));
+    }
+  };
+
+  // Takes absolute coordinates in the space of the current element and hands them transformed to the sink
+  template <typename Sink>
+  struct SvgPathWriter
+  {
+    Sink &Output;
+    const SvgTransform &Transform;
+
+    void MoveTo(const glm::vec2 &p) { Output.MoveTo(Transform.Apply(p)); }
+    void LineTo(const glm::vec2 &p) { Output.LineTo(Transform.Apply(p)); }
+    void CubicTo(const glm::vec2 &c1, const glm::vec2 &c2, const glm::vec2 &p) { Output.CubicTo(Transform.Apply(c1), Transform.Apply(c2), Transform.Apply(p)); }
+    void QuadraticTo(const glm::vec2 &c, const glm::vec2 &p) { Output.QuadraticTo(Transform.Apply(c), Transform.Apply(p)); }
+
+    void ArcTo(const glm::vec2 &from, const glm::vec2 &p, float angle, float rx, float ry, bool largeArc, bool sweep)
+    {
+      rx = srAbs(rx);
+      ry = srAbs(ry);
+      if (p == from)
+      {
+        return;
+      }
+      if (rx == 0.0f || ry == 0.0f)
+      {
+        LineTo(p);
+        return;
+      }
+
+      // The transformed ellipse is the image of the unit circle under M = T * R(angle) * S(rx, ry).
+      // Its axes and radii come from the singular value decomposition of M
+      const float radians = angle * (float)DEG2RAD;
+      const float cosAngle = cosf(radians);
+      const float sinAngle = sinf(radians);
+      const float m00 = (Transform.A * cosAngle + Transform.C * sinAngle) * rx;
+      const float m01 = (Transform.C * cosAngle - Transform.A * sinAngle) * ry;
+      const float m10 = (Transform.B * cosAngle + Transform.D * sinAngle) * rx;
+      const float m11 = (Transform.D * cosAngle - Transform.B * sinAngle) * ry;
+
+      const float e = (m00 + m11) * 0.5f;
+      const float f = (m00 - m11) * 0.5f;
+      const float g = (m10 + m01) * 0.5f;
+      const float h = (m10 - m01) * 0.5f;
+      const float q = sqrtf(e * e + h * h);
+      const float r = sqrtf(f * f + g * g);
+      const float rotation = (atan2f(g, f) + atan2f(h, e)) * 0.5f;
+
+      // A mirroring transform turns the sweep direction around
+      const bool mirrored = Transform.Determinant() < 0.0f;
+      Output.ArcTo(Transform.Apply(p), rotation * (float)RAD2DEG, q + r, srAbs(q - r), largeArc, mirrored ? !sweep : sweep);
+    }
+  };
+
+  // Path data
+
+  static const char *SvgParseFlag(const char *p, const char *end, bool *out)
+  {
+    if (p >= end || (*p != '0' && *p != '1'))
+    {
+      return NULL;
+    }
+    *out = *p == '1';
+    return SvgSkipSeparator(p + 1, end);
+  }
+
+  // Reads count numbers separated by white space or commas
+  static const char *SvgParseNumbers(const char *p, const char *end, float *out, int count)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      p = SvgParseNumber(p, end, out + i);
+      if (!p)
+      {
+        return NULL;
+      }
+      p = SvgSkipSeparator(p, end);
+    }
+    return p;
+  }
+
+  // Strokes of paths with open and closed subpaths get the closing lines drawn with caps
+  static bool SvgPathIsClosed(const SvgView &data)
+  {
+    bool drawn = false;
+    bool closed = false;
+    for (const char *p = data.Begin; p < data.End; p++)
+    {
+      switch (*p)
+      {
+      case 'M':
+      case 'm':
+        if (drawn && !closed)
+        {
+          return false;
+        }
+        drawn = false;
+        closed = false;
+        break;
+      case 'Z':
+      case 'z':
+        closed = true;
+        break;
+      case 'e':
+      case 'E':
+        break;
+      default:
+        if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z'))
+        {
+          drawn = true;
+          closed = false;
+        }
+        break;
+      }
+    }
+    return drawn && closed;
+  }
+
+  template <typename Sink>
+  static bool SvgParsePathData(SvgPathWriter<Sink> &writer, const char *p, const char *end)
+  {
+    glm::vec2 current(0.0f);
+    glm::vec2 start(0.0f);
+    glm::vec2 lastControl(0.0f); // Second control point of the last curve, for the smooth curve commands
+    char lastCommand = 0;
+    char command = 0;
+    bool started = false;   // A move to was written
+    bool needsMove = false; // Drawing after a close starts a new subpath at the start point
+
+    p = SvgSkipSpace(p, end);
+    while (p < end)
+    {
+      const char c = *p;
+      if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+      {
+        command = c;
+        p = SvgSkipSpace(p + 1, end);
+      }
+      else if (command == 0 || command == 'Z' || command == 'z')
+      {
+        return false; // Numbers without a command
+      }
+
+      const bool relative = command >= 'a';
+      const glm::vec2 origin = relative ? current : glm::vec2(0.0f);
+      const char upper = relative ? command - ('a' - 'A') : command;
+      if (upper != 'M' && upper != 'Z')
+      {
+        if (!started)
+        {
+          return false; // Path data has to start with a move to
+        }
+        if (needsMove)
+        {
+          writer.MoveTo(current);
+          needsMove = false;
+        }
+      }
+
+      float v[7];
+      switch (upper)
+      {
+      case 'M':
+        if (!(p = SvgParseNumbers(p, end, v, 2)))
+          return false;
+        current = origin + glm::vec2(v[0], v[1]);
+        start = current;
+        writer.MoveTo(current);
+        started = true;
+        needsMove = false;
+        command = relative ? 'l' : 'L'; // Following pairs are lines
+        break;
+      case 'L':
+        if (!(p = SvgParseNumbers(p, end, v, 2)))
+          return false;
+        current = origin + glm::vec2(v[0], v[1]);
+        writer.LineTo(current);
+        break;
+      case 'H':
+        if (!(p = SvgParseNumbers(p, end, v, 1)))
+          return false;
+        current.x = origin.x + v[0];
+        writer.LineTo(current);
+        break;
+      case 'V':
+        if (!(p = SvgParseNumbers(p, end, v, 1)))
+          return false;
+        current.y = origin.y + v[0];
+        writer.LineTo(current);
+        break;
+      case 'C':
+      case 'S':
+      {
+        glm::vec2 control1 = current;
+        if (upper == 'C')
+        {
+          if (!(p = SvgParseNumbers(p, end, v, 6)))
+            return false;
+          control1 = origin + glm::vec2(v[0], v[1]);
+        }
+        else
+        {
+          if (!(p = SvgParseNumbers(p, end, v + 2, 4)))
+            return false;
+          if (lastCommand == 'C' || lastCommand == 'S')
+            control1 = current * 2.0f - lastControl;
+        }
+        lastControl = origin + glm::vec2(v[2], v[3]);
+        current = origin + glm::vec2(v[4], v[5]);
+        writer.CubicTo(control1, lastControl, current);
+        break;
+      }
+      case 'Q':
+      case 'T':
+      {
+        glm::vec2 control = current;
+        if (upper == 'Q')
+        {
+          if (!(p = SvgParseNumbers(p, end, v, 4)))
+            return false;
+          control = origin + glm::vec2(v[0], v[1]);
+        }
+        else
+        {
+          if (!(p = SvgParseNumbers(p, end, v + 2, 2)))
+            return false;
+          if (lastCommand == 'Q' || lastCommand == 'T')
+            control = current * 2.0f - lastControl;
+        }
+        lastControl = control;
+        current = origin + glm::vec2(v[2], v[3]);
+        writer.QuadraticTo(control, current);
+        break;
+      }
+      case 'A':
+      {
+        bool largeArc = false;
+        bool sweep = false;
+        if (!(p = SvgParseNumbers(p, end, v, 3)) || !(p = SvgParseFlag(p, end, &largeArc)) ||
+            !(p = SvgParseFlag(p, end, &sweep)) || !(p = SvgParseNumbers(p, end, v + 3, 2)))
+          return false;
+        const glm::vec2 from = current;
+        current = origin + glm::vec2(v[3], v[4]);
+        writer.ArcTo(from, current, v[2], v[0], v[1], largeArc, sweep);
+        break;
+      }
+      case 'Z':
+        if (started && !needsMove)
+        {
+          writer.LineTo(start);
+        }
+        current = start;
+        needsMove = true;
+        break;
+      default:
+        return false;
+      }
+      lastCommand = upper;
+    }
+    return true;
+  }
+
+  // Document state inherited through groups
+
+  struct SvgState
+  {
+    SvgTransform Transform;
+    Color Fill = 0xff000000;
+    Color Stroke = 0xff000000;
+    Color Current = 0xff000000; // The color property, used by currentColor
+    bool HasFill = true;
+    bool HasStroke = false;
+    bool FillIsCurrent = false; // Resolved when the shape is drawn, so a color set later on the element still counts
+    bool StrokeIsCurrent = false;
+    float FillOpacity = 1.0f;
+    float StrokeOpacity = 1.0f;
+    float Opacity = 1.0f; // Group opacity, applied to every shape
+    float StrokeWidth = 1.0f;
+    LineJoin_ LineJoin = LineJoin_Miter;
+    LineCap_ LineCap = LineCap_Butt;
+    float MiterLimit = 4.0f;
+    float DashLength = 0.0f;
+    float DashGap = 0.0f;
+    float DashOffset = 0.0f;
+    FillRule_ Rule = FillRule_NonZero;
+    bool Hidden = false; // Inside definitions or display none
+  };
+
+  static const unsigned int SVG_MAX_DEPTH = 64;
+
+  static Color SvgRGB(unsigned int r, unsigned int g, unsigned int b)
+  {
+    return 0xff000000 | (b << 16) | (g << 8) | r;
+  }
+
+  static int SvgHexDigit(char c)
+  {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  }
+
+  // Colors as #rgb, #rrggbb, rgb(r, g, b) and the basic keywords. Returns false for none and everything unsupported
+  static bool SvgParseColor(SvgView value, Color *out)
+  {
+    value.Begin = SvgSkipSpace(value.Begin, value.End);
+    while (value.End > value.Begin && SvgIsSpace(value.End[-1]))
+    {
+      value.End--;
+    }
+
+    const size_t length = value.End - value.Begin;
+    if (length > 0 && value.Begin[0] == '#')
+    {
+      int digits[6];
+      for (size_t i = 1; i < length && i <= 6; i++)
+      {
+        digits[i - 1] = SvgHexDigit(value.Begin[i]);
+        if (digits[i - 1] < 0)
+          return false;
+      }
+      if (length == 4)
+      {
+        *out = SvgRGB(digits[0] * 17, digits[1] * 17, digits[2] * 17);
+        return true;
+      }
+      if (length == 7)
+      {
+        *out = SvgRGB(digits[0] * 16 + digits[1], digits[2] * 16 + digits[3], digits[4] * 16 + digits[5]);
+        return true;
+      }
+      return false;
+    }
+
+    if (length > 4 && memcmp(value.Begin, "rgb(", 4) == 0)
+    {
+      const char *p = value.Begin + 4;
+      unsigned int channels[3];
+      for (unsigned int &channel : channels)
+      {
+        float number = 0.0f;
+        p = SvgParseNumber(SvgSkipSpace(p, value.End), value.End, &number);
+        if (!p)
+          return false;
+        if (p < value.End && *p == '%')
+        {
+          number *= 2.55f;
+          p++;
+        }
+        channel = (unsigned int)srClamp(number + 0.5f, 0.0f, 255.0f);
+        p = SvgSkipSeparator(p, value.End);
+      }
+      *out = SvgRGB(channels[0], channels[1], channels[2]);
+      return true;
+    }
+
+    // Paint servers (gradients, patterns) are not supported. Use their fallback color if there is one
+    if (length > 4 && memcmp(value.Begin, "url(", 4) == 0)
+    {
+      const char *close = (const char *)memchr(value.Begin, ')', length);
+      return close && SvgParseColor({close + 1, value.End}, out);
+    }
+
+    static const struct
+    {
+      const char *Name;
+      Color Value;
+    } keywords[] = {
+        {"black", SvgRGB(0, 0, 0)},
+        {"white", SvgRGB(255, 255, 255)},
+        {"red", SvgRGB(255, 0, 0)},
+        {"green", SvgRGB(0, 128, 0)},
+        {"lime", SvgRGB(0, 255, 0)},
+        {"blue", SvgRGB(0, 0, 255)},
+        {"yellow", SvgRGB(255, 255, 0)},
+        {"cyan", SvgRGB(0, 255, 255)},
+        {"magenta", SvgRGB(255, 0, 255)},
+        {"gray", SvgRGB(128, 128, 128)},
+        {"grey", SvgRGB(128, 128, 128)},
+        {"silver", SvgRGB(192, 192, 192)},
+        {"orange", SvgRGB(255, 165, 0)},
+        {"purple", SvgRGB(128, 0, 128)},
+        {"brown", SvgRGB(165, 42, 42)},
+        {"navy", SvgRGB(0, 0, 128)},
+    };
+    for (const auto &keyword : keywords)
+    {
+      if (value.Equals(keyword.Name))
+      {
+        *out = keyword.Value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static const char *SvgParseTransformName(const char *p, const char *end, SvgView *name)
+  {
+    name->Begin = p;
+    while (p < end && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')))
+    {
+      p++;
+    }
+    name->End = p;
+    return p;
+  }
+
+  // transform="translate(10 20) rotate(45)"
+  static SvgTransform SvgParseTransform(const SvgView &value)
+  {
+    SvgTransform result;
+    const char *p = value.Begin;
+    const char *end = value.End;
+    while (true)
+    {
+      p = SvgSkipSeparator(p, end);
+      SvgView name;
+      p = SvgSkipSpace(SvgParseTransformName(p, end, &name), end);
+      if (name.Empty() || p >= end || *p != '(')
+      {
+        break;
+      }
+      p = SvgSkipSpace(p + 1, end);
+
+      float v[6] = {0.0f};
+      int count = 0;
+      while (p < end && *p != ')' && count < 6)
+      {
+        const char *next = SvgParseNumber(p, end, v + count);
+        if (!next)
+          break;
+        count++;
+        p = SvgSkipSeparator(next, end);
+      }
+      p = (const char *)memchr(p, ')', end - p);
+      if (!p)
+      {
+        break;
+      }
+      p++;
+
+      SvgTransform t;
+      if (name.Equals("matrix") && count == 6)
+      {
+        t = {v[0], v[1], v[2], v[3], v[4], v[5]};
+      }
+      else if (name.Equals("translate") && count >= 1)
+      {
+        t.E = v[0];
+        t.F = count > 1 ? v[1] : 0.0f;
+      }
+      else if (name.Equals("scale") && count >= 1)
+      {
+        t.A = v[0];
+        t.D = count > 1 ? v[1] : v[0];
+      }
+      else if (name.Equals("rotate") && count >= 1)
+      {
+        const float radians = v[0] * (float)DEG2RAD;
+        SvgTransform rotation = {cosf(radians), sinf(radians), -sinf(radians), cosf(radians), 0.0f, 0.0f};
+        if (count == 3)
+        {
+          // Around (cx, cy)
+          rotation = SvgTransform{1, 0, 0, 1, v[1], v[2]} * rotation * SvgTransform{1, 0, 0, 1, -v[1], -v[2]};
+        }
+        t = rotation;
+      }
+      else if (name.Equals("skewX") && count >= 1)
+      {
+        t.C = tanf(v[0] * (float)DEG2RAD);
+      }
+      else if (name.Equals("skewY") && count >= 1)
+      {
+        t.B = tanf(v[0] * (float)DEG2RAD);
+      }
+      result = result * t;
+    }
+    return result;
+  }
+
+  static void SvgParseDashArray(SvgState &state, const SvgView &value)
+  {
+    float v[2] = {0.0f, 0.0f};
+    const char *p = SvgSkipSpace(value.Begin, value.End);
+    int count = 0;
+    for (; count < 2; count++)
+    {
+      p = SvgParseNumber(p, value.End, v + count);
+      if (!p)
+        break;
+      p = SvgSkipSeparator(p, value.End);
+    }
+    // Odd lists repeat. Only the first dash and gap are used
+    state.DashLength = count > 0 ? v[0] : 0.0f;
+    state.DashGap = count > 1 ? v[1] : state.DashLength;
+  }
+
+  // Presentation attribute or style declaration
+  // A fill or stroke. currentColor, also as the fallback of a paint server, sets isCurrent instead of the color
+  static bool SvgParsePaint(SvgView value, Color *out, bool *isCurrent)
+  {
+    value.Begin = SvgSkipSpace(value.Begin, value.End);
+    while (value.End > value.Begin && SvgIsSpace(value.End[-1]))
+    {
+      value.End--;
+    }
+    if (value.End - value.Begin > 4 && memcmp(value.Begin, "url(", 4) == 0)
+    {
+      const char *close = (const char *)memchr(value.Begin, ')', value.End - value.Begin);
+      value.Begin = close ? SvgSkipSpace(close + 1, value.End) : value.End;
+    }
+
+    *isCurrent = value.Equals("currentColor");
+    return *isCurrent || SvgParseColor(value, out);
+  }
+
+  static void SvgApplyProperty(SvgState &state, const SvgView &name, const SvgView &value)
+  {
+    if (name.Equals("fill"))
+    {
+      state.HasFill = SvgParsePaint(value, &state.Fill, &state.FillIsCurrent);
+    }
+    else if (name.Equals("stroke"))
+    {
+      state.HasStroke = SvgParsePaint(value, &state.Stroke, &state.StrokeIsCurrent);
+    }
+    else if (name.Equals("color"))
+    {
+      SvgParseColor(value, &state.Current);
+    }
+    else if (name.Equals("stroke-width"))
+    {
+      state.StrokeWidth = SvgViewToNumber(value, state.StrokeWidth);
+    }
+    else if (name.Equals("fill-opacity"))
+    {
+      state.FillOpacity = srClamp(SvgViewToNumber(value, 1.0f), 0.0f, 1.0f);
+    }
+    else if (name.Equals("stroke-opacity"))
+    {
+      state.StrokeOpacity = srClamp(SvgViewToNumber(value, 1.0f), 0.0f, 1.0f);
+    }
+    else if (name.Equals("opacity"))
+    {
+      state.Opacity *= srClamp(SvgViewToNumber(value, 1.0f), 0.0f, 1.0f);
+    }
+    else if (name.Equals("fill-rule"))
+    {
+      state.Rule = SvgView{SvgSkipSpace(value.Begin, value.End), value.End}.Equals("evenodd") ? FillRule_EvenOdd : FillRule_NonZero;
+    }
+    else if (name.Equals("stroke-linejoin"))
+    {
+      const SvgView join{SvgSkipSpace(value.Begin, value.End), value.End};
+      state.LineJoin = join.Equals("round") ? LineJoin_Round : (join.Equals("bevel") ? LineJoin_Bevel : LineJoin_Miter);
+    }
+    else if (name.Equals("stroke-linecap"))
+    {
+      const SvgView cap{SvgSkipSpace(value.Begin, value.End), value.End};
+      state.LineCap = cap.Equals("round") ? LineCap_Round : (cap.Equals("square") ? LineCap_Square : LineCap_Butt);
+    }
+    else if (name.Equals("stroke-miterlimit"))
+    {
+      state.MiterLimit = SvgViewToNumber(value, state.MiterLimit);
+    }
+    else if (name.Equals("stroke-dasharray"))
+    {
+      SvgParseDashArray(state, value);
+    }
+    else if (name.Equals("stroke-dashoffset"))
+    {
+      state.DashOffset = SvgViewToNumber(value, 0.0f);
+    }
+    else if (name.Equals("display") || name.Equals("visibility"))
+    {
+      const SvgView mode{SvgSkipSpace(value.Begin, value.End), value.End};
+      state.Hidden = state.Hidden || mode.Equals("none") || mode.Equals("hidden");
+    }
+  }
+
+  // style="fill: red; stroke: blue"
+  static void SvgApplyStyle(SvgState &state, const SvgView &style)
+  {
+    const char *p = style.Begin;
+    while (p < style.End)
+    {
+      const char *colon = (const char *)memchr(p, ':', style.End - p);
+      if (!colon)
+      {
+        break;
+      }
+      const char *semicolon = (const char *)memchr(colon, ';', style.End - colon);
+      const char *valueEnd = semicolon ? semicolon : style.End;
+
+      SvgView name{SvgSkipSpace(p, colon), colon};
+      while (name.End > name.Begin && SvgIsSpace(name.End[-1]))
+      {
+        name.End--;
+      }
+      SvgApplyProperty(state, name, {colon + 1, valueEnd});
+      p = semicolon ? semicolon + 1 : style.End;
+    }
+  }
+
+  static Color SvgColorWithOpacity(Color color, float opacity)
+  {
+    const unsigned int alpha = (unsigned int)((color >> 24) * opacity + 0.5f);
+    return (color & 0x00ffffff) | (alpha << 24);
+  }
+
+  static bool SvgGetShape(const SvgState &state, bool fillable, SvgShape *shape)
+  {
+    // Widths scale with the average scale of the transform
+    const float scale = sqrtf(srAbs(state.Transform.Determinant()));
+
+    shape->Type = 0;
+    if (fillable && state.HasFill && state.FillOpacity * state.Opacity > 0.0f)
+    {
+      shape->Type |= PathType_Fill;
+    }
+    if (state.HasStroke && state.StrokeWidth > 0.0f && state.StrokeOpacity * state.Opacity > 0.0f)
+    {
+      shape->Type |= PathType_Stroke;
+    }
+
+    shape->Rule = state.Rule;
+    shape->Style.FillColor = SvgColorWithOpacity(state.FillIsCurrent ? state.Current : state.Fill, state.FillOpacity * state.Opacity);
+    shape->Style.StrokeColor = SvgColorWithOpacity(state.StrokeIsCurrent ? state.Current : state.Stroke, state.StrokeOpacity * state.Opacity);
+    shape->Style.StrokeWidth = state.StrokeWidth * scale;
+    shape->Style.LineJoin = state.LineJoin;
+    shape->Style.LineCap = state.LineCap;
+    shape->Style.MiterLimit = srMax(state.MiterLimit, 1.0f);
+    shape->Style.DashLength = state.DashLength * scale;
+    shape->Style.DashGap = state.DashGap * scale;
+    shape->Style.DashOffset = state.DashOffset * scale;
+    return shape->Type != 0 && !state.Hidden;
+  }
+
+  // Document
+
+  // Geometry attributes of the element that is parsed
+  struct SvgElement
+  {
+    SvgView Name;
+    SvgView D, Points, X, Y, Width, Height, Rx, Ry, Cx, Cy, R, X1, Y1, X2, Y2;
+    SvgView ViewBox, PreserveAspectRatio;
+    SvgView Style;
+  };
+
+  static bool SvgIsGeometryAttribute(SvgElement &element, const SvgView &name, const SvgView &value)
+  {
+    SvgView *target = NULL;
+    if (name.Equals("d"))
+      target = &element.D;
+    else if (name.Equals("points"))
+      target = &element.Points;
+    else if (name.Equals("x"))
+      target = &element.X;
+    else if (name.Equals("y"))
+      target = &element.Y;
+    else if (name.Equals("width"))
+      target = &element.Width;
+    else if (name.Equals("height"))
+      target = &element.Height;
+    else if (name.Equals("rx"))
+      target = &element.Rx;
+    else if (name.Equals("ry"))
+      target = &element.Ry;
+    else if (name.Equals("cx"))
+      target = &element.Cx;
+    else if (name.Equals("cy"))
+      target = &element.Cy;
+    else if (name.Equals("r"))
+      target = &element.R;
+    else if (name.Equals("x1"))
+      target = &element.X1;
+    else if (name.Equals("y1"))
+      target = &element.Y1;
+    else if (name.Equals("x2"))
+      target = &element.X2;
+    else if (name.Equals("y2"))
+      target = &element.Y2;
+    else if (name.Equals("viewBox"))
+      target = &element.ViewBox;
+    else if (name.Equals("preserveAspectRatio"))
+      target = &element.PreserveAspectRatio;
+    else if (name.Equals("style"))
+      target = &element.Style;
+
+    if (target)
+    {
+      *target = value;
+    }
+    return target != NULL;
+  }
+
+  static const char *SvgFind(const char *p, const char *end, const char *pattern)
+  {
+    const size_t length = strlen(pattern);
+    for (; p + length <= end; p++)
+    {
+      if (memcmp(p, pattern, length) == 0)
+      {
+        return p + length;
+      }
+    }
+    return NULL;
+  }
+
+  // Width or height of an svg element in user units. Percentages and missing values take the fallback
+  static float SvgParseViewportLength(const SvgView &value, float fallback)
+  {
+    float number = 0.0f;
+    const char *p = SvgParseNumber(SvgSkipSpace(value.Begin, value.End), value.End, &number);
+    if (!p)
+    {
+      return fallback;
+    }
+
+    SvgView unit{p, value.End};
+    while (unit.End > unit.Begin && SvgIsSpace(unit.End[-1]))
+    {
+      unit.End--;
+    }
+    static const struct
+    {
+      const char *Name;
+      float Scale;
+    } units[] = {{"", 1.0f}, {"px", 1.0f}, {"in", 96.0f}, {"cm", 96.0f / 2.54f}, {"mm", 96.0f / 25.4f}, {"pt", 96.0f / 72.0f}, {"pc", 16.0f}};
+    for (const auto &entry : units)
+    {
+      if (unit.Equals(entry.Name))
+      {
+        return number * entry.Scale;
+      }
+    }
+    return fallback;
+  }
+
+  // Maps the viewBox of an svg element into its viewport. Nested svg elements are moved by their x and y
+  static SvgTransform SvgViewportTransform(const SvgElement &element, bool root)
+  {
+    SvgTransform result;
+    if (!root)
+    {
+      result.E = SvgViewToNumber(element.X, 0.0f);
+      result.F = SvgViewToNumber(element.Y, 0.0f);
+    }
+
+    float box[4];
+    const char *p = element.ViewBox.Begin;
+    for (float &value : box)
+    {
+      p = p ? SvgParseNumber(SvgSkipSeparator(p, element.ViewBox.End), element.ViewBox.End, &value) : NULL;
+    }
+    if (!p || box[2] <= 0.0f || box[3] <= 0.0f)
+    {
+      return result;
+    }
+
+    const float width = SvgParseViewportLength(element.Width, box[2]);
+    const float height = SvgParseViewportLength(element.Height, box[3]);
+    float scaleX = width / box[2];
+    float scaleY = height / box[3];
+
+    // preserveAspectRatio="<align> [meet | slice]", xMidYMid meet by default
+    const char *align = SvgSkipSpace(element.PreserveAspectRatio.Begin, element.PreserveAspectRatio.End);
+    const size_t length = element.PreserveAspectRatio.End - align;
+    float alignX = 0.5f;
+    float alignY = 0.5f;
+    if (!(length >= 4 && memcmp(align, "none", 4) == 0))
+    {
+      if (length >= 8 && align[0] == 'x' && align[4] == 'Y')
+      {
+        alignX = memcmp(align + 1, "Min", 3) == 0 ? 0.0f : (memcmp(align + 1, "Max", 3) == 0 ? 1.0f : 0.5f);
+        alignY = memcmp(align + 5, "Min", 3) == 0 ? 0.0f : (memcmp(align + 5, "Max", 3) == 0 ? 1.0f : 0.5f);
+      }
+      const bool slice = length > 0 && SvgFind(align, element.PreserveAspectRatio.End, "slice") != NULL;
+      scaleX = scaleY = slice ? srMax(scaleX, scaleY) : srMin(scaleX, scaleY);
+    }
+
+    SvgTransform viewBox;
+    viewBox.A = scaleX;
+    viewBox.D = scaleY;
+    viewBox.E = (width - box[2] * scaleX) * alignX - box[0] * scaleX;
+    viewBox.F = (height - box[3] * scaleY) * alignY - box[1] * scaleY;
+    return result * viewBox;
+  }
+
+  // Elements whose content is not drawn where it is defined
+  static bool SvgIsDefinition(const SvgView &name)
+  {
+    static const char *definitions[] = {"defs", "clipPath", "mask", "symbol", "marker", "pattern", "linearGradient",
+                                        "radialGradient", "filter", "style", "script", "metadata", "title", "desc", "text"};
+    for (const char *definition : definitions)
+    {
+      if (name.Equals(definition))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename Sink>
+  static bool SvgEmitShape(Sink &sink, const SvgState &state, const SvgElement &element)
+  {
+    const SvgView &name = element.Name;
+    const bool isPath = name.Equals("path");
+    const bool isPoly = name.Equals("polyline") || name.Equals("polygon");
+    const bool isLine = name.Equals("line");
+    if (!isPath && !isPoly && !isLine && !name.Equals("rect") && !name.Equals("circle") && !name.Equals("ellipse"))
+    {
+      return true;
+    }
+
+    SvgShape shape;
+    if (!SvgGetShape(state, !isLine, &shape))
+    {
+      return true;
+    }
+
+    SvgPathWriter<Sink> writer{sink, state.Transform};
+    bool closed = true;
+    bool valid = true;
+    if (isPath)
+    {
+      if (element.D.Empty())
+        return true;
+      closed = SvgPathIsClosed(element.D);
+      sink.Begin(shape);
+      valid = SvgParsePathData(writer, element.D.Begin, element.D.End);
+    }
+    else if (isPoly)
+    {
+      closed = name.Equals("polygon");
+      sink.Begin(shape);
+      const char *p = SvgSkipSpace(element.Points.Begin, element.Points.End);
+      float v[2];
+      for (bool first = true; p < element.Points.End; first = false)
+      {
+        if (!(p = SvgParseNumbers(p, element.Points.End, v, 2)))
+        {
+          valid = false;
+          break;
+        }
+        if (first)
+          writer.MoveTo({v[0], v[1]});
+        else
+          writer.LineTo({v[0], v[1]});
+      }
+    }
+    else if (isLine)
+    {
+      closed = false;
+      sink.Begin(shape);
+      writer.MoveTo({SvgViewToNumber(element.X1, 0.0f), SvgViewToNumber(element.Y1, 0.0f)});
+      writer.LineTo({SvgViewToNumber(element.X2, 0.0f), SvgViewToNumber(element.Y2, 0.0f)});
+    }
+    else if (name.Equals("rect"))
+    {
+      const float x = SvgViewToNumber(element.X, 0.0f);
+      const float y = SvgViewToNumber(element.Y, 0.0f);
+      const float w = SvgViewToNumber(element.Width, 0.0f);
+      const float h = SvgViewToNumber(element.Height, 0.0f);
+      if (w <= 0.0f || h <= 0.0f)
+        return true;
+
+      // A missing radius takes the other one
+      float rx = SvgViewToNumber(element.Rx, -1.0f);
+      float ry = SvgViewToNumber(element.Ry, -1.0f);
+      rx = rx < 0.0f ? ry : rx;
+      ry = ry < 0.0f ? rx : ry;
+      rx = srClamp(rx, 0.0f, w * 0.5f);
+      ry = srClamp(ry, 0.0f, h * 0.5f);
+
+      sink.Begin(shape);
+      if (rx > 0.0f && ry > 0.0f)
+      {
+        writer.MoveTo({x + rx, y});
+        writer.LineTo({x + w - rx, y});
+        writer.ArcTo({x + w - rx, y}, {x + w, y + ry}, 0.0f, rx, ry, false, true);
+        writer.LineTo({x + w, y + h - ry});
+        writer.ArcTo({x + w, y + h - ry}, {x + w - rx, y + h}, 0.0f, rx, ry, false, true);
+        writer.LineTo({x + rx, y + h});
+        writer.ArcTo({x + rx, y + h}, {x, y + h - ry}, 0.0f, rx, ry, false, true);
+        writer.LineTo({x, y + ry});
+        writer.ArcTo({x, y + ry}, {x + rx, y}, 0.0f, rx, ry, false, true);
+      }
+      else
+      {
+        writer.MoveTo({x, y});
+        writer.LineTo({x + w, y});
+        writer.LineTo({x + w, y + h});
+        writer.LineTo({x, y + h});
+      }
+    }
+    else
+    {
+      const float cx = SvgViewToNumber(element.Cx, 0.0f);
+      const float cy = SvgViewToNumber(element.Cy, 0.0f);
+      float rx = SvgViewToNumber(element.R, 0.0f);
+      float ry = rx;
+      if (name.Equals("ellipse"))
+      {
+        rx = SvgViewToNumber(element.Rx, 0.0f);
+        ry = SvgViewToNumber(element.Ry, 0.0f);
+      }
+      if (rx <= 0.0f || ry <= 0.0f)
+        return true;
+
+      sink.Begin(shape);
+      writer.MoveTo({cx + rx, cy});
+      writer.ArcTo({cx + rx, cy}, {cx - rx, cy}, 0.0f, rx, ry, false, true);
+      writer.ArcTo({cx - rx, cy}, {cx + rx, cy}, 0.0f, rx, ry, false, true);
+    }
+    sink.End(closed);
+    return valid;
+  }
+
+  static bool SvgIsNameChar(char c)
+  {
+    return c != '=' && c != '>' && c != '/' && !SvgIsSpace(c);
+  }
+
+  template <typename Sink>
+  static bool SvgParseDocument(Sink &sink, const char *p, const char *end, const SvgTransform &base)
+  {
+    SvgState stack[SVG_MAX_DEPTH];
+    stack[0].Transform = base;
+    unsigned int depth = 0;
+    unsigned int overflow = 0; // Levels deeper than the stack. They share the state of the last level
+    bool valid = true;
+
+    while (p < end)
+    {
+      p = (const char *)memchr(p, '<', end - p);
+      if (!p)
+      {
+        break;
+      }
+      p++;
+
+      // Comments, declarations and processing instructions
+      if (end - p >= 3 && memcmp(p, "!--", 3) == 0)
+      {
+        p = SvgFind(p + 3, end, "-->");
+        if (!p)
+          break;
+        continue;
+      }
+      if (end - p >= 8 && memcmp(p, "![CDATA[", 8) == 0)
+      {
+        p = SvgFind(p + 8, end, "]]>");
+        if (!p)
+          break;
+        continue;
+      }
+      if (p < end && (*p == '?' || *p == '!'))
+      {
+        p = (const char *)memchr(p, '>', end - p);
+        if (!p)
+          break;
+        continue;
+      }
+
+      if (p < end && *p == '/')
+      {
+        if (overflow > 0)
+          overflow--;
+        else if (depth > 0)
+          depth--;
+        p = (const char *)memchr(p, '>', end - p);
+        if (!p)
+          break;
+        continue;
+      }
+
+      SvgElement element;
+      element.Name.Begin = p;
+      while (p < end && SvgIsNameChar(*p))
+      {
+        p++;
+      }
+      element.Name.End = p;
+
+      SvgState state = stack[depth];
+      if (SvgIsDefinition(element.Name))
+      {
+        state.Hidden = true;
+      }
+
+      // Attributes
+      bool selfClosing = false;
+      while (true)
+      {
+        p = SvgSkipSpace(p, end);
+        if (p >= end)
+        {
+          return false;
+        }
+        if (*p == '>')
+        {
+          p++;
+          break;
+        }
+        if (*p == '/')
+        {
+          selfClosing = true;
+          p++;
+          continue;
+        }
+
+        SvgView name{p, p};
+        while (p < end && SvgIsNameChar(*p))
+        {
+          p++;
+        }
+        name.End = p;
+        p = SvgSkipSpace(p, end);
+        if (name.Empty() || p >= end || *p != '=')
+        {
+          if (name.Empty())
+            p++;
+          continue; // Attribute without value
+        }
+        p = SvgSkipSpace(p + 1, end);
+        if (p >= end || (*p != '"' && *p != '\''))
+        {
+          return false;
+        }
+        const char quote = *p++;
+        const char *valueEnd = (const char *)memchr(p, quote, end - p);
+        if (!valueEnd)
+        {
+          return false;
+        }
+        const SvgView value{p, valueEnd};
+        p = valueEnd + 1;
+
+        if (name.Equals("transform"))
+        {
+          state.Transform = state.Transform * SvgParseTransform(value);
+        }
+        else if (!SvgIsGeometryAttribute(element, name, value))
+        {
+          SvgApplyProperty(state, name, value);
+        }
+      }
+      // Declarations in style attributes win over presentation attributes
+      SvgApplyStyle(state, element.Style);
+      if (element.Name.Equals("svg"))
+      {
+        state.Transform = state.Transform * SvgViewportTransform(element, depth == 0 && overflow == 0);
+      }
+
+      if (!state.Hidden)
+      {
+        valid = SvgEmitShape(sink, state, element) && valid;
+      }
+
+      if (!selfClosing)
+      {
+        if (depth + 1 < SVG_MAX_DEPTH)
+          stack[++depth] = state;
+        else
+          overflow++;
+      }
+    }
+    return valid;
+  }
+
+  R_API bool srPathSvg(const char *pathData, size_t length)
+  {
+    if (length == 0)
+    {
+      length = strlen(pathData);
+    }
+    SvgPathSink sink;
+    const SvgTransform identity;
+    SvgPathWriter<SvgPathSink> writer{sink, identity};
+    if (!SvgParsePathData(writer, pathData, pathData + length))
+    {
+      SR_TRACE("ERROR: Invalid svg path data");
+      return false;
+    }
+    return true;
+  }
+
+  R_API bool srDrawSvg(const char *svg, size_t length, const glm::vec2 &position, float scale)
+  {
+    if (length == 0)
+    {
+      length = strlen(svg);
+    }
+    SvgPathSink sink;
+    const SvgTransform base = {scale, 0.0f, 0.0f, scale, position.x, position.y};
+    if (!SvgParseDocument(sink, svg, svg + length, base))
+    {
+      SR_TRACE("ERROR: Invalid svg document");
+      return false;
+    }
+    return true;
+  }
+
+  R_API bool srSvgCompile(const char *svg, size_t length, std::vector<uint8_t> &out)
+  {
+    if (length == 0)
+    {
+      length = strlen(svg);
+    }
+    SvgCompileSink sink{out};
+    sink.Write(SvgCompiledMagic, sizeof(SvgCompiledMagic));
+    sink.U32(SvgCompiledVersion);
+
+    const SvgTransform identity;
+    if (!SvgParseDocument(sink, svg, svg + length, identity))
+    {
+      SR_TRACE("ERROR: Invalid svg document");
+      return false;
+    }
+    return true;
+  }
+
+  // Bounds checked reads of the compiled form
+  struct SvgReader
+  {
+    const uint8_t *P;
+    const uint8_t *End;
+
+    bool Read(void *out, size_t size)
+    {
+      if ((size_t)(End - P) < size)
+      {
+        return false;
+      }
+      memcpy(out, P, size);
+      P += size;
+      return true;
+    }
+    bool U32(uint32_t *out)
+    {
+      uint8_t bytes[4];
+      if (!Read(bytes, sizeof(bytes)))
+      {
+        return false;
+      }
+      *out = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+      return true;
+    }
+    bool F32(float *out)
+    {
+      uint32_t bits;
+      if (!U32(&bits))
+      {
+        return false;
+      }
+      memcpy(out, &bits, sizeof(bits));
+      return true;
+    }
+  };
+
+  R_API bool srDrawSvgCompiled(const uint8_t *data, size_t size, const glm::vec2 &position, float scale)
+  {
+    SvgReader reader{data, data + size};
+    char magic[4];
+    uint32_t version = 0;
+    if (!reader.Read(magic, sizeof(magic)) || memcmp(magic, SvgCompiledMagic, sizeof(magic)) != 0 ||
+        !reader.U32(&version) || version != SvgCompiledVersion)
+    {
+      SR_TRACE("ERROR: Data is not a compiled svg");
+      return false;
+    }
+
+    auto point = [&](glm::vec2 *out) -> bool
+    {
+      float v[2];
+      if (!reader.F32(&v[0]) || !reader.F32(&v[1]))
+        return false;
+      *out = glm::vec2(v[0], v[1]) * scale + position;
+      return true;
+    };
+
+    bool inPath = false;
+    bool valid = true;
+    while (reader.P < reader.End && valid)
+    {
+      uint8_t op = 0;
+      reader.Read(&op, 1);
+      glm::vec2 p[3];
+      switch (op)
+      {
+      case SvgOp_Begin:
+      {
+        uint8_t type = 0, rule = 0, join = 0, cap = 0;
+        PathStyle style;
+        valid = reader.Read(&type, 1) && reader.Read(&rule, 1) && reader.F32(&style.StrokeWidth) &&
+                reader.U32(&style.StrokeColor) && reader.U32(&style.FillColor) && reader.Read(&join, 1) &&
+                reader.Read(&cap, 1) && reader.F32(&style.MiterLimit) && reader.F32(&style.DashLength) &&
+                reader.F32(&style.DashGap) && reader.F32(&style.DashOffset);
+        if (valid)
+        {
+          style.StrokeWidth *= scale;
+          style.DashLength *= scale;
+          style.DashGap *= scale;
+          style.DashOffset *= scale;
+          style.LineJoin = (LineJoin_)join;
+          style.LineCap = (LineCap_)cap;
+          srBeginPath(type);
+          srPathSetStyle(style);
+          srPathSetFillRule((FillRule_)rule);
+          inPath = true;
+        }
+        break;
+      }
+      case SvgOp_End:
+      {
+        uint8_t closed = 0;
+        valid = inPath && reader.Read(&closed, 1);
+        if (valid)
+        {
+          srEndPath(closed != 0);
+          inPath = false;
+        }
+        break;
+      }
+      case SvgOp_MoveTo:
+        if ((valid = inPath && point(&p[0])))
+          srPathMoveTo(p[0]);
+        break;
+      case SvgOp_LineTo:
+        if ((valid = inPath && point(&p[0])))
+          srPathLineTo(p[0]);
+        break;
+      case SvgOp_CubicTo:
+        if ((valid = inPath && point(&p[0]) && point(&p[1]) && point(&p[2])))
+          srPathCubicBezierTo(p[0], p[1], p[2]);
+        break;
+      case SvgOp_QuadraticTo:
+        if ((valid = inPath && point(&p[0]) && point(&p[1])))
+          srPathQuadraticBezierTo(p[0], p[1]);
+        break;
+      case SvgOp_ArcTo:
+      {
+        float v[3];
+        uint8_t flags = 0;
+        valid = inPath && point(&p[0]) && reader.F32(&v[0]) && reader.F32(&v[1]) && reader.F32(&v[2]) && reader.Read(&flags, 1);
+        if (valid)
+          srPathEllipticalArc(p[0], v[0], v[1] * scale, v[2] * scale, (flags & 1) != 0, (flags & 2) != 0);
+        break;
+      }
+      default:
+        valid = false;
+        break;
+      }
+    }
+
+    if (inPath)
+    {
+      srEndPath(false); // Cut off data. Draw what is there
+    }
+    if (!valid)
+    {
+      SR_TRACE("ERROR: Compiled svg is damaged");
+    }
+    return valid;
+  }
+}
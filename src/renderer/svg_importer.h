@@ -0,0 +1,46 @@
+#pragma once
+
+namespace sr
+{
+    /**
+     * @brief Adds SVG path data like "M 10 10 h 20 v 20 z" to the current path. Call it between srBeginPath and srEndPath.
+     * The data is parsed while it is read, nothing gets allocated. Closed subpaths end with a line back to their start
+     *
+     * @param pathData Contents of a d attribute
+     * @param length   Length of the data. 0 reads until the terminating zero
+     * @return false when the data has an error. Everything before the error is added
+     */
+    R_API bool srPathSvg(const char *pathData, size_t length = 0);
+
+    /**
+     * @brief Draws the path, rect, circle, ellipse, line, polyline and polygon elements of an SVG document.
+     * Presentation attributes, style attributes and transforms are inherited through groups. The viewBox of svg elements
+     * is mapped into their width and height with preserveAspectRatio. Percent sizes take the size of the viewBox.
+     * Gradients, patterns, text, images, clipping and masks are skipped
+     *
+     * @param svg      Document text
+     * @param length   Length of the text. 0 reads until the terminating zero
+     * @param position Where the origin of the document is drawn
+     * @param scale    Uniform scale of the document
+     * @return false when the document has an error. Everything before the error is drawn
+     */
+    R_API bool srDrawSvg(const char *svg, size_t length = 0, const glm::vec2 &position = glm::vec2(0.0f), float scale = 1.0f);
+
+    /**
+     * @brief Parses an SVG document into a compact list of absolute path commands and styles, for documents that are loaded
+     * more than once. Drawing the compiled form skips the text parsing, shape conversion and transforms
+     *
+     * @param svg    Document text
+     * @param length Length of the text. 0 reads until the terminating zero
+     * @param out    Gets the compiled document appended. It can be written to disk as is
+     * @return false when the document has an error. Everything before the error is compiled
+     */
+    R_API bool srSvgCompile(const char *svg, size_t length, std::vector<uint8_t> &out);
+
+    /**
+     * @brief Draws a document compiled with srSvgCompile
+     *
+     * @return false when the data is not a compiled document or is cut off
+     */
+    R_API bool srDrawSvgCompiled(const uint8_t *data, size_t size, const glm::vec2 &position = glm::vec2(0.0f), float scale = 1.0f);
+}